@@ -2,6 +2,7 @@
 #include <modes.h>
 #include <aes.h>
 #include <filters.h>
+#include <cstring>
 #include <stdexcept>
 #include <immintrin.h>
 
@@ -87,6 +88,46 @@ std::string AESWrapper::encrypt(const char* plain, unsigned int length)
 	return cipher;
 }
 
+/**
+ * @brief Encrypts the next part of a message using AES-CBC encryption, continuing the chain of the previous part.
+ *
+ * The parts together encrypt to the same bytes as encrypt() of the whole message; the last part is padded
+ * with PKCS #7 as encrypt() pads. plain and cipher may be the same buffer.
+ * @param plain Pointer to the plaintext part to encrypt.
+ * @param length Length of the part in bytes. Must be a multiple of the block size unless the part is the last.
+ * @param cipher Pointer to a buffer that receives the ciphertext, with room for length + BLOCKSIZE bytes.
+ * @param chain The last ciphertext block of the previous part, zeros before the first part. Updated for the next part.
+ * @param last Whether the part is the last of the message.
+ * @return The number of ciphertext bytes written.
+ * @throws std::length_error if a part other than the last does not end on a block boundary.
+ */
+size_t AESWrapper::encryptPart(const char* plain, size_t length, char* cipher, unsigned char* chain, bool last)
+{
+	const size_t blockSize = CryptoPP::AES::BLOCKSIZE;
+	if (!last && length % blockSize != 0)
+		throw std::length_error("only the last part may end inside a block");
+
+	CryptoPP::AES::Encryption aesEncryption(_key, DEFAULT_KEYLENGTH);
+	CryptoPP::CBC_Mode_ExternalCipher::Encryption cbcEncryption(aesEncryption, chain);
+
+	size_t whole = length - length % blockSize;
+	cbcEncryption.ProcessData(reinterpret_cast<CryptoPP::byte*>(cipher), reinterpret_cast<const CryptoPP::byte*>(plain), whole);
+	size_t total = whole;
+	if (last)
+	{
+		// PKCS #7 padding, as StreamTransformationFilter adds in encrypt()
+		CryptoPP::byte block[blockSize];
+		size_t rest = length - whole;
+		memcpy(block, plain + whole, rest);
+		memset(block + rest, static_cast<int>(blockSize - rest), blockSize - rest);
+		cbcEncryption.ProcessData(reinterpret_cast<CryptoPP::byte*>(cipher) + whole, block, blockSize);
+		total += blockSize;
+	}
+	if (total > 0)
+		memcpy(chain, cipher + total - blockSize, blockSize);
+	return total;
+}
+
 /**
  * @brief Decrypts the provided ciphertext data using AES-CBC decryption.
  *
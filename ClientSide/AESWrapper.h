@@ -74,6 +74,20 @@ public:
 	 */
 	std::string encrypt(const char* plain, unsigned int length);
 
+	/**
+	 * @brief Encrypts the next part of a message using AES encryption, continuing the chain of the previous part.
+	 *
+	 * The parts together encrypt to the same bytes as encrypt() of the whole message.
+	 * @param plain Pointer to the plaintext part to encrypt.
+	 * @param length Length of the part in bytes. Must be a multiple of the block size unless the part is the last.
+	 * @param cipher Pointer to a buffer that receives the ciphertext, with room for length + BLOCKSIZE bytes.
+	 * @param chain The last ciphertext block of the previous part, zeros before the first part. Updated for the next part.
+	 * @param last Whether the part is the last of the message, which is padded.
+	 * @return The number of ciphertext bytes written.
+	 * @throws std::length_error if a part other than the last does not end on a block boundary.
+	 */
+	size_t encryptPart(const char* plain, size_t length, char* cipher, unsigned char* chain, bool last);
+
 	/**
 	 * @brief Decrypts the provided ciphertext data using AES decryption.
 	 *
@@ -0,0 +1,101 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+    thread_local uint64_t threadAllocations = 0;
+    thread_local uint64_t threadAllocatedBytes = 0;
+    thread_local AllocationScope* threadSamplingScope = nullptr;
+}
+
+/**
+ * @brief Returns the number of allocations made by the calling thread so far.
+ *
+ * @return The allocation count.
+ */
+uint64_t AllocationCounter::allocations() {
+    return threadAllocations;
+}
+
+/**
+ * @brief Returns the number of bytes allocated by the calling thread so far.
+ *
+ * @return The allocated bytes, not reduced by deallocations.
+ */
+uint64_t AllocationCounter::allocatedBytes() {
+    return threadAllocatedBytes;
+}
+
+/**
+ * @brief Starts counting on the calling thread.
+ *
+ * @param sampleEvery Record the size of every Nth allocation; 0 records none.
+ */
+AllocationScope::AllocationScope(uint64_t sampleEvery)
+    : startAllocations(threadAllocations), startBytes(threadAllocatedBytes), sampleEvery(sampleEvery), enclosing(threadSamplingScope) {
+    if (sampleEvery > 0) {
+        threadSamplingScope = this;
+    }
+}
+
+/**
+ * @brief Stops sampling, making the enclosing sampling scope the innermost again.
+ */
+AllocationScope::~AllocationScope() {
+    if (sampleEvery > 0) {
+        threadSamplingScope = enclosing;
+    }
+}
+
+/**
+ * @brief Returns the allocations made in the scope so far.
+ *
+ * @return The allocation count.
+ */
+uint64_t AllocationScope::allocations() const {
+    return threadAllocations - startAllocations;
+}
+
+/**
+ * @brief Returns the bytes allocated in the scope so far.
+ *
+ * @return The allocated bytes, not reduced by deallocations.
+ */
+uint64_t AllocationScope::allocatedBytes() const {
+    return threadAllocatedBytes - startBytes;
+}
+
+/**
+ * @brief Records an allocation of the calling thread; called by operator new while the scope samples.
+ *
+ * @param size The size of the allocation.
+ */
+void AllocationScope::sample(size_t size) noexcept {
+    if (seen++ % sampleEvery == 0 && sampledCount < MAX_SAMPLES) {
+        sampled[sampledCount++] = size;
+    }
+}
+
+// The array and nothrow forms call these, so they are counted too. The aligned forms are not replaced.
+
+void* operator new(std::size_t size) {
+    threadAllocations++;
+    threadAllocatedBytes += size;
+    if (threadSamplingScope != nullptr) {
+        threadSamplingScope->sample(size);
+    }
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,105 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class AllocationCounter
+ * @brief Counts the heap allocations made through operator new, per thread.
+ *
+ * The global operator new and delete are replaced by ones that count on the calling thread before calling
+ * malloc and free, so the counts cost one thread-local increment and take no lock. Compare the counts
+ * before and after a piece of code to get its allocations.
+ */
+class AllocationCounter {
+public:
+    /**
+     * @brief Returns the number of allocations made by the calling thread so far.
+     *
+     * @return The allocation count.
+     */
+    static uint64_t allocations();
+
+    /**
+     * @brief Returns the number of bytes allocated by the calling thread so far.
+     *
+     * @return The allocated bytes, not reduced by deallocations.
+     */
+    static uint64_t allocatedBytes();
+};
+
+/**
+ * @class AllocationScope
+ * @brief Counts the allocations the calling thread makes while the scope exists, and samples their sizes.
+ *
+ * The counts are the difference of the AllocationCounter counts, so nested scopes each see their own and their
+ * inner scopes' allocations. Sampling is opt-in: a scope constructed with a sampling interval records the size
+ * of every Nth allocation made while it is the innermost sampling scope, into a fixed array so that recording
+ * does not allocate, until the array is full. The sizes help to find which copy a regression reintroduced.
+ */
+class AllocationScope {
+public:
+    static constexpr size_t MAX_SAMPLES = 16; ///< The most sizes a scope records.
+
+    /**
+     * @brief Starts counting on the calling thread.
+     *
+     * @param sampleEvery Record the size of every Nth allocation; 0 records none.
+     */
+    explicit AllocationScope(uint64_t sampleEvery = 0);
+
+    /**
+     * @brief Stops sampling, making the enclosing sampling scope the innermost again.
+     */
+    ~AllocationScope();
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+    /**
+     * @brief Returns the allocations made in the scope so far.
+     *
+     * @return The allocation count.
+     */
+    uint64_t allocations() const;
+
+    /**
+     * @brief Returns the bytes allocated in the scope so far.
+     *
+     * @return The allocated bytes, not reduced by deallocations.
+     */
+    uint64_t allocatedBytes() const;
+
+    /**
+     * @brief Returns the sampled allocation sizes, in the order they were allocated.
+     *
+     * @return The first sampleCount() entries are the sizes.
+     */
+    const size_t* samples() const { return sampled; }
+
+    /**
+     * @brief Returns the number of sampled sizes.
+     *
+     * @return At most MAX_SAMPLES.
+     */
+    size_t sampleCount() const { return sampledCount; }
+
+    /**
+     * @brief Records an allocation of the calling thread; called by operator new while the scope samples.
+     *
+     * @param size The size of the allocation.
+     */
+    void sample(size_t size) noexcept;
+
+private:
+    uint64_t startAllocations;          ///< The thread's allocation count when the scope started.
+    uint64_t startBytes;                ///< The thread's allocated bytes when the scope started.
+    uint64_t sampleEvery;               ///< The sampling interval, or 0.
+    uint64_t seen = 0;                  ///< The allocations this scope was offered for sampling.
+    size_t sampled[MAX_SAMPLES] = {};   ///< The sampled sizes.
+    size_t sampledCount = 0;            ///< The number of sampled sizes.
+    AllocationScope* enclosing;         ///< The sampling scope this one replaced, or nullptr.
+};
+
+#endif // ALLOCATION_COUNTER_H
@@ -0,0 +1,379 @@
+#include "BatchUploader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <thread>
+
+#include "FileHandler.h"
+#include "TransferMetrics.h"
+
+/**
+ * @brief Constructs a BatchUploader on top of an authenticated session.
+ *
+ * @param session The session that completed registration or reconnection and holds the AES key.
+ * @param address The server address, used to open additional connections.
+ * @param port The server port, used to open additional connections.
+ * @param clientId The client ID to put in the request headers.
+ * @param options The number of workers and connections to use.
+ */
+BatchUploader::BatchUploader(ClientSession& session, const std::string& address, const std::string& port,
+    const std::string& clientId, const UploadOptions& options)
+    : session(session), address(address), port(port), clientId(clientId), options(options),
+    connections(&ownConnections), nextFile(0), activeWorkers(0), activeSenders(0), succeeded(0),
+    ready(Constants::UPLOAD_QUEUE_CAPACITY) {
+    if (this->options.workers == 0) {
+        this->options.workers = 1;
+    }
+    if (this->options.connections == 0) {
+        this->options.connections = 1;
+    }
+}
+
+/**
+ * @brief Uploads the given files and waits until every one of them was confirmed or failed.
+ *
+ * Worker threads prepare the files while the sender threads send them; the calling thread
+ * sends over the authenticated session itself.
+ * @param filePaths The paths of the files to upload.
+ * @param fileNames The names to send the files under, by index; a missing or empty name means
+ * FileHandler::uploadName of the path. A file whose name is too long for the protocol or already taken by
+ * another file of the batch is not uploaded.
+ * @return true if the CRC of every file was confirmed by the server, false otherwise.
+ */
+bool BatchUploader::upload(const std::vector<std::string>& filePaths, const std::vector<std::string>& fileNames) {
+    files.clear();
+    names.clear();
+    size_t rejected = 0;
+    std::set<std::string> seenNames;
+    for (size_t i = 0; i < filePaths.size(); i++) {
+        std::string name = i < fileNames.size() && !fileNames[i].empty() ? fileNames[i] : FileHandler::uploadName(filePaths[i]);
+
+        // The server keeps a name in Constants::FILE_NAME_SIZE bytes with its terminator, and one file per name
+        const char* reason = nullptr;
+        if (name.empty()) {
+            reason = "empty name";
+        }
+        else if (name.size() > static_cast<size_t>(Constants::FILE_NAME_SIZE - 1)) {
+            reason = "name too long";
+        }
+        else if (!seenNames.insert(name).second) {
+            reason = "another file of the batch has the same name";
+        }
+        if (reason != nullptr) {
+            Log::error("File name rejected", { { "reason", reason }, { "file", filePaths[i] }, { "name", name } });
+            if (onRejected) {
+                onRejected(EncryptedFile{ filePaths[i], name });
+            }
+            rejected++;
+            continue;
+        }
+        files.push_back(filePaths[i]);
+        names.push_back(std::move(name));
+    }
+    nextFile = 0;
+    succeeded = 0;
+
+    bool streaming = options.maxBuffer > 0;
+    size_t workerCount = streaming ? 0 : std::min(options.workers, files.size());
+    size_t senderCount = std::min(options.connections, files.size());
+    if (senderCount == 0) {
+        TransferMetrics::instance().countFiles(0, rejected);
+        return rejected == 0;
+    }
+
+    if (streaming) {
+        buffers.resize(senderCount);
+        for (auto& buffer : buffers) {
+            buffer.resize(FileEncryptor::bufferSize(options.maxBuffer / senderCount));
+        }
+        Log::info("Batch upload started", { { "files", files.size() }, { "connections", senderCount }, { "buffer", buffers[0].size() } });
+    }
+    else {
+        Log::info("Batch upload started", { { "files", files.size() }, { "workers", workerCount }, { "connections", senderCount } });
+    }
+
+    activeWorkers = workerCount;
+    activeSenders = senderCount;
+    if (connections->size() < senderCount - 1) {
+        connections->resize(senderCount - 1);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workerCount; i++) {
+        threads.emplace_back(&BatchUploader::prepareFiles, this);
+    }
+    for (size_t i = 1; i < senderCount; i++) {
+        threads.emplace_back(&BatchUploader::sendFilesOnExtraConnection, this, i - 1);
+    }
+
+    sendFiles(session, 0);
+    senderFinished();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ownConnections.clear();
+    buffers.clear();
+
+    // Files whose name was rejected, that could not be read, were rejected by the server, or were still queued when
+    // every connection failed
+    size_t failed = files.size() - succeeded + rejected;
+    TransferMetrics::instance().countFiles(succeeded, failed);
+
+    Log::info("Batch upload finished", { { "succeeded", succeeded.load() }, { "failed", failed } });
+    return failed == 0;
+}
+
+/**
+ * @brief Sets a callback invoked after the server confirmed the CRC of a file.
+ *
+ * @param callback The function to call with the confirmed file.
+ */
+void BatchUploader::setOnUploaded(std::function<void(const EncryptedFile&)> callback) {
+    onUploaded = std::move(callback);
+}
+
+/**
+ * @brief Sets a callback invoked for a file that is rejected rather than lost to a broken connection.
+ *
+ * @param callback The function to call with the rejected file.
+ */
+void BatchUploader::setOnRejected(std::function<void(const EncryptedFile&)> callback) {
+    onRejected = std::move(callback);
+}
+
+/**
+ * @brief Keeps the additional connections in the given pool, so they stay open for later uploads.
+ *
+ * Missing connections are opened as needed and broken ones are removed from the pool.
+ * @param pool The additional connections, owned by the caller and used by one upload at a time.
+ */
+void BatchUploader::setConnectionPool(std::vector<std::unique_ptr<ClientSession>>& pool) {
+    connections = &pool;
+}
+
+/**
+ * @brief Worker loop: prepares files until none are left, then closes the queue if it was the last worker.
+ */
+void BatchUploader::prepareFiles() {
+    for (size_t index = nextFile++; index < files.size(); index = nextFile++) {
+        try {
+            if (!ready.push(prepareFile(files[index], names[index]))) {
+                break; // every connection is gone
+            }
+        }
+        catch (const std::exception& e) {
+            Log::error("Could not prepare file", { { "file", files[index] }, { "reason", e.what() } });
+        }
+    }
+
+    if (--activeWorkers == 0) {
+        ready.close();
+    }
+}
+
+/**
+ * @brief Reads a file, calculates its CRC and encrypts it with the session's AES key.
+ *
+ * The file is read once; the same buffer is used for the CRC and for the encryption.
+ * @param filePath The path of the file to prepare.
+ * @param fileName The name to send the file under.
+ * @return The prepared file.
+ * @throws std::runtime_error if the file could not be opened.
+ */
+EncryptedFile BatchUploader::prepareFile(const std::string& filePath, const std::string& fileName) {
+    std::vector<char> fileContent;
+    {
+        ScopedPhase phase(Phase::FileRead, 0, filePath);
+        std::ifstream file(filePath, std::ios::in | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open the file at the given path.");
+        }
+        fileContent.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        phase.setBytes(fileContent.size());
+    }
+
+    EncryptedFile prepared;
+    prepared.filePath = filePath;
+    prepared.fileName = fileName;
+    prepared.origFileSize = fileContent.size();
+    {
+        ScopedPhase phase(Phase::LocalCrc, fileContent.size(), filePath);
+        prepared.crc = CRC_Calculator::memcrc(fileContent.data(), fileContent.size());
+    }
+    {
+        ScopedPhase phase(Phase::Encrypt, fileContent.size(), filePath);
+        const std::string& aesKey = session.getAESKey();
+        AESWrapper aes(reinterpret_cast<const unsigned char*>(aesKey.data()), aesKey.size());
+        std::string encryptedContent = aes.encrypt(fileContent.data(), fileContent.size());
+        prepared.content.assign(encryptedContent.begin(), encryptedContent.end());
+    }
+
+    return prepared;
+}
+
+/**
+ * @brief Sender loop: sends prepared files over the given connection until the queue is drained.
+ *
+ * A connection error ends the loop for this connection only; the file it was sending counts as failed.
+ * When streaming, it streams files over the connection until none are left instead.
+ * @param connection The connection to send files over.
+ * @param slot The index of the connection, 0 for the session, which picks its streaming buffer.
+ * @return true if the queue was drained, false if the connection broke.
+ */
+bool BatchUploader::sendFiles(ClientSession& connection, size_t slot) {
+    if (!buffers.empty()) {
+        return streamFiles(connection, buffers[slot]);
+    }
+
+    EncryptedFile file;
+    try {
+        while (ready.pop(file)) {
+            if (sendWithRetries(connection, file)) {
+                if (onUploaded) {
+                    onUploaded(file);
+                }
+                succeeded++;
+                Log::info("Uploaded", { { "file", file.filePath }, { "crc", file.crc } });
+            }
+            else {
+                Log::error("CRC comparison failed", { { "file", file.filePath }, { "attempts", Constants::MAX_CRC_RETRIES } });
+                if (onRejected) {
+                    onRejected(file);
+                }
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        Log::error("Connection lost", { { "file", file.filePath }, { "reason", e.what() } });
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Streaming sender loop: reads, encrypts and sends files over the connection until none are left.
+ *
+ * A file that cannot be opened is skipped; a file that fails while it is sent leaves the connection in the
+ * middle of a request, so it ends the loop as a broken connection does.
+ * @param connection The connection to send files over.
+ * @param buffer The buffer of the connection.
+ * @return true if no file is left, false if the connection broke.
+ */
+bool BatchUploader::streamFiles(ClientSession& connection, std::vector<char>& buffer) {
+    EncryptedFile file;
+    try {
+        for (size_t index = nextFile++; index < files.size(); index = nextFile++) {
+            file.filePath = files[index];
+            file.fileName = names[index];
+            std::optional<FileEncryptor> encryptor;
+            try {
+                encryptor.emplace(file.filePath, session.getAESKey(), buffer);
+            }
+            catch (const std::exception& e) {
+                Log::error("Could not prepare file", { { "file", file.filePath }, { "reason", e.what() } });
+                continue;
+            }
+
+            if (streamWithRetries(connection, file, encryptor, buffer)) {
+                if (onUploaded) {
+                    onUploaded(file);
+                }
+                succeeded++;
+                Log::info("Uploaded", { { "file", file.filePath }, { "crc", file.crc } });
+            }
+            else {
+                Log::error("CRC comparison failed", { { "file", file.filePath }, { "attempts", Constants::MAX_CRC_RETRIES } });
+                if (onRejected) {
+                    onRejected(file);
+                }
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        Log::error("Connection lost", { { "file", file.filePath }, { "reason", e.what() } });
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Runs the sender loop on an additional connection, opening it first if the slot is empty.
+ *
+ * Each sender owns its slot, so the slots need no locking. A broken connection is dropped from its slot.
+ * @param slot The index of the connection in the additional connections.
+ */
+void BatchUploader::sendFilesOnExtraConnection(size_t slot) {
+    std::unique_ptr<ClientSession>& connection = (*connections)[slot];
+    try {
+        if (!connection) {
+            connection = std::make_unique<ClientSession>(address, port);
+        }
+        if (!sendFiles(*connection, slot + 1)) {
+            connection.reset();
+        }
+    }
+    catch (const std::exception& e) {
+        Log::error("Could not open an additional connection", { { "reason", e.what() } });
+    }
+    senderFinished();
+}
+
+/**
+ * @brief Sends one file and compares the CRCs, resending up to Constants::MAX_CRC_RETRIES times on mismatch.
+ *
+ * @param connection The connection to send the file over.
+ * @param file The prepared file.
+ * @return true if the server's CRC matched the local CRC, false otherwise.
+ */
+bool BatchUploader::sendWithRetries(ClientSession& connection, const EncryptedFile& file) {
+    for (int attempt = 0; attempt <= Constants::MAX_CRC_RETRIES; attempt++) {
+        auto start = TransferMetrics::Clock::now();
+        bool matched = connection.getServerCRC(file.fileName, file.origFileSize, file.content, clientId) == file.crc;
+        if (attempt > 0) {
+            TransferMetrics::instance().record(Phase::Retry, start, file.content.size(), file.filePath);
+        }
+        if (matched) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Streams one file and compares the CRCs, reading the file again for every retry.
+ *
+ * @param connection The connection to send the file over.
+ * @param file The file; its size and CRC are filled in.
+ * @param encryptor The file, opened for its first attempt.
+ * @param buffer The buffer of the connection.
+ * @return true if the server's CRC matched the local CRC, false otherwise.
+ */
+bool BatchUploader::streamWithRetries(ClientSession& connection, EncryptedFile& file, std::optional<FileEncryptor>& encryptor, std::vector<char>& buffer) {
+    for (int attempt = 0; attempt <= Constants::MAX_CRC_RETRIES; attempt++) {
+        if (attempt > 0) {
+            encryptor.emplace(file.filePath, session.getAESKey(), buffer);
+        }
+        auto start = TransferMetrics::Clock::now();
+        unsigned long serverCrc = connection.getServerCRC(file.fileName, *encryptor, clientId);
+        file.origFileSize = static_cast<int>(encryptor->size());
+        file.crc = encryptor->crc();
+        if (attempt > 0) {
+            TransferMetrics::instance().record(Phase::Retry, start, encryptor->encryptedSize(), file.filePath);
+        }
+        if (serverCrc == file.crc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Called when a sender loop ends; the last sender closes the queue so workers stop waiting on it.
+ */
+void BatchUploader::senderFinished() {
+    if (--activeSenders == 0) {
+        ready.close();
+    }
+}
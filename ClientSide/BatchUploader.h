@@ -0,0 +1,188 @@
+#ifndef BATCH_UPLOADER_H
+#define BATCH_UPLOADER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "ClientSission.h"
+#include "FileEncryptor.h"
+
+/**
+ * @struct EncryptedFile
+ * @brief A file that was read, checksummed and encrypted, ready to be sent to the server.
+ */
+struct EncryptedFile {
+    std::string filePath;       ///< The path of the local file.
+    std::string fileName;       ///< The file name sent to the server.
+    int origFileSize = 0;       ///< The size of the file before encryption.
+    unsigned long crc = 0;      ///< The CRC of the plaintext file content.
+    std::vector<char> content;  ///< The encrypted file content; empty when the file was streamed.
+};
+
+/**
+ * @struct UploadOptions
+ * @brief Tuning knobs for a batch upload.
+ */
+struct UploadOptions {
+    size_t workers = Constants::DEFAULT_UPLOAD_WORKERS;          ///< Threads that read, checksum and encrypt files.
+    size_t connections = Constants::DEFAULT_UPLOAD_CONNECTIONS;  ///< Connections that send files to the server.
+    size_t maxBuffer = 0;   ///< File buffer bytes of all connections together when streaming; 0 to hold whole encrypted files.
+};
+
+/**
+ * @class BatchUploader
+ * @brief Uploads many files over one authenticated session.
+ *
+ * A bounded pool of worker threads reads, checksums and encrypts the files with the session's AES key, while
+ * one or more connections send them to the server and compare the server's CRC with the local one.
+ * The first connection is the already authenticated session; any additional connection only carries
+ * file upload requests, which the server matches to the user by client ID.
+ *
+ * With UploadOptions::maxBuffer set the files are streamed instead: each connection reads, checksums and
+ * encrypts its file a chunk at a time into its own buffer of a fixed pool, sending every chunk before reading
+ * the next, so memory stays within the budget whatever the file sizes. The workers are not used then.
+ */
+class BatchUploader {
+public:
+    /**
+     * @brief Constructs a BatchUploader on top of an authenticated session.
+     *
+     * @param session The session that completed registration or reconnection and holds the AES key.
+     * @param address The server address, used to open additional connections.
+     * @param port The server port, used to open additional connections.
+     * @param clientId The client ID to put in the request headers.
+     * @param options The number of workers and connections to use.
+     */
+    BatchUploader(ClientSession& session, const std::string& address, const std::string& port,
+        const std::string& clientId, const UploadOptions& options);
+
+    /**
+     * @brief Uploads the given files and waits until every one of them was confirmed or failed.
+     *
+     * @param filePaths The paths of the files to upload.
+     * @param fileNames The names to send the files under, by index; a missing or empty name means
+     * FileHandler::uploadName of the path. Files whose name does not fit the protocol or repeats are not uploaded.
+     * @return true if the CRC of every file was confirmed by the server, false otherwise.
+     */
+    bool upload(const std::vector<std::string>& filePaths, const std::vector<std::string>& fileNames = {});
+
+    /**
+     * @brief Keeps the additional connections in the given pool, so they stay open for later uploads.
+     *
+     * Missing connections are opened as needed and broken ones are removed from the pool.
+     * @param pool The additional connections, owned by the caller and used by one upload at a time.
+     */
+    void setConnectionPool(std::vector<std::unique_ptr<ClientSession>>& pool);
+
+    /**
+     * @brief Sets a callback invoked after the server confirmed the CRC of a file.
+     *
+     * The callback runs on the sending thread and may be called from several threads at once.
+     * @param callback The function to call with the confirmed file.
+     */
+    void setOnUploaded(std::function<void(const EncryptedFile&)> callback);
+
+    /**
+     * @brief Sets a callback invoked for a file that is rejected rather than lost to a broken connection.
+     *
+     * That is a file whose name does not fit the protocol or repeats, or whose CRC the server did not confirm
+     * after every retry, so sending it again unchanged would fail again. At least the path and name of the
+     * file are set. The callback may be called from several threads at once.
+     * @param callback The function to call with the rejected file.
+     */
+    void setOnRejected(std::function<void(const EncryptedFile&)> callback);
+
+private:
+    ClientSession& session;         ///< The authenticated session, used as the first connection.
+    std::string address;            ///< The server address.
+    std::string port;               ///< The server port.
+    std::string clientId;           ///< The client ID of the authenticated user.
+    UploadOptions options;          ///< The number of workers and connections.
+    std::function<void(const EncryptedFile&)> onUploaded; ///< Called for every file whose CRC was confirmed.
+    std::function<void(const EncryptedFile&)> onRejected; ///< Called for every file that would fail again if resent.
+
+    std::vector<std::unique_ptr<ClientSession>> ownConnections;   ///< The additional connections, when no pool is set.
+    std::vector<std::unique_ptr<ClientSession>>* connections;     ///< The additional connections in use.
+
+    std::vector<std::string> files;         ///< The files of the current batch.
+    std::vector<std::string> names;         ///< The names to send the files of the current batch under.
+    std::atomic<size_t> nextFile;           ///< Index of the next file a worker should prepare.
+    std::atomic<size_t> activeWorkers;      ///< Workers that are still preparing files.
+    std::atomic<size_t> activeSenders;      ///< Connections that are still sending files.
+    std::atomic<size_t> succeeded;          ///< Files whose CRC was confirmed by the server.
+    BoundedQueue<EncryptedFile> ready;      ///< Encrypted files waiting for a connection.
+    std::vector<std::vector<char>> buffers; ///< One streaming buffer per connection, the session's first.
+
+    /**
+     * @brief Worker loop: prepares files until none are left, then closes the queue if it was the last worker.
+     */
+    void prepareFiles();
+
+    /**
+     * @brief Reads a file, calculates its CRC and encrypts it with the session's AES key.
+     *
+     * @param filePath The path of the file to prepare.
+     * @param fileName The name to send the file under.
+     * @return The prepared file.
+     * @throws std::runtime_error if the file could not be opened.
+     */
+    EncryptedFile prepareFile(const std::string& filePath, const std::string& fileName);
+
+    /**
+     * @brief Sender loop: sends prepared files over the given connection until the queue is drained.
+     *
+     * When streaming, it streams files over the connection until none are left instead.
+     * @param connection The connection to send files over.
+     * @param slot The index of the connection, 0 for the session, which picks its streaming buffer.
+     * @return true if the queue was drained, false if the connection broke.
+     */
+    bool sendFiles(ClientSession& connection, size_t slot);
+
+    /**
+     * @brief Streaming sender loop: reads, encrypts and sends files over the connection until none are left.
+     *
+     * @param connection The connection to send files over.
+     * @param buffer The buffer of the connection.
+     * @return true if no file is left, false if the connection broke.
+     */
+    bool streamFiles(ClientSession& connection, std::vector<char>& buffer);
+
+    /**
+     * @brief Runs the sender loop on an additional connection, opening it first if the slot is empty.
+     *
+     * @param slot The index of the connection in the additional connections.
+     */
+    void sendFilesOnExtraConnection(size_t slot);
+
+    /**
+     * @brief Sends one file and compares the CRCs, resending up to Constants::MAX_CRC_RETRIES times on mismatch.
+     *
+     * @param connection The connection to send the file over.
+     * @param file The prepared file.
+     * @return true if the server's CRC matched the local CRC, false otherwise.
+     */
+    bool sendWithRetries(ClientSession& connection, const EncryptedFile& file);
+
+    /**
+     * @brief Streams one file and compares the CRCs, reading the file again for every retry.
+     *
+     * @param connection The connection to send the file over.
+     * @param file The file; its size and CRC are filled in.
+     * @param encryptor The file, opened for its first attempt.
+     * @param buffer The buffer of the connection.
+     * @return true if the server's CRC matched the local CRC, false otherwise.
+     */
+    bool streamWithRetries(ClientSession& connection, EncryptedFile& file, std::optional<FileEncryptor>& encryptor, std::vector<char>& buffer);
+
+    /**
+     * @brief Called when a sender loop ends; the last sender closes the queue so workers stop waiting on it.
+     */
+    void senderFinished();
+};
+
+#endif // BATCH_UPLOADER_H
@@ -0,0 +1,79 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/**
+ * @class BoundedQueue
+ * @brief A blocking FIFO queue with a fixed capacity, shared between producer and consumer threads.
+ *
+ * Producers block while the queue is full and consumers block while it is empty. Once the queue is closed,
+ * pushes fail immediately and pops drain the remaining items before failing.
+ *
+ * @tparam T The type of the queued items.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * @brief Constructs an empty queue.
+     * @param capacity The maximum number of items held at once.
+     */
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+    /**
+     * @brief Adds an item to the queue, waiting while the queue is full.
+     * @param item The item to add.
+     * @return true if the item was queued, false if the queue was closed.
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item from the queue, waiting while the queue is empty.
+     * @param item Receives the removed item.
+     * @return true if an item was removed, false if the queue is closed and empty.
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Closes the queue and wakes every waiting thread.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::mutex mutex;                   ///< Guards the items and the closed flag.
+    std::condition_variable notEmpty;   ///< Signalled when an item is added or the queue is closed.
+    std::condition_variable notFull;    ///< Signalled when an item is removed or the queue is closed.
+    std::deque<T> items;                ///< The queued items, oldest first.
+    size_t capacity;                    ///< The maximum number of queued items.
+    bool closed;                        ///< Whether the queue has been closed.
+};
+
+#endif // BOUNDED_QUEUE_H
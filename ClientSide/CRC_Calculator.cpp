@@ -448,23 +448,51 @@ const uint32_t CRC_Calculator::crctab[8][256] = {
  * @param n The size of the memory buffer in bytes.
  * @return The calculated CRC32 checksum.
  */
-unsigned long CRC_Calculator::memcrc(char* b, size_t n) {
-    unsigned int v = 0, c = 0;
-    unsigned long s = 0;
-    unsigned int tabidx;
+unsigned long CRC_Calculator::memcrc(const char* b, size_t n) {
+    return finish(update(0, b, n), n);
+}
+
+/**
+ * @brief Feeds the next bytes of a message to a running checksum.
+ *
+ * Eight bytes at a time go through the sliced tables, crctab[k] holding the CRC of a byte followed by k zero
+ * bytes; the remaining bytes go through crctab[0] one at a time.
+ * @param state The state after the previous parts, 0 for the first part.
+ * @param b Pointer to the next bytes.
+ * @param n The number of bytes.
+ * @return The state after these bytes.
+ */
+unsigned long CRC_Calculator::update(unsigned long state, const char* b, size_t n) {
+    uint32_t s = static_cast<uint32_t>(state);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(b);
 
-    for (int i = 0; i < n; i++) {
-        tabidx = (s >> 24) ^ (unsigned char)b[i];
-        s = UNSIGNED((s << 8)) ^ CRC_Calculator::crctab[0][tabidx];
+    for (; n >= 8; p += 8, n -= 8) {
+        uint32_t high = s ^ (static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 | p[3]);
+        s = crctab[7][high >> 24] ^ crctab[6][(high >> 16) & 0xff] ^ crctab[5][(high >> 8) & 0xff] ^ crctab[4][high & 0xff]
+            ^ crctab[3][p[4]] ^ crctab[2][p[5]] ^ crctab[1][p[6]] ^ crctab[0][p[7]];
+    }
+    for (; n > 0; p++, n--) {
+        s = (s << 8) ^ crctab[0][(s >> 24) ^ *p];
     }
+    return s;
+}
 
-    while (n) {
-        c = n & 0377;
-        n = n >> 8;
+/**
+ * @brief Folds the message length into a running checksum, as memcrc() does.
+ * @param state The state after the last part.
+ * @param length The total number of bytes fed to update().
+ * @return The calculated CRC32 checksum.
+ */
+unsigned long CRC_Calculator::finish(unsigned long state, uint64_t length) {
+    unsigned int c = 0;
+    unsigned long s = state;
+
+    while (length) {
+        c = length & 0377;
+        length = length >> 8;
         s = UNSIGNED(s << 8) ^ CRC_Calculator::crctab[0][(s >> 24) ^ c];
     }
     return (unsigned long)UNSIGNED(~s);
-
 }
 
 /**
@@ -18,20 +18,39 @@ public:
      */
     static unsigned long readFile(const std::string& filePath);
 
-
-private:
-    /**
-     * @brief Precomputed CRC32 table for optimized calculations.
-     */
-    static const uint32_t crctab[8][256];
-
     /**
      * @brief Calculates the CRC32 checksum of a memory buffer.
      * @param b Pointer to the buffer.
      * @param n The number of bytes in the buffer.
      * @return The calculated CRC32 checksum.
      */
-    static unsigned long memcrc(char* b, size_t n);
+    static unsigned long memcrc(const char* b, size_t n);
+
+    /**
+     * @brief Feeds the next bytes of a message to a running checksum.
+     *
+     * Lets a message be checksummed in parts without holding it in memory; start with a state of 0
+     * and pass the final state to finish().
+     * @param state The state after the previous parts.
+     * @param b Pointer to the next bytes.
+     * @param n The number of bytes.
+     * @return The state after these bytes.
+     */
+    static unsigned long update(unsigned long state, const char* b, size_t n);
+
+    /**
+     * @brief Folds the message length into a running checksum, as memcrc() does.
+     * @param state The state after the last part.
+     * @param length The total number of bytes fed to update().
+     * @return The calculated CRC32 checksum, equal to memcrc() of the whole message.
+     */
+    static unsigned long finish(unsigned long state, uint64_t length);
+
+private:
+    /**
+     * @brief Precomputed CRC32 table for optimized calculations.
+     */
+    static const uint32_t crctab[8][256];
 };
 
 #endif // CRC_CALCULATOR_H
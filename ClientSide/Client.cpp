@@ -1,5 +1,17 @@
 #include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
 
 #include "FileHandler.h"
 #include "RequestPayload.h"
@@ -7,38 +19,117 @@
 #include "ResponseHeader.h"
 #include "ResponsePayload.h"
 #include "ClientSission.h"
+#include "BatchUploader.h"
+#include "SyncManifest.h"
+#include "DirectoryWatcher.h"
+#include "UploadDaemon.h"
+#include "TransferMetrics.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "MicroBenchmark.h"
+#include "LoopbackBenchmark.h"
+#include "LoadGenerator.h"
+#include "ProtocolRecorder.h"
+#include "ProtocolReplayer.h"
+#include "FaultyTransport.h"
 
 /**
- * @brief Compares the CRC values of the local file and the file on the server.
+ * @struct ClientOptions
+ * @brief The options given on the command line.
+ */
+struct ClientOptions {
+	UploadOptions upload;                                 ///< The number of upload workers and connections.
+	std::string syncRoot;                                 ///< The directory to sync, or empty to upload the files of the transfer file.
+	std::string manifestPath = Constants::SYNC_MANIFEST_FILE; ///< The manifest of the directory sync or watch.
+	std::vector<std::string> watchRoots;                  ///< The directories to watch, or empty to run once.
+	bool daemon = false;                                  ///< Whether to run as an upload daemon.
+	std::string socketPath = Constants::DAEMON_SOCKET_FILE; ///< The local socket of the upload daemon.
+	std::vector<std::string> submitFiles;                 ///< Files to submit to a running daemon, if any.
+	int priority = Constants::DAEMON_DEFAULT_PRIORITY;     ///< The priority of the submitted files.
+	std::string metricsPath;                              ///< The JSON summary of the last transfer, or empty.
+	std::string metricsLogPath;                           ///< The NDJSON log of every measured phase, or empty.
+	std::string tracePath;                                ///< The Chrome trace of the run, or empty to not trace.
+	LogLevel logLevel = LogLevel::Info;                   ///< The lowest level that is logged.
+	bool logLevelGiven = false;                           ///< Whether the level was given; benchmarks log warnings only otherwise.
+	bool logJson = false;                                 ///< Whether log records are written as JSON lines.
+	bool bench = false;                                   ///< Whether to run the micro-benchmarks instead of uploading.
+	bool benchCheck = false;                              ///< Whether the benchmarks fail when a case allocates over its budget or a streamed upload over its memory limit.
+	bool benchLoopback = false;                           ///< Whether to run the loopback upload benchmark instead of uploading.
+	std::string benchFilter;                              ///< Only benchmark cases whose name contains it, or every case.
+	size_t benchMaxBytes = Constants::BENCH_DEFAULT_MAX_BYTES; ///< The largest benchmark buffer or file size.
+	std::string benchJsonPath;                            ///< The JSON file of the benchmark results, or empty.
+	bool loadTest = false;                                ///< Whether to simulate many clients against the configured server.
+	LoadOptions load;                                     ///< The shape of the simulated load.
+	std::string capturePath;                              ///< The protocol capture of the run, or empty to not capture.
+	std::string replayPath;                               ///< A protocol capture to replay instead of uploading, or empty.
+	bool replayFast = false;                              ///< Whether to replay as fast as possible rather than at the original speed.
+	std::string replayJsonPath;                           ///< The JSON file of the replay report, or empty.
+	FaultOptions faults;                                  ///< The network faults injected into every connection to the server.
+};
+
+/// Set by SIGINT and SIGTERM to end watch mode after the batch in flight.
+std::atomic<bool> stopRequested(false);
+
+/**
+ * @struct TransferInfo
+ * @brief The client settings read from the transfer file and the command line.
+ */
+struct TransferInfo {
+	std::string address;                 ///< The server address.
+	std::string port;                    ///< The server port.
+	std::string userName;                ///< The username of the client.
+	std::vector<std::string> filePaths;  ///< The files to upload, with manifests and globs expanded.
+	std::vector<std::string> fileNames;  ///< The names to upload the files under, by index, or empty for the default.
+	UploadOptions options;               ///< The number of upload workers and connections.
+	std::function<void(const EncryptedFile&)> onUploaded; ///< Called for every file whose CRC was confirmed, if set.
+	std::function<void(const EncryptedFile&)> onRejected; ///< Called for every file that would fail again if resent, if set.
+};
+
+/**
+ * @brief Collects the files to upload from the transfer file.
  *
- * This function compares the CRC of the local file with the CRC provided by the server
- * after encryption. It retries up to 3 times if the CRCs do not match.
+ * Every line from Constants::INFO_FILE_PATH_LINE on is a file path or a glob. A line starting with
+ * Constants::MANIFEST_PREFIX names a manifest file that lists more paths or globs, one per line.
+ * Duplicate paths are uploaded once.
  *
- * @param session The current client session used to communicate with the server.
- * @param filePath The file path to the local file for which the CRC needs to be calculated.
- * @param aesKeyVec The AES key vector used for encryption/decryption.
- * @return true if the CRCs match, false otherwise.
+ * @return The paths of the files to upload, in the order they were listed.
  */
-bool compareCRCs(ClientSession& session, std::string& filePath, const std::vector<char>& aesKeyVec, const std::string& clientId) {
+std::vector<std::string> collectFilePaths() {
+	std::vector<std::string> entries = FileHandler::getLinesFrom(Constants::TRANSFER_FILE, Constants::INFO_FILE_PATH_LINE);
+	std::vector<std::string> filePaths;
+	std::set<std::string> seen;
 
-	unsigned long myCrc = session.getMyCRC(filePath);
-	unsigned long serverCrc = session.getServerCRC(filePath, aesKeyVec, clientId);
-
-	// try up to 3 times to compare CRCs
-	int counter = 0;
-	while (counter < 4 && myCrc != serverCrc) {
-		counter++;
-		myCrc = session.getMyCRC(filePath);
-		serverCrc = session.getServerCRC(filePath, aesKeyVec, clientId);
+	for (const auto& entry : entries) {
+		std::vector<std::string> patterns = { entry };
+		if (entry[0] == Constants::MANIFEST_PREFIX) {
+			patterns = FileHandler::getLinesFrom(entry.substr(1), 1);
+		}
+		for (const auto& pattern : patterns) {
+			for (const auto& path : FileHandler::expandGlob(pattern)) {
+				if (seen.insert(path).second) {
+					filePaths.push_back(path);
+				}
+			}
+		}
 	}
+	return filePaths;
+}
 
-	if (counter == 4) {
-		std::cerr << std::string(Constants::___, '-') << "\nCRC comparison failed after 3 attempts.\tEnd the program\n" << std::string(Constants::___, '-') << std::endl;
-		return false;
-	}
-	
-	std::cout << std::string(Constants::___, '-') << "\nCRC comparison successful.\tEnd the program\n" << std::string(Constants::___, '-') << std::endl;
-	return true;
+/**
+ * @brief Uploads every file of the transfer over the authenticated session.
+ *
+ * The session already holds the unwrapped AES key, which is reused for all the files.
+ *
+ * @param session The authenticated client session used to communicate with the server.
+ * @param info The client settings, including the files to upload.
+ * @param clientId The client ID assigned by the server.
+ * @return true if the CRC of every file was confirmed, false otherwise.
+ */
+bool uploadFiles(ClientSession& session, const TransferInfo& info, const std::string& clientId) {
+	BatchUploader uploader(session, info.address, info.port, clientId, info.options);
+	uploader.setOnUploaded(info.onUploaded);
+	uploader.setOnRejected(info.onRejected);
+	return uploader.upload(info.filePaths, info.fileNames);
 }
 
 /**
@@ -48,40 +139,39 @@ bool compareCRCs(ClientSession& session, std::string& filePath, const std::vecto
  *
  * @param session The current client session used to communicate with the server.
  * @param userName The username of the client.
- * @param filePath The file path to the local file for which the CRC needs to be calculated.
- * @return true if registration and CRC comparison are successful, false otherwise.
+ * @param clientId Receives the client ID assigned by the server.
+ * @return true if registration is successful and the session holds the AES key, false otherwise.
  */
-bool registerNewUser(ClientSession& session, std::string& userName, std::string& filePath) {
+bool registerNewUser(ClientSession& session, const std::string& userName, std::string& clientId) {
+	ScopedPhase phase(Phase::Registration);
 
-	std::cout << std::string(Constants::___, '-') << "\nNo " << Constants::ME_FILE << " file found.\nRegistering as a new user...\n" << std::string(Constants::___, '-') << std::endl;
+	Log::info("Registering as a new user", { { "user", userName } });
 	// Register the user with the server and receive the response header
 	ResponseHeader responseHeader = session.registerUser(userName);
-	std::cout << std::string(Constants::___, '-') << "\nReceiving response payload to registration request...\n" << std::string(Constants::___, '-') << std::endl;
-	std::cout << responseHeader << std::endl;
+	Log::debug("Registration response", { { "code", responseHeader.getCode() }, { "payload_size", responseHeader.getPayloadSize() } });
 
 	// Receive the response payload
 	ResponsePayload responsePayload = session.receiveResponsePayload(responseHeader);
-	std::cout << responsePayload << std::endl;
 
 	if (responseHeader.getCode() == ResponseHeader::Code::RegistrationSuccess) {
 		// Process the client ID and send the public key send public key request and get the response header
 		ResponseHeader publicKeyResponseHeader = session.processClientIDAndSendPublicKey(responsePayload, userName);
-		std::cout << publicKeyResponseHeader << std::endl;
+		Log::debug("Public key response", { { "code", publicKeyResponseHeader.getCode() }, { "payload_size", publicKeyResponseHeader.getPayloadSize() } });
 
 		// Receive the response payload
 		ResponsePayload publicKeyResponsePayload = session.receiveResponsePayload(publicKeyResponseHeader);
-		std::cout << publicKeyResponsePayload << std::endl;
 
-		// get the aes key from the response payload and use it to compare CRCs
+		// get the aes key from the response payload and keep it in the session for the uploads
 		auto aesKey = publicKeyResponsePayload.getField("aes_key");
 		std::string aes_key_str = std::get<std::string>(aesKey);
 		std::vector<char> aesKeyVec(aes_key_str.begin(), aes_key_str.end());
+		session.setAESKey(aesKeyVec);
 
-		std::string clientId = std::get<std::string>(responsePayload.getField("client_id"));
-
-		return compareCRCs(session, filePath, aesKeyVec, clientId);
+		clientId = std::get<std::string>(responsePayload.getField("client_id"));
+		Log::info("Registered", { { "client_id", clientId } });
+		return true;
 	}
-	std::cerr << "Registration failed.\nEnd the program" << std::endl;
+	Log::error("Registration failed", { { "code", responseHeader.getCode() } });
 	return false;
 }
 
@@ -91,77 +181,729 @@ bool registerNewUser(ClientSession& session, std::string& userName, std::string&
  * This function handles the reconnection process of the client to the server.
  *
  * @param session The current client session used to communicate with the server.
- * @param filePath The file path to the local file for which the CRC needs to be calculated.
- * @return true if reconnection and CRC comparison are successful, false otherwise.
+ * @param clientId Receives the client ID assigned by the server.
+ * @return true if reconnection is successful and the session holds the AES key, false otherwise.
  */
-bool reconnectToServer(ClientSession& session, std::string& filePath) {
+bool reconnectToServer(ClientSession& session, std::string& clientId) {
+	ScopedPhase phase(Phase::Reconnect);
 
-	std::cout << std::string(Constants::___, '-') << "\nReconnecting to the server...\n" << std::string(Constants::___, '-') << std::endl;
+	Log::info("Reconnecting to the server");
 	// Reconnect to the server and receive the response header
 	ResponseHeader responseHeader = session.reconnect();
-	std::cout << std::string(Constants::___, '-') << "\nReceiving response payload to reconnecting request...\n" << std::string(Constants::___, '-') << std::endl;
-	std::cout << responseHeader << std::endl;
+	Log::debug("Reconnection response", { { "code", responseHeader.getCode() }, { "payload_size", responseHeader.getPayloadSize() } });
 
 	// Receive the response payload
 	ResponsePayload responsePayload = session.receiveResponsePayload(responseHeader);
-	std::cout << responsePayload << std::endl;
 
 	if (responseHeader.getCode() == ResponseHeader::Code::ReconnectionSuccess) {
 
-		// get the aes key from the response payload and use it to compare CRCs
+		// get the aes key from the response payload and keep it in the session for the uploads
 		auto aesKey = responsePayload.getField("aes_key");
 		std::string aes_key_str = std::get<std::string>(aesKey);
 		std::vector<char> aesKeyVec(aes_key_str.begin(), aes_key_str.end());
+		session.setAESKey(aesKeyVec);
 
-		std::string clientId = std::get<std::string>(responsePayload.getField("client_id"));
-
-		return compareCRCs(session, filePath, aesKeyVec, clientId);
+		clientId = std::get<std::string>(responsePayload.getField("client_id"));
+		Log::info("Reconnected", { { "client_id", clientId } });
+		return true;
 	}
-	std::cerr << std::string(Constants::___, '-') << "Reconnection failed. Trying to register as a new user" << std::string(Constants::___, '-') << std::endl;
+	Log::warn("Reconnection failed, registering as a new user", { { "code", responseHeader.getCode() } });
 	return false;
 }
 
 /**
- * @brief Main function to run the client.
+ * @brief Authenticates the session with the server.
  *
- * This function runs the client by either reconnecting to the server or registering as a new user,
- * depending on the existence of the local ME file.
+ * Reconnects with the stored credentials if the session has them, and registers as a new user otherwise
+ * or when the reconnection fails.
+ *
+ * @param session The current client session used to communicate with the server.
+ * @param userName The username of the client.
+ * @param clientId Receives the client ID assigned by the server.
+ * @return true if the session is authenticated and holds the AES key, false otherwise.
  */
-void runClient() {
+bool authenticate(ClientSession& session, const std::string& userName, std::string& clientId) {
+	if (session.hasCredentials() && reconnectToServer(session, clientId)) {
+		return true;
+	}
+	return registerNewUser(session, userName, clientId);
+}
 
-	// Read the address, port, username, and file path from the transfer file
-	std::cout << std::string(Constants::___, '-') << "\nClient started...\n" << std::string(Constants::___, '-') << std::endl;
+/**
+ * @brief Returns the name a watched file is uploaded under, relative to the first watched directory holding it.
+ *
+ * @param path The path of the file, starting with the watched directory as given.
+ * @param roots The watched directories.
+ * @return The name to upload the file under.
+ */
+std::string watchedFileName(const std::string& path, const std::vector<std::string>& roots) {
+	namespace fs = std::filesystem;
+	fs::path file = fs::path(path).lexically_normal();
+	for (const auto& root : roots) {
+		fs::path relative = file.lexically_relative(fs::path(root).lexically_normal());
+		if (!relative.empty() && *relative.begin() != "..") {
+			return FileHandler::uploadName(path, root);
+		}
+	}
+	return FileHandler::uploadName(path);
+}
+
+/**
+ * @brief Runs the client as a long-running watcher that uploads files as they are written.
+ *
+ * Files changed while the client was not running are sent first; afterwards every debounced batch of
+ * written files is uploaded over one authenticated session, so the reconnection and the RSA unwrap of
+ * the AES key happen once rather than per file. Files that are unchanged according to the manifest are
+ * skipped. Files are named by their path under the watched directory. After a failed batch the session is
+ * dropped and the unconfirmed files are retried on a fresh one after Constants::WATCH_RETRY_DELAY_MS, except
+ * files that were rejected, which wait until they are written again. Runs until SIGINT or SIGTERM, then
+ * compacts the manifest.
+ *
+ * @param options The command line options.
+ * @param info The client settings; its file paths and names are replaced by every batch.
+ * @throws std::runtime_error if the directories cannot be watched.
+ */
+void runWatch(const ClientOptions& options, TransferInfo& info) {
+	DirectoryWatcher watcher(options.watchRoots); // before the catch-up scan, so no write falls in between
+	SyncManifest manifest(options.manifestPath);
+
+	std::set<std::string> pending;
+	for (const auto& root : options.watchRoots) {
+		for (const auto& path : manifest.findChanged(root)) {
+			pending.insert(path);
+		}
+	}
+
+	std::mutex confirmedMutex;
+	std::set<std::string> confirmed;
+	std::set<std::string> rejected;
+	info.onUploaded = [&](const EncryptedFile& file) {
+		manifest.recordUpload(file.filePath, file.crc);
+		std::lock_guard<std::mutex> lock(confirmedMutex);
+		confirmed.insert(file.filePath);
+	};
+	info.onRejected = [&](const EncryptedFile& file) {
+		Log::warn("File not retried until it changes", { { "file", file.filePath }, { "name", file.fileName } });
+		std::lock_guard<std::mutex> lock(confirmedMutex);
+		rejected.insert(file.filePath);
+	};
+
+	std::signal(SIGINT, [](int) { stopRequested = true; });
+	std::signal(SIGTERM, [](int) { stopRequested = true; });
+
+	Log::info("Watching directories. Press Ctrl+C to stop", { { "directories", options.watchRoots.size() } });
+
+	std::unique_ptr<ClientSession> session;
+	std::string clientId;
+	bool retrying = false;
+
+	while (!stopRequested) {
+		if (pending.empty() || retrying) {
+			auto maxWait = std::chrono::milliseconds(retrying ? Constants::WATCH_RETRY_DELAY_MS : Constants::WATCH_MAX_BATCH_DELAY_MS);
+			for (const auto& path : watcher.waitForBatch(stopRequested, maxWait)) {
+				pending.insert(path);
+			}
+			if (stopRequested) {
+				break;
+			}
+		}
+
+		info.filePaths.clear();
+		info.fileNames.clear();
+		for (const auto& path : pending) {
+			if (manifest.checkChanged(path)) {
+				info.filePaths.push_back(path);
+				info.fileNames.push_back(watchedFileName(path, options.watchRoots));
+			}
+		}
+		pending.clear();
+		confirmed.clear();
+		rejected.clear();
+		if (info.filePaths.empty()) {
+			retrying = false;
+			continue;
+		}
+
+		bool uploaded = false;
+		try {
+			if (!session) {
+				session = std::make_unique<ClientSession>(info.address, info.port);
+				if (!authenticate(*session, info.userName, clientId)) {
+					throw std::runtime_error("Authentication failed.");
+				}
+			}
+			uploaded = uploadFiles(*session, info, clientId);
+		}
+		catch (std::exception& e) {
+			Log::error("Batch failed", { { "files", info.filePaths.size() }, { "reason", e.what() } });
+		}
+
+		if (!uploaded) {
+			// The connection may be broken; authenticate again before the next attempt
+			session.reset();
+			for (const auto& path : info.filePaths) {
+				if (confirmed.count(path) == 0 && rejected.count(path) == 0) {
+					pending.insert(path);
+				}
+			}
+		}
+		retrying = !pending.empty(); // only rejected files failed otherwise, and they wait for their next change
+		TransferMetrics::instance().endTransfer();
+	}
+
+	manifest.compact();
+	Log::info("Stopped watching");
+}
+
+/**
+ * @brief Reads the server address, port and username from the transfer file.
+ *
+ * @param info Receives the address, port and username.
+ */
+void readServerInfo(TransferInfo& info) {
+	ScopedPhase phase(Phase::ConfigLoad);
 	std::string address_and_port = FileHandler::getSpecificLine(Constants::TRANSFER_FILE, Constants::INFO_ADDRESS_AND_PORT_LINE);
-	std::string address = address_and_port.substr(0, address_and_port.find(':'));
-	std::string port = address_and_port.substr(address_and_port.find(':') + 1);
-	std::string user_name = FileHandler::getSpecificLine(Constants::TRANSFER_FILE, Constants::INFO_USERNAME_LINE);
-	std::string file_path = FileHandler::getSpecificLine(Constants::TRANSFER_FILE, Constants::INFO_FILE_PATH_LINE);
+	info.address = address_and_port.substr(0, address_and_port.find(':'));
+	info.port = address_and_port.substr(address_and_port.find(':') + 1);
+	info.userName = FileHandler::getSpecificLine(Constants::TRANSFER_FILE, Constants::INFO_USERNAME_LINE);
+}
+
+/**
+ * @brief Main function to run the client.
+ *
+ * This function runs the client by either reconnecting to the server or registering as a new user,
+ * depending on the existence of the local ME file, and then uploads every file listed in the transfer file.
+ * In sync mode the files to upload are instead the new or changed files of the sync directory; when there
+ * are none the client does not connect at all. In watch mode the client keeps running, see runWatch; in daemon
+ * mode it keeps an authenticated session open for files submitted to it, see UploadDaemon.
+ *
+ * @param options The command line options.
+ */
+void runClient(const ClientOptions& options) {
 
-	std::cout << "\nClient details:\nName - " << user_name << "\nFile path - " << file_path << "\nIp address - " << address << "\nPort - " << port << "\n" << std::endl;
+	// Read the address, port, username, and file paths from the transfer file
+	Log::info("Client started");
+	TransferInfo info;
+	readServerInfo(info);
+	info.options = options.upload;
 
 	try {
-		ClientSession session(address, port);
+		if (!options.watchRoots.empty()) {
+			runWatch(options, info);
+			return;
+		}
+		if (options.daemon) {
+			UploadDaemon daemon(options.socketPath, info.address, info.port, options.upload,
+				[&info](ClientSession& session, std::string& clientId) { return authenticate(session, info.userName, clientId); });
+			daemon.run();
+			return;
+		}
+
+		std::unique_ptr<SyncManifest> manifest;
+		if (!options.syncRoot.empty()) {
+			{
+				ScopedPhase phase(Phase::ConfigLoad);
+				manifest = std::make_unique<SyncManifest>(options.manifestPath);
+				info.filePaths = manifest->findChanged(options.syncRoot);
+				for (const auto& path : info.filePaths) {
+					info.fileNames.push_back(FileHandler::uploadName(path, options.syncRoot));
+				}
+			}
+			info.onUploaded = [&manifest](const EncryptedFile& file) { manifest->recordUpload(file.filePath, file.crc); };
 
-		if (FileHandler::isFileExist(Constants::ME_FILE)) {
-			if (!reconnectToServer(session, file_path)) {
-				registerNewUser(session, user_name, file_path);
+			if (info.filePaths.empty()) {
+				Log::info("Sync directory is up to date", { { "directory", options.syncRoot } });
+				TransferMetrics::instance().endTransfer();
+				return;
 			}
 		}
 		else {
-			registerNewUser(session, user_name, file_path);
+			ScopedPhase phase(Phase::ConfigLoad);
+			info.filePaths = collectFilePaths();
+		}
+
+		Log::info("Client details", { { "user", info.userName }, { "files", info.filePaths.size() }, { "address", info.address }, { "port", info.port } });
+
+		ClientSession session(info.address, info.port);
+		std::string clientId;
+
+		if (authenticate(session, info.userName, clientId)) {
+			if (uploadFiles(session, info, clientId)) {
+				Log::info("CRC comparison successful");
+			}
+			else {
+				Log::error("Not every file was uploaded");
+			}
+		}
+
+		if (manifest) {
+			manifest->compact();
+		}
+	}
+	catch (std::exception& e) {
+		Log::error("Client failed", { { "reason", e.what() } });
+	}
+	TransferMetrics::instance().endTransfer();
+}
+
+/**
+ * @brief Runs the micro-benchmarks, or the loopback upload benchmark, and prints their results.
+ *
+ * The loopback benchmark authenticates the way the client does, as a user of its own. With --bench-check the
+ * streaming memory check of the loopback benchmark runs first, while the process has not used much memory.
+ * @param options The command line options.
+ * @return 0 if the benchmarks ran and their results were written, 1 otherwise, or with --bench-check when a
+ * case allocated over its budget or a streamed upload grew the peak resident set over its limit.
+ */
+int runBenchmarks(const ClientOptions& options) {
+	try {
+		LoopbackBenchmark loopback(options.benchFilter, options.benchMaxBytes,
+			[](ClientSession& session, std::string& clientId) { return authenticate(session, "benchmark", clientId); });
+		if (options.benchLoopback) {
+			std::vector<LoopbackResult> results = loopback.run(std::cout);
+			if (!options.benchJsonPath.empty()) {
+				LoopbackBenchmark::writeJson(results, options.benchJsonPath);
+			}
+			return 0;
+		}
+
+		bool withinMemory = !options.benchCheck || loopback.checkStreamingMemory(std::cout);
+		MicroBenchmark benchmark(options.benchFilter, options.benchMaxBytes);
+		std::vector<BenchmarkResult> results = benchmark.run(std::cout);
+		if (!options.benchJsonPath.empty()) {
+			MicroBenchmark::writeJson(results, options.benchJsonPath);
+		}
+		if (options.benchCheck && !MicroBenchmark::checkBudgets(results, std::cerr)) {
+			return 1;
+		}
+		return withinMemory ? 0 : 1;
+	}
+	catch (std::exception& e) {
+		Log::error("Benchmark failed", { { "reason", e.what() } });
+		return 1;
+	}
+}
+
+/**
+ * @brief Simulates many concurrent clients against the server of the transfer file and prints the report.
+ *
+ * The simulated users are named after the username of the transfer file, and authenticate the way the
+ * client does.
+ * @param options The command line options.
+ * @return 0 if the load ran and its report was written, 1 otherwise.
+ */
+int runLoad(const ClientOptions& options) {
+	try {
+		TransferInfo info;
+		readServerInfo(info);
+		LoadGenerator generator(info.address, info.port, info.userName, options.load, reconnectToServer, registerNewUser);
+		LoadReport report = generator.run(std::cout);
+		if (!options.load.jsonPath.empty()) {
+			LoadGenerator::writeJson(report, options.load.jsonPath);
+		}
+		return 0;
+	}
+	catch (std::exception& e) {
+		Log::error("Load test failed", { { "reason", e.what() } });
+		return 1;
+	}
+}
+
+/**
+ * @brief Replays a protocol capture to the server of the transfer file and prints the report.
+ *
+ * @param options The command line options.
+ * @return 0 if the capture was replayed and its report was written, 1 otherwise.
+ */
+int runReplay(const ClientOptions& options) {
+	try {
+		TransferInfo info;
+		readServerInfo(info);
+		ProtocolReplayer replayer(options.replayPath, info.address, info.port, !options.replayFast);
+		ReplayReport report = replayer.run(std::cout);
+		if (!options.replayJsonPath.empty()) {
+			ProtocolReplayer::writeJson(report, options.replayJsonPath);
 		}
+		return 0;
 	}
 	catch (std::exception& e) {
-		std::cerr << "Error: " << e.what() << std::endl;
+		Log::error("Replay failed", { { "reason", e.what() } });
+		return 1;
+	}
+}
+
+/**
+ * @brief Parses a size in bytes with an optional binary suffix: K, M or G, optionally followed by "iB".
+ *
+ * @param text The size, for example 4096, 64K or 64MiB.
+ * @return The size in bytes.
+ * @throws std::invalid_argument if the text is not a size.
+ * @throws std::out_of_range if the size does not fit in size_t.
+ */
+size_t parseByteSize(const std::string& text) {
+	// std::stoull would accept leading blanks and a sign, and wrap a negative size around
+	if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+		throw std::invalid_argument("Not a size: " + text);
+	}
+	size_t end = 0;
+	unsigned long long size = 0;
+	try {
+		size = std::stoull(text, &end);
+	}
+	catch (const std::out_of_range&) {
+		throw std::out_of_range("Size too large: " + text);
+	}
+	std::string suffix = text.substr(end);
+	if (suffix.size() == 3 && suffix.compare(1, 2, "iB") == 0) {
+		suffix.resize(1);
+	}
+	int shift = -1;
+	if (suffix.empty()) {
+		shift = 0;
+	}
+	else if (suffix.size() == 1) {
+		switch (suffix[0]) {
+		case 'K': case 'k': shift = 10; break;
+		case 'M': case 'm': shift = 20; break;
+		case 'G': case 'g': shift = 30; break;
+		}
+	}
+	if (shift < 0) {
+		throw std::invalid_argument("Not a size: " + text);
+	}
+	if (size > (std::numeric_limits<size_t>::max() >> shift)) {
+		throw std::out_of_range("Size too large: " + text);
 	}
+	return static_cast<size_t>(size) << shift;
+}
+
+/**
+ * @brief Parses a whole number within a range.
+ *
+ * @param text The number.
+ * @param min The smallest accepted value.
+ * @param max The largest accepted value.
+ * @return The number.
+ * @throws std::invalid_argument if the text is not a whole number.
+ * @throws std::out_of_range if the number is outside the range.
+ */
+long long parseInteger(const std::string& text, long long min, long long max) {
+	if (text.empty() || std::isspace(static_cast<unsigned char>(text[0]))) {
+		throw std::invalid_argument("Not a whole number: " + text);
+	}
+	size_t end = 0;
+	long long value = 0;
+	try {
+		value = std::stoll(text, &end);
+	}
+	catch (const std::out_of_range&) {
+		throw std::out_of_range("Too large: " + text);
+	}
+	catch (const std::invalid_argument&) {
+		throw std::invalid_argument("Not a whole number: " + text);
+	}
+	if (end != text.size()) {
+		throw std::invalid_argument("Not a whole number: " + text);
+	}
+	if (value < min || value > max) {
+		throw std::out_of_range("Not between " + std::to_string(min) + " and " + std::to_string(max) + ": " + text);
+	}
+	return value;
+}
+
+/**
+ * @brief Parses a number within a range.
+ *
+ * @param text The number.
+ * @param min The smallest accepted value.
+ * @param max The largest accepted value.
+ * @return The number.
+ * @throws std::invalid_argument if the text is not a number.
+ * @throws std::out_of_range if the number is outside the range.
+ */
+double parseNumber(const std::string& text, double min, double max) {
+	if (text.empty() || std::isspace(static_cast<unsigned char>(text[0]))) {
+		throw std::invalid_argument("Not a number: " + text);
+	}
+	size_t end = 0;
+	double value = 0;
+	try {
+		value = std::stod(text, &end);
+	}
+	catch (const std::out_of_range&) {
+		throw std::out_of_range("Out of range: " + text);
+	}
+	catch (const std::invalid_argument&) {
+		throw std::invalid_argument("Not a number: " + text);
+	}
+	if (end != text.size()) {
+		throw std::invalid_argument("Not a number: " + text);
+	}
+	if (!(value >= min && value <= max)) {
+		throw std::out_of_range("Out of range: " + text);
+	}
+	return value;
+}
+
+/**
+ * @brief Parses a mix of file sizes: comma-separated sizes, each optionally followed by a colon and its weight.
+ *
+ * @param text The mix, for example 4K:60,64K:30,1M:10.
+ * @return The sizes; a size without a weight weighs 1.
+ * @throws std::invalid_argument if a size or weight is malformed.
+ * @throws std::out_of_range if a size or weight is out of range.
+ */
+std::vector<LoadFileSize> parseSizeMix(const std::string& text) {
+	std::vector<LoadFileSize> sizes;
+	size_t begin = 0;
+	while (begin <= text.size()) {
+		size_t end = std::min(text.find(',', begin), text.size());
+		std::string item = text.substr(begin, end - begin);
+		size_t colon = item.find(':');
+		LoadFileSize size;
+		size.bytes = parseByteSize(item.substr(0, colon));
+		size.weight = colon == std::string::npos ? 1 : parseNumber(item.substr(colon + 1), 0, std::numeric_limits<double>::max());
+		if (size.weight <= 0) {
+			throw std::invalid_argument("Not a weight: " + item);
+		}
+		sizes.push_back(size);
+		begin = end + 1;
+	}
+	return sizes;
+}
+
+/**
+ * @brief Prints the command line usage to the standard error.
+ *
+ * @param program The name the client was started as.
+ */
+void printUsage(const char* program) {
+	std::cerr << "Usage: " << program
+		<< " [--workers=N] [--connections=N] [--max-buffer=SIZE] [--sync=DIR | --watch=DIR... | --daemon] [--manifest=FILE] [--socket=FILE]\n"
+		<< "       " << program << " ... [--metrics=FILE] [--metrics-log=FILE] [--trace=FILE] [--capture=FILE] [--log-level=debug|info|warn|error|off] [--log-json]\n"
+		<< "       " << program << " [--socket=FILE] [--priority=N] --submit FILE...\n"
+		<< "       " << program << " --bench[=FILTER] | --bench-check[=FILTER] | --bench-loopback[=FILTER] [--bench-max-size=SIZE] [--bench-json=FILE]\n"
+		<< "       " << program << " --load=CLIENTS [--load-duration=SECONDS] [--load-rate=PER_SECOND] [--load-think=MS] [--load-uploads=N]\n"
+		<< "       " << program << " ... [--load-sizes=SIZE[:WEIGHT],...] [--load-cache=DIR] [--load-json=FILE]\n"
+		<< "       " << program << " --replay=FILE [--replay-fast] [--replay-json=FILE]\n"
+		<< "       " << program << " ... [--fault-delay=MS] [--fault-bandwidth=SIZE] [--fault-chunk=SIZE] [--fault-stall=PROBABILITY:MS]\n"
+		<< "       " << program << " ... [--fault-reset=PROBABILITY] [--fault-seed=N]" << std::endl;
+}
+
+/**
+ * @brief Parses the command line options.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param options Receives the parsed options.
+ * @return true if every argument was recognized, false otherwise.
+ */
+bool parseOptions(int argc, char* argv[], ClientOptions& options) {
+	auto valueOf = [](const std::string& arg, const std::string& name) { return arg.substr(name.size()); };
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		try {
+			if (arg.rfind("--workers=", 0) == 0) {
+				options.upload.workers = parseInteger(valueOf(arg, "--workers="), 1, Constants::MAX_UPLOAD_WORKERS);
+			}
+			else if (arg.rfind("--connections=", 0) == 0) {
+				options.upload.connections = parseInteger(valueOf(arg, "--connections="), 1, Constants::MAX_UPLOAD_CONNECTIONS);
+			}
+			else if (arg.rfind("--max-buffer=", 0) == 0) {
+				options.upload.maxBuffer = parseByteSize(valueOf(arg, "--max-buffer="));
+			}
+			else if (arg.rfind("--sync=", 0) == 0) {
+				options.syncRoot = valueOf(arg, "--sync=");
+			}
+			else if (arg.rfind("--manifest=", 0) == 0) {
+				options.manifestPath = valueOf(arg, "--manifest=");
+			}
+			else if (arg.rfind("--watch=", 0) == 0) {
+				options.watchRoots.push_back(valueOf(arg, "--watch="));
+			}
+			else if (arg == "--daemon") {
+				options.daemon = true;
+			}
+			else if (arg.rfind("--socket=", 0) == 0) {
+				options.socketPath = valueOf(arg, "--socket=");
+			}
+			else if (arg.rfind("--priority=", 0) == 0) {
+				options.priority = parseInteger(valueOf(arg, "--priority="), INT_MIN, INT_MAX);
+			}
+			else if (arg.rfind("--metrics=", 0) == 0) {
+				options.metricsPath = valueOf(arg, "--metrics=");
+			}
+			else if (arg.rfind("--metrics-log=", 0) == 0) {
+				options.metricsLogPath = valueOf(arg, "--metrics-log=");
+			}
+			else if (arg.rfind("--trace=", 0) == 0) {
+				options.tracePath = valueOf(arg, "--trace=");
+			}
+			else if (arg.rfind("--log-level=", 0) == 0 && Logger::parseLevel(valueOf(arg, "--log-level="), options.logLevel)) {
+				options.logLevelGiven = true;
+			}
+			else if (arg == "--log-json") {
+				options.logJson = true;
+			}
+			else if (arg == "--bench" || arg.rfind("--bench=", 0) == 0) {
+				options.bench = true;
+				options.benchFilter = arg == "--bench" ? "" : valueOf(arg, "--bench=");
+			}
+			else if (arg == "--bench-check" || arg.rfind("--bench-check=", 0) == 0) {
+				options.bench = true;
+				options.benchCheck = true;
+				options.benchFilter = arg == "--bench-check" ? "" : valueOf(arg, "--bench-check=");
+			}
+			else if (arg == "--bench-loopback" || arg.rfind("--bench-loopback=", 0) == 0) {
+				options.benchLoopback = true;
+				options.benchFilter = arg == "--bench-loopback" ? "" : valueOf(arg, "--bench-loopback=");
+			}
+			else if (arg.rfind("--bench-max-size=", 0) == 0) {
+				options.benchMaxBytes = parseByteSize(valueOf(arg, "--bench-max-size="));
+			}
+			else if (arg.rfind("--bench-json=", 0) == 0) {
+				options.benchJsonPath = valueOf(arg, "--bench-json=");
+			}
+			else if (arg.rfind("--load=", 0) == 0) {
+				options.loadTest = true;
+				options.load.clients = parseInteger(valueOf(arg, "--load="), 1, Constants::MAX_LOAD_CLIENTS);
+			}
+			else if (arg.rfind("--load-duration=", 0) == 0) {
+				options.load.durationSeconds = parseInteger(valueOf(arg, "--load-duration="), 1, INT_MAX);
+			}
+			else if (arg.rfind("--load-rate=", 0) == 0) {
+				options.load.arrivalRate = parseNumber(valueOf(arg, "--load-rate="), 0, std::numeric_limits<double>::max());
+			}
+			else if (arg.rfind("--load-think=", 0) == 0) {
+				options.load.thinkTimeMs = parseInteger(valueOf(arg, "--load-think="), 0, INT_MAX);
+			}
+			else if (arg.rfind("--load-uploads=", 0) == 0) {
+				options.load.uploadsPerSession = parseInteger(valueOf(arg, "--load-uploads="), 1, INT_MAX);
+			}
+			else if (arg.rfind("--load-sizes=", 0) == 0) {
+				options.load.sizes = parseSizeMix(valueOf(arg, "--load-sizes="));
+			}
+			else if (arg.rfind("--load-cache=", 0) == 0) {
+				options.load.cacheDir = valueOf(arg, "--load-cache=");
+			}
+			else if (arg.rfind("--load-json=", 0) == 0) {
+				options.load.jsonPath = valueOf(arg, "--load-json=");
+			}
+			else if (arg.rfind("--capture=", 0) == 0) {
+				options.capturePath = valueOf(arg, "--capture=");
+			}
+			else if (arg.rfind("--replay=", 0) == 0) {
+				options.replayPath = valueOf(arg, "--replay=");
+			}
+			else if (arg == "--replay-fast") {
+				options.replayFast = true;
+			}
+			else if (arg.rfind("--replay-json=", 0) == 0) {
+				options.replayJsonPath = valueOf(arg, "--replay-json=");
+			}
+			else if (arg.rfind("--fault-delay=", 0) == 0) {
+				options.faults.delayMs = parseInteger(valueOf(arg, "--fault-delay="), 0, INT_MAX);
+			}
+			else if (arg.rfind("--fault-bandwidth=", 0) == 0) {
+				options.faults.bandwidth = parseByteSize(valueOf(arg, "--fault-bandwidth="));
+			}
+			else if (arg.rfind("--fault-chunk=", 0) == 0) {
+				options.faults.maxChunk = parseByteSize(valueOf(arg, "--fault-chunk="));
+			}
+			else if (arg.rfind("--fault-stall=", 0) == 0) {
+				std::string stall = valueOf(arg, "--fault-stall=");
+				options.faults.stallProbability = parseNumber(stall.substr(0, stall.find(':')), 0, 1);
+				options.faults.stallMs = stall.find(':') == std::string::npos ? 0 : parseInteger(stall.substr(stall.find(':') + 1), 0, INT_MAX);
+			}
+			else if (arg.rfind("--fault-reset=", 0) == 0) {
+				options.faults.resetProbability = parseNumber(valueOf(arg, "--fault-reset="), 0, 1);
+			}
+			else if (arg.rfind("--fault-seed=", 0) == 0) {
+				options.faults.seed = parseInteger(valueOf(arg, "--fault-seed="), 0, UINT_MAX);
+			}
+			else if (arg == "--submit" && i + 1 < argc) {
+				options.submitFiles.assign(argv + i + 1, argv + argc);
+				break;
+			}
+			else {
+				std::cerr << "Unknown argument: " << arg << std::endl;
+				printUsage(argv[0]);
+				return false;
+			}
+		}
+		catch (const std::logic_error& e) {
+			// std::invalid_argument or std::out_of_range, from a malformed or out of range value
+			std::cerr << "Invalid value: " << arg << " (" << e.what() << ")" << std::endl;
+			printUsage(argv[0]);
+			return false;
+		}
+	}
+	if (options.load.sizes.empty()) {
+		options.load.sizes = parseSizeMix(Constants::LOAD_DEFAULT_SIZES);
+	}
+	return true;
 }
 
 /**
  * @brief Main entry point of the client program.
  *
- * Calls the runClient function and returns 0 when the client execution is completed.
+ * Parses the command line, calls the runClient function and returns 0 when the client execution is completed.
+ * With --submit it only hands the files to a running daemon, without reading the transfer file, and returns
+ * 0 if every file was uploaded. With --bench it runs the micro-benchmarks instead, --bench-check also fails if a
+ * case allocates over its budget, and with --bench-loopback it uploads to an in-process stand-in server instead of the configured one. With --load it simulates many clients
+ * against the configured server, and with --replay it sends the requests of a protocol capture to it again.
+ * The --fault options slow down or break every connection to the server, in any of these modes.
  */
-int main() {
-	runClient();
+int main(int argc, char* argv[]) {
+	ClientOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		return 1;
+	}
+	if (!options.submitFiles.empty()) {
+		try {
+			return UploadDaemon::submit(options.socketPath, options.submitFiles, options.priority) ? 0 : 1;
+		}
+		catch (std::exception& e) {
+			std::cerr << "Error: could not reach the daemon at " << options.socketPath << ": " << e.what() << std::endl;
+			return 1;
+		}
+	}
+	bool benchmarking = options.bench || options.benchLoopback || options.loadTest || !options.replayPath.empty();
+	Logger::instance().configure(benchmarking && !options.logLevelGiven ? LogLevel::Warn : options.logLevel, options.logJson);
+	FaultyTransport::configure(options.faults);
+	if (benchmarking) {
+		int result = options.loadTest ? runLoad(options) : !options.replayPath.empty() ? runReplay(options) : runBenchmarks(options);
+		Logger::instance().flush();
+		return result;
+	}
+	try {
+		TransferMetrics::instance().open(options.metricsPath, options.metricsLogPath);
+		if (!options.capturePath.empty()) {
+			ProtocolRecorder::instance().start(options.capturePath);
+		}
+	}
+	catch (std::exception& e) {
+		Log::error("Could not open the metrics or capture files", { { "reason", e.what() } });
+		Logger::instance().flush();
+		return 1;
+	}
+	if (!options.tracePath.empty()) {
+		Tracer::instance().start(options.tracePath);
+	}
+	runClient(options);
+	try {
+		Tracer::instance().write();
+	}
+	catch (std::exception& e) {
+		Log::error("Could not write the trace", { { "reason", e.what() } });
+	}
+	try {
+		ProtocolRecorder::instance().stop();
+	}
+	catch (std::exception& e) {
+		Log::error("Could not write the capture", { { "reason", e.what() } });
+	}
+	Logger::instance().flush();
     return 0;
 }
@@ -1,5 +1,8 @@
 #include "ClientSission.h"
 
+#include <algorithm>
+#include <filesystem>
+
 using boost::asio::ip::tcp;
 using namespace boost::asio;
 
@@ -9,10 +12,64 @@ using namespace boost::asio;
  * This constructor uses Boost ASIO to initialize a TCP connection to the server using the specified address and port.
  * @param address The server address.
  * @param port The port to connect to.
+ * @param credentialsDir The directory of the ME and private key files; empty for the working directory.
  */
-ClientSession::ClientSession(const std::string& address, const std::string& port)
-    : socket(io_context), resolver(io_context) {
+ClientSession::ClientSession(const std::string& address, const std::string& port, const std::string& credentialsDir)
+    : credentialsDir(credentialsDir) {
     connectToServer(address, port);
+    if (ProtocolRecorder::enabled()) {
+        captureSession = ProtocolRecorder::instance().openSession(address + ":" + port);
+    }
+}
+
+/**
+ * @brief Constructor that uses an established connection to the server, such as a FaultyTransport.
+ *
+ * @param transport The connection.
+ * @param credentialsDir The directory of the ME and private key files; empty for the working directory.
+ */
+ClientSession::ClientSession(std::unique_ptr<Transport> transport, const std::string& credentialsDir)
+    : transport(std::move(transport)), credentialsDir(credentialsDir) {
+    if (ProtocolRecorder::enabled()) {
+        captureSession = ProtocolRecorder::instance().openSession("");
+    }
+}
+
+/**
+ * @brief Destructor that ends the session in the protocol capture, if it is recorded.
+ */
+ClientSession::~ClientSession() {
+    if (captureSession != 0) {
+        ProtocolRecorder::instance().record(captureSession, CaptureEvent::Close);
+    }
+}
+
+/**
+ * @brief Checks whether credentials of an earlier registration are stored, so that reconnect() can be tried.
+ *
+ * @return true if the ME file exists.
+ */
+bool ClientSession::hasCredentials() const {
+    return FileHandler::isFileExist(credentialPath(Constants::ME_FILE));
+}
+
+/**
+ * @brief Returns the code of the latest response header received.
+ *
+ * @return The response code, or 0 if no response was received yet.
+ */
+int ClientSession::lastResponseCode() const {
+    return lastCode;
+}
+
+/**
+ * @brief Returns the path of a credentials file in the credentials directory.
+ *
+ * @param fileName The file name, Constants::ME_FILE or Constants::PRIV_FILE.
+ * @return The path of the file.
+ */
+std::string ClientSession::credentialPath(const std::string& fileName) const {
+    return credentialsDir.empty() ? fileName : (std::filesystem::path(credentialsDir) / fileName).string();
 }
 
 /**
@@ -24,14 +81,14 @@ ClientSession::ClientSession(const std::string& address, const std::string& port
  */
 ResponseHeader ClientSession::reconnect() {
 	// get username and clientID from me.info
-    std::string userName = FileHandler::getSpecificLine(Constants::ME_FILE, Constants::ME_USERNAME_LINE);
-    std::string clientID = FileHandler::getSpecificLine(Constants::ME_FILE, Constants::ME_CLIENT_ID_LINE);
+    std::string userName = FileHandler::getSpecificLine(credentialPath(Constants::ME_FILE), Constants::ME_USERNAME_LINE);
+    std::string clientID = FileHandler::getSpecificLine(credentialPath(Constants::ME_FILE), Constants::ME_CLIENT_ID_LINE);
 
 	// create reconnecting request
     Request request = prepareReconnectionRequest(userName, clientID);
 
-	std::cout << std::string(Constants::___, '-') << "\nSending reconnection request to the server...\n" << std::string(Constants::___, '-') << std::endl;
-	std::cout << request << std::endl;
+	Log::info("Sending reconnection request", { { "user", userName } });
+	Log::debug("Reconnection request", { { "bytes", request.size() }, { "client_id", clientID } });
 
     sendRequest(request);
 
@@ -50,8 +107,8 @@ ResponseHeader ClientSession::registerUser(const std::string& userName) {
 	// create registration request
     Request request = prepareRegistrationRequest(userName);
 
-	std::cout << std::string(Constants::___, '-') << "\nSending registration request to the server...\n" << std::string(Constants::___, '-') << std::endl;
-    std::cout << request << std::endl;
+	Log::info("Sending registration request", { { "user", userName } });
+	Log::debug("Registration request", { { "bytes", request.size() } });
 
     sendRequest(request);
 
@@ -80,66 +137,144 @@ unsigned long ClientSession::getMyCRC(const std::string& filePath) {
 }
 
 /**
- * @brief Encrypts a file and sends it to the server, then retrieves the server's CRC.
+ * @brief Sends an encrypted file to the server, then retrieves the server's CRC.
  *
- * This method encrypts the file at the specified path using the provided AES key, sends the file to the server in packets,
+ * This method splits the encrypted file content into packets, sends them to the server,
  * and retrieves the CRC calculated by the server.
- * @param filePath The path of the file to send.
- * @param encryptedAESKey The AES key to use for encryption.
+ * @param fileName The file name reported to the server.
+ * @param origFileSize The size of the file before encryption.
+ * @param encryptedFile The encrypted file content.
+ * @param clientId The client ID to put in the request headers.
  * @return The CRC value calculated by the server.
  */
-unsigned long ClientSession::getServerCRC(std::string& filePath, const std::vector<char>& encryptedAESKey, const std::string& clientId) {
+unsigned long ClientSession::getServerCRC(const std::string& fileName, int origFileSize, const std::vector<char>& encryptedFile, const std::string& clientId) {
 
 	// initialize the payload request as it need to be by the given protocol
-    int origFileSize = FileHandler::getFileSize(filePath);
-    std::vector<char> encryptedFile = encryptFileWithAES(filePath, encryptedAESKey);
     int encryptedFileSize = encryptedFile.size();
-    int messageContentSize = Constants::PACKET_SIZE - Constants::REQUEST_HEADER_SIZE - Constants::CONTENT_SIZE_SIZE - Constants::ORIG_FILE_SIZE_SIZE - Constants::PACKET_NUMBER_SIZE
-        - Constants::TOTAL_PACKET_SIZE - Constants::FILE_NAME_SIZE;
+    int messageContentSize = Constants::PACKET_CONTENT_SIZE;
     // Calculate the number of packets to send ceiling value
     int numPackets = (encryptedFileSize + messageContentSize - 1) / messageContentSize;
 
 
-    std::cout << std::string(Constants::___, '-') << "\nSending the file to the server in " << numPackets << " packets...\n" << std::string(Constants::___, '-') << std::endl;
+    Log::info("Sending file", { { "file", fileName }, { "bytes", encryptedFileSize }, { "packets", numPackets } });
 
 
     // Send the file in packets
-    for (int packetNumber = 1; packetNumber <= numPackets; packetNumber++) {
-        // create payload request
-        RequestPayload payload;
-        payload.setContentSize(encryptedFileSize);
-        payload.setOrigFileSize(origFileSize);
-        payload.setPacketNumber(packetNumber);
-        payload.setTotalPackets(numPackets);
-        payload.setFileName(filePath);
-
-        if (packetNumber == numPackets) { // last packet
-            std::vector<char> messageContent(encryptedFile.begin() + (packetNumber - 1) * messageContentSize, encryptedFile.end());
-            int size = messageContent.size();
-            payload.setContent(messageContent);
-        }
-        else { // not last packet (middle or first packet
-            std::vector<char> messageContent(encryptedFile.begin() + (packetNumber - 1) * messageContentSize, encryptedFile.begin() + packetNumber * messageContentSize);
-            int size = messageContent.size();
-            payload.setContent(messageContent);
-        }
+    auto sendStart = TransferMetrics::Clock::now();
+    FilePacketEncoder encoder(clientId, fileName, origFileSize, encryptedFileSize, numPackets);
+    sendFileContent(encoder, encryptedFile.data(), encryptedFile.size());
+    TransferMetrics::instance().record(Phase::Send, sendStart, encryptedFileSize, fileName);
 
+    return receiveServerCRC(fileName);
+}
 
-        // create header request
-        RequestHeader header(clientId, Constants::VERSION, RequestHeader::Code::SendFileCode, payload.size());
-        // create request
-        Request request(header, payload);
-        // send request
-        sendRequest(request);
+/**
+ * @brief Sends a file to the server while reading and encrypting it, then retrieves the server's CRC.
+ *
+ * Every chunk the FileEncryptor returns except the last holds whole packets, so each chunk is sent before the
+ * next one is read into the same buffer.
+ * @param fileName The file name reported to the server.
+ * @param file The file, opened but not yet read.
+ * @param clientId The client ID to put in the request headers.
+ * @return The CRC value calculated by the server.
+ * @throws std::runtime_error if the file cannot be read; the connection is then in the middle of a file.
+ */
+unsigned long ClientSession::getServerCRC(const std::string& fileName, FileEncryptor& file, const std::string& clientId) {
+    uint64_t encryptedFileSize = file.encryptedSize();
+    uint64_t numPackets = (encryptedFileSize + Constants::PACKET_CONTENT_SIZE - 1) / Constants::PACKET_CONTENT_SIZE;
+
+    Log::info("Streaming file", { { "file", fileName }, { "bytes", encryptedFileSize }, { "packets", numPackets } });
+
+    auto sendStart = TransferMetrics::Clock::now();
+    FilePacketEncoder encoder(clientId, fileName, static_cast<int>(file.size()), static_cast<int>(encryptedFileSize), static_cast<int>(numPackets));
+    for (size_t length = file.next(); length > 0; length = file.next()) {
+        sendFileContent(encoder, file.data(), length);
+    }
+    TransferMetrics::instance().record(Phase::Send, sendStart, encryptedFileSize, fileName);
+
+    return receiveServerCRC(fileName);
+}
+
+/**
+ * @brief Sends part of a file to the server as packets, encoded into the session's frames.
+ *
+ * Packets are encoded in place until the pool runs out of frames, then written together; nothing is allocated
+ * per packet.
+ * @param encoder The packets of the file; numbers the packets across calls.
+ * @param content The encrypted bytes, a whole number of packets unless they end the file.
+ * @param length The number of bytes.
+ */
+void ClientSession::sendFileContent(FilePacketEncoder& encoder, const char* content, size_t length) {
+    if (!frames) {
+        frames = std::make_unique<FramePool>(Constants::PACKET_SIZE, Constants::FRAME_POOL_FRAMES, Constants::FRAME_ALIGNMENT);
     }
+    char* batch[Constants::FRAME_POOL_FRAMES];
+    size_t lengths[Constants::FRAME_POOL_FRAMES];
+    size_t count = 0;
+    for (size_t offset = 0; offset < length; offset += Constants::PACKET_CONTENT_SIZE) {
+        char* frame = frames->acquire();
+        if (frame == nullptr) {
+            writeFrames(batch, lengths, count);
+            count = 0;
+            frame = frames->acquire();
+        }
+        TraceSpan packetSpan("packet", "net", "packet", encoder.packetNumber());
+        lengths[count] = encoder.encode(frame, content + offset, std::min<size_t>(Constants::PACKET_CONTENT_SIZE, length - offset));
+        batch[count++] = frame;
+    }
+    writeFrames(batch, lengths, count);
+}
+
+/**
+ * @brief Writes encoded frames to the server, adjacent full frames in one write, and returns them to the pool.
+ *
+ * The frames are returned even if a write fails.
+ * @param batch The frames, in the order of their packets.
+ * @param lengths The number of bytes of each frame.
+ * @param count The number of frames.
+ */
+void ClientSession::writeFrames(char* const* batch, const size_t* lengths, size_t count) {
+    try {
+        if (captureSession != 0) {
+            for (size_t i = 0; i < count; i++) {
+                ProtocolRecorder::instance().record(captureSession, CaptureEvent::Request, batch[i], lengths[i]);
+            }
+        }
+        for (size_t first = 0, next; first < count; first = next) {
+            size_t bytes = lengths[first];
+            for (next = first + 1; next < count && batch[next] == batch[first] + bytes; next++) {
+                bytes += lengths[next];
+            }
+            TraceSpan span("write", "net", "bytes", bytes);
+            transport->write(batch[first], bytes);
+        }
+    }
+    catch (...) {
+        for (size_t i = count; i-- > 0; ) {
+            frames->release(batch[i]);
+        }
+        throw;
+    }
+    for (size_t i = count; i-- > 0; ) {
+        frames->release(batch[i]);
+    }
+}
+
+/**
+ * @brief Receives the response to a sent file.
+ *
+ * @param fileName The file name, for the log.
+ * @return The CRC calculated by the server, or -1 if the server did not confirm the file.
+ */
+unsigned long ClientSession::receiveServerCRC(const std::string& fileName) {
     // Receive the final response - contains the CRC
+    ScopedPhase awaitPhase(Phase::AwaitServerCrc, 0, fileName);
 
-    std::cout << std::string(Constants::___, '-') << "\nFile sent. Waiting for the server to calculate the CRC...\n" << std::string(Constants::___, '-') << std::endl;
+    Log::debug("File sent, waiting for the server CRC", { { "file", fileName } });
 
     ResponseHeader finalResponseHeader = receiveResponseHeader();
-    std::cout << finalResponseHeader << std::endl;
+    Log::debug("File response", { { "file", fileName }, { "code", finalResponseHeader.getCode() }, { "payload_size", finalResponseHeader.getPayloadSize() } });
     ResponsePayload responsePayload = receiveResponsePayload(finalResponseHeader); 
-    std::cout << responsePayload << std::endl;
 
 	// if the response header is FileReceived, return the CRC
     if (finalResponseHeader.getCode() == ResponseHeader::Code::FileReceived) {
@@ -148,7 +283,7 @@ unsigned long ClientSession::getServerCRC(std::string& filePath, const std::vect
             return crc;
         }
         catch (const std::invalid_argument& e) {
-            std::cerr << "Error: " << e.what() << std::endl;
+            Log::error("File response has no CRC", { { "file", fileName }, { "reason", e.what() } });
         }
 
     }
@@ -156,6 +291,24 @@ unsigned long ClientSession::getServerCRC(std::string& filePath, const std::vect
     return -1;
 }
 
+/**
+ * @brief Decrypts the AES key sent by the server and keeps it for the rest of the session.
+ *
+ * @param encryptedAESKey The AES key as received from the server, encrypted with the client's public key.
+ */
+void ClientSession::setAESKey(const std::vector<char>& encryptedAESKey) {
+    aesKey = decryptAESKey(encryptedAESKey);
+}
+
+/**
+ * @brief Returns the decrypted AES key of the session.
+ *
+ * @return The AES key, or an empty string if setAESKey was not called yet.
+ */
+const std::string& ClientSession::getAESKey() const {
+    return aesKey;
+}
+
 /**
  * @brief Receives the response payload from the server based on the response header.
  *
@@ -165,7 +318,10 @@ unsigned long ClientSession::getServerCRC(std::string& filePath, const std::vect
 ResponsePayload ClientSession::receiveResponsePayload(const ResponseHeader& responseHeader) {
     // Receive the payload
     std::vector<char> responsePayloadBytes(responseHeader.getPayloadSize());
-    boost::asio::read(socket, boost::asio::buffer(responsePayloadBytes, responsePayloadBytes.size()));
+    transport->read(responsePayloadBytes.data(), responsePayloadBytes.size());
+    if (captureSession != 0) {
+        ProtocolRecorder::instance().record(captureSession, CaptureEvent::ResponsePayload, responsePayloadBytes.data(), responsePayloadBytes.size());
+    }
 
     // Create a ResponsePayload object and return it
     ResponsePayload responsePayload(responseHeader.getCode(), responsePayloadBytes);
@@ -186,7 +342,7 @@ ResponseHeader ClientSession::processClientIDAndSendPublicKey(const ResponsePayl
         std::string clientID = std::get<std::string>(responsePayload.getField("client_id"));
 
         // Save UUID to me.info
-        FileHandler::writeToFile(Constants::ME_FILE, userName + "\n" + clientID);
+        FileHandler::writeToFile(credentialPath(Constants::ME_FILE), userName + "\n" + clientID);
 
         // generate public and private RSA keys. save the private in priv.key and send the public to the server
         std::string publicKey = generateAndSaveRSAKeys();
@@ -194,8 +350,8 @@ ResponseHeader ClientSession::processClientIDAndSendPublicKey(const ResponsePayl
 		// create public key submission request
         Request publicKeyRequest = preparePublicKeySubmissionRequest(clientID, userName, publicKey);
 
-		std::cout << std::string(Constants::___, '-') << "\nSending public key to the server...\n" << std::string(Constants::___, '-') << std::endl;
-        std::cout << publicKeyRequest << std::endl;
+		Log::info("Sending public key", { { "client_id", clientID } });
+        Log::debug("Public key request", { { "bytes", publicKeyRequest.size() }, { "key_bytes", publicKey.size() } });
 
         sendRequest(publicKeyRequest);
 
@@ -203,10 +359,10 @@ ResponseHeader ClientSession::processClientIDAndSendPublicKey(const ResponsePayl
         return publicKeyResponseHeader;
     }
     catch (const std::invalid_argument& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+        Log::error("Registration response has no client ID", { { "reason", e.what() } });
     }
     catch (const std::bad_variant_access& e) {
-        std::cerr << "Error: Unable to access the client_id as a string. " << e.what() << std::endl;
+        Log::error("Unable to access the client_id as a string", { { "reason", e.what() } });
     }
 }
 
@@ -222,7 +378,8 @@ ResponseHeader ClientSession::processClientIDAndSendPublicKey(const ResponsePayl
  * @param port The port to connect to.
  */
 void ClientSession::connectToServer(const std::string& address, const std::string& port) {
-    boost::asio::connect(socket, resolver.resolve(address, port));
+    ScopedPhase phase(Phase::Connect);
+    transport = Transport::connect(address, port);
 }
 
 /**
@@ -260,16 +417,24 @@ Request ClientSession::prepareRegistrationRequest(const std::string& userName) {
 }
 
 /**
- * @brief Sends a request to the server via the TCP socket.
+ * @brief Sends a request to the server over the transport.
  *
  * This method sends a serialized request object over the established TCP connection.
  *
  * @param request The request object to send to the server.
  */
 void ClientSession::sendRequest(Request& request) {
-    std::vector<char> requestBytes = request.toBytes();
+    std::vector<char> requestBytes;
+    {
+        TraceSpan span("serialize", "net");
+        requestBytes = request.toBytes();
+    }
     int size = requestBytes.size();
-    boost::asio::write(socket, boost::asio::buffer(requestBytes, size));
+    if (captureSession != 0) {
+        ProtocolRecorder::instance().record(captureSession, CaptureEvent::Request, requestBytes.data(), size);
+    }
+    TraceSpan span("write", "net", "bytes", size);
+    transport->write(requestBytes.data(), size);
 }
 
 /**
@@ -281,8 +446,12 @@ void ClientSession::sendRequest(Request& request) {
  */
 ResponseHeader ClientSession::receiveResponseHeader() {
     std::vector<char> responseHeaderBytes(Constants::HEADER_RESPONSE_SIZE);
-    boost::asio::read(socket, boost::asio::buffer(responseHeaderBytes, responseHeaderBytes.size()));
+    transport->read(responseHeaderBytes.data(), responseHeaderBytes.size());
+    if (captureSession != 0) {
+        ProtocolRecorder::instance().record(captureSession, CaptureEvent::ResponseHeader, responseHeaderBytes.data(), responseHeaderBytes.size());
+    }
     ResponseHeader responseHeader(responseHeaderBytes);
+    lastCode = responseHeader.getCode();
     return responseHeader;
 }
 
@@ -294,6 +463,8 @@ ResponseHeader ClientSession::receiveResponseHeader() {
  * @return The generated public key as a string.
  */
 std::string ClientSession::generateAndSaveRSAKeys() {
+    ScopedPhase phase(Phase::RsaKeygen);
+
     // Generate RSA keys (private and public)
     RSAPrivateWrapper rsaPrivate;
 
@@ -304,9 +475,9 @@ std::string ClientSession::generateAndSaveRSAKeys() {
     std::string encodedPrivateKey = Base64Wrapper::encode(privateKeyStr);
 
     // Save the encoded private key to a file
-    FileHandler::writeToBinaryFile(Constants::PRIV_FILE, encodedPrivateKey);
+    FileHandler::writeToBinaryFile(credentialPath(Constants::PRIV_FILE), encodedPrivateKey);
 
-    FileHandler::appendToFile(Constants::ME_FILE, "\n" + encodedPrivateKey);
+    FileHandler::appendToFile(credentialPath(Constants::ME_FILE), "\n" + encodedPrivateKey);
 
     // Get the public key from the private wrapper
     std::string publicKey = rsaPrivate.getPublicKey();
@@ -345,8 +516,10 @@ Request ClientSession::preparePublicKeySubmissionRequest(const std::string& clie
  * @return The decrypted AES key as a string.
  */
 std::string ClientSession::decryptAESKey(const std::vector<char>& encryptedAESKey) {
+    ScopedPhase phase(Phase::RsaUnwrap, encryptedAESKey.size());
+
     // Read the Base64-encoded private RSA key from priv.key using FileHandler
-    std::string encodedPrivateKey = FileHandler::readFromBinaryFile(Constants::PRIV_FILE);
+    std::string encodedPrivateKey = FileHandler::readFromBinaryFile(credentialPath(Constants::PRIV_FILE));
 
     // Decode the private key from Base64
     std::string privateKeyStr = Base64Wrapper::decode(encodedPrivateKey);
@@ -376,7 +549,10 @@ std::vector<char> ClientSession::receiveEncryptedAESKey(const ResponseHeader& re
 
     // Receive the payload (client ID and encrypted AES key)
     std::vector<char> responsePayloadBytes(responseHeader.getPayloadSize());
-    boost::asio::read(socket, boost::asio::buffer(responsePayloadBytes, responsePayloadBytes.size()));
+    transport->read(responsePayloadBytes.data(), responsePayloadBytes.size());
+    if (captureSession != 0) {
+        ProtocolRecorder::instance().record(captureSession, CaptureEvent::ResponsePayload, responsePayloadBytes.data(), responsePayloadBytes.size());
+    }
 
     // Extract the client ID (first 16 bytes) - for future use if needed
     std::vector<char> clientID(responsePayloadBytes.begin(), responsePayloadBytes.begin() + Constants::CLIENT_ID_SIZE);
@@ -387,33 +563,3 @@ std::vector<char> ClientSession::receiveEncryptedAESKey(const ResponseHeader& re
     // Return the encrypted AES key as a vector of chars
     return encryptedAESKey;
 }
-
-/**
- * @brief Encrypts the file content using the provided AES key.
- *
- * This method reads the file content from disk, encrypts it using the decrypted AES key, and returns the encrypted data as a vector of chars.
- *
- * @param filePath The path of the file to encrypt.
- * @param encryptedAESKey The AES key used for encryption.
- * @return A vector of chars containing the encrypted file content.
- */
-std::vector<char> ClientSession::encryptFileWithAES(const std::string& filePath, const std::vector<char>& encryptedAESKey) {
-    // Decrypt the AES key 
-    std::string decryptedAESKeyStr = decryptAESKey(encryptedAESKey);
-
-    // Read the file content
-    std::ifstream file(filePath, std::ios::in | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open the file at the given path.");
-    }
-    std::vector<char> fileContent((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    file.close();
-
-    // Encrypt the file content using AES
-    AESWrapper aes(reinterpret_cast<const unsigned char*>(decryptedAESKeyStr.data()), decryptedAESKeyStr.size());
-    std::string encryptedContent = aes.encrypt(fileContent.data(), fileContent.size());
-
-    // Convert the encrypted content to a vector of chars and return it
-    std::vector<char> encryptedFile(encryptedContent.begin(), encryptedContent.end());
-    return encryptedFile;
-}
@@ -2,6 +2,7 @@
 #define CLIENTSESSION_H
 
 #include <boost/asio.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 #include <rsa.h>
@@ -16,6 +17,14 @@
 #include "RSAWrapper.h"
 #include "AESWrapper.h"
 #include "CRC_Calculator.h"
+#include "TransferMetrics.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "ProtocolRecorder.h"
+#include "Transport.h"
+#include "FileEncryptor.h"
+#include "FilePacketEncoder.h"
+#include "FramePool.h"
 
 
 /**
@@ -41,8 +50,36 @@ public:
      *
      * @param address The server address to connect to.
      * @param port The port to use for the connection.
+     * @param credentialsDir The directory of the ME and private key files; empty for the working directory.
      */
-    ClientSession(const std::string& address, const std::string& port);
+    ClientSession(const std::string& address, const std::string& port, const std::string& credentialsDir = "");
+
+    /**
+     * @brief Constructor that uses an established connection to the server, such as a FaultyTransport.
+     *
+     * @param transport The connection.
+     * @param credentialsDir The directory of the ME and private key files; empty for the working directory.
+     */
+    ClientSession(std::unique_ptr<Transport> transport, const std::string& credentialsDir = "");
+
+    /**
+     * @brief Destructor that ends the session in the protocol capture, if it is recorded.
+     */
+    ~ClientSession();
+
+    /**
+     * @brief Checks whether credentials of an earlier registration are stored, so that reconnect() can be tried.
+     *
+     * @return true if the ME file exists.
+     */
+    bool hasCredentials() const;
+
+    /**
+     * @brief Returns the code of the latest response header received.
+     *
+     * @return The response code, or 0 if no response was received yet.
+     */
+    int lastResponseCode() const;
 
     /**
      * @brief Attempts to reconnect to the server using stored credentials.
@@ -73,12 +110,41 @@ public:
     /**
     * @brief Retrieves the CRC of the file from the server.
     *
-    * Encrypts the file with the provided AES key, sends it to the server, and retrieves the CRC calculated by the server.
-    * @param filePath The path of the file to send.
-    * @param encryptedAesKey The AES key to use for encryption.
+    * Sends the already encrypted file content to the server in packets and retrieves the CRC calculated by the server.
+    * @param fileName The file name reported to the server.
+    * @param origFileSize The size of the file before encryption.
+    * @param encryptedFile The encrypted file content.
+    * @param clientId The client ID to put in the request headers.
+    * @return The CRC calculated by the server.
+    */
+	unsigned long getServerCRC(const std::string& fileName, int origFileSize, const std::vector<char>& encryptedFile, const std::string& clientId);
+
+    /**
+    * @brief Retrieves the CRC of the file from the server, encrypting the file while it is sent.
+    *
+    * Only one chunk of the file is in memory at a time, so memory does not grow with the file size.
+    * @param fileName The file name reported to the server.
+    * @param file The file, opened but not yet read.
+    * @param clientId The client ID to put in the request headers.
     * @return The CRC calculated by the server.
+    * @throws std::runtime_error if the file cannot be read; the connection is then in the middle of a file.
     */
-	unsigned long getServerCRC(std::string& filePath, const std::vector<char>& encryptedAesKey, const std::string& clientId);
+	unsigned long getServerCRC(const std::string& fileName, FileEncryptor& file, const std::string& clientId);
+
+    /**
+     * @brief Decrypts the AES key sent by the server and keeps it for the rest of the session.
+     *
+     * The RSA unwrap runs once per session instead of once per uploaded file.
+     * @param encryptedAESKey The AES key as received from the server, encrypted with the client's public key.
+     */
+    void setAESKey(const std::vector<char>& encryptedAESKey);
+
+    /**
+     * @brief Returns the decrypted AES key of the session.
+     *
+     * @return The AES key, or an empty string if setAESKey was not called yet.
+     */
+    const std::string& getAESKey() const;
 
     /**
      * @brief Receives the response payload from the server.
@@ -102,9 +168,20 @@ public:
 
 
 private:
-    boost::asio::io_context io_context; ///< ASIO context for managing asynchronous network operations.
-    boost::asio::ip::tcp::socket socket; ///< TCP socket for communicating with the server.
-    boost::asio::ip::tcp::resolver resolver; ///< Resolver for determining the server's address.
+    std::unique_ptr<Transport> transport; ///< The connection to the server.
+    std::string aesKey; ///< The decrypted AES key shared by every file uploaded in this session.
+    std::string credentialsDir; ///< The directory of the ME and private key files, or empty for the working directory.
+    int lastCode = 0; ///< The code of the latest response header received.
+    uint32_t captureSession = 0; ///< The session number in the protocol capture, or 0 if it is not recorded.
+    std::unique_ptr<FramePool> frames; ///< The frames file packets are encoded into, created with the first file.
+
+    /**
+     * @brief Returns the path of a credentials file in the credentials directory.
+     *
+     * @param fileName The file name, Constants::ME_FILE or Constants::PRIV_FILE.
+     * @return The path of the file.
+     */
+    std::string credentialPath(const std::string& fileName) const;
 
     /**
      * @brief Connects to the server at the specified address and port.
@@ -138,6 +215,32 @@ private:
      */
     void sendRequest(Request& request);
 
+    /**
+     * @brief Sends part of a file to the server as packets, encoded into the session's frames.
+     *
+     * @param encoder The packets of the file; numbers the packets across calls.
+     * @param content The encrypted bytes, a whole number of packets unless they end the file.
+     * @param length The number of bytes.
+     */
+    void sendFileContent(FilePacketEncoder& encoder, const char* content, size_t length);
+
+    /**
+     * @brief Writes encoded frames to the server, adjacent full frames in one write, and returns them to the pool.
+     *
+     * @param batch The frames, in the order of their packets.
+     * @param lengths The number of bytes of each frame.
+     * @param count The number of frames.
+     */
+    void writeFrames(char* const* batch, const size_t* lengths, size_t count);
+
+    /**
+     * @brief Receives the response to a sent file.
+     *
+     * @param fileName The file name, for the log.
+     * @return The CRC calculated by the server, or -1 if the server did not confirm the file.
+     */
+    unsigned long receiveServerCRC(const std::string& fileName);
+
     /**
      * @brief Receives the response header from the server.
      *
@@ -178,16 +281,6 @@ private:
      * @return The encrypted AES key as a vector of chars.
      */
     std::vector<char> receiveEncryptedAESKey(const ResponseHeader& responseHeader);
-
-    /**
-     * @brief Encrypts the file content using AES encryption.
-     *
-     * This method encrypts the file content using the decrypted AES key.
-     * @param filePath The path of the file to encrypt.
-     * @param encryptedAESKey The AES key used for encryption.
-     * @return A vector of chars containing the encrypted file content.
-     */
-    std::vector<char> encryptFileWithAES(const std::string& filePath, const std::vector<char>& encryptedAESKey);
 };
 
 #endif // CLIENTSESSION_H
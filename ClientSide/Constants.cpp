@@ -11,4 +11,7 @@ namespace Constants {
     std::string TRANSFER_FILE = "transfer.info"; 
     std::string ME_FILE = "me.info"; 
     std::string PRIV_FILE = "priv.key"; 
+    std::string SYNC_MANIFEST_FILE = "sync.manifest";
+    std::string DAEMON_SOCKET_FILE = "client.sock";
+    std::string LOAD_CACHE_DIR = "loadgen"; // credentials of the simulated users, one directory each
 }
\ No newline at end of file
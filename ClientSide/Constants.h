@@ -33,6 +33,9 @@ namespace Constants {
     extern std::string TRANSFER_FILE; 
 	extern std::string ME_FILE; 
 	extern std::string PRIV_FILE; 
+	extern std::string SYNC_MANIFEST_FILE;
+	extern std::string DAEMON_SOCKET_FILE;
+	extern std::string LOAD_CACHE_DIR;
 
 	// lines from the files
 	constexpr int INFO_ADDRESS_AND_PORT_LINE = 1;
@@ -43,6 +46,60 @@ namespace Constants {
 
 	constexpr int PACKET_SIZE = 1024;
 
+	// batch upload
+	constexpr char MANIFEST_PREFIX = '@'; // a file line starting with it names a manifest of more paths or globs
+	constexpr size_t DEFAULT_UPLOAD_WORKERS = 4;
+	constexpr size_t DEFAULT_UPLOAD_CONNECTIONS = 2;
+	constexpr long long MAX_UPLOAD_WORKERS = 256; // the most --workers accepts, each a thread
+	constexpr long long MAX_UPLOAD_CONNECTIONS = 64; // the most --connections accepts, each a thread and a socket
+	constexpr size_t UPLOAD_QUEUE_CAPACITY = 8; // encrypted files waiting for a connection
+	constexpr int MAX_CRC_RETRIES = 3;
+
+	// directory sync
+	constexpr const char* SYNC_JOURNAL_SUFFIX = ".journal"; // uploads recorded since the manifest was last compacted
+	constexpr const char* SYNC_TEMP_SUFFIX = ".tmp"; // the new manifest before it is renamed into place
+
+	// watch mode
+	constexpr int WATCH_DEBOUNCE_MS = 500; // a batch is sent once the watched trees were quiet this long
+	constexpr int WATCH_MAX_BATCH_DELAY_MS = 5000; // or once its oldest change waited this long
+	constexpr int WATCH_RETRY_DELAY_MS = 5000; // wait before reconnecting after a failed batch
+	constexpr size_t WATCH_EVENT_BUFFER_SIZE = 64 * 1024;
+
+	// upload daemon
+	constexpr size_t DAEMON_MAX_BATCH_FILES = 64; // queued jobs taken per batch, highest priority first
+	constexpr int DAEMON_DEFAULT_PRIORITY = 0;
+
+	// tracing
+	constexpr size_t TRACE_INITIAL_EVENTS_PER_THREAD = 4096;
+	constexpr size_t TRACE_MAX_EVENTS_PER_THREAD = 1 << 20; // later spans of the thread are dropped
+
+	// logging
+	constexpr size_t LOG_RING_CAPACITY = 2048; // queued records, a power of two; records are dropped when full
+	constexpr size_t LOG_MAX_FIELDS = 8; // later fields of a record are dropped
+	constexpr size_t LOG_TEXT_CAPACITY = 384; // bytes of text field values per record; longer values are cut
+	constexpr int LOG_DRAIN_INTERVAL_MS = 20; // the writer thread wakes at least this often
+
+	// benchmarks
+	constexpr int BENCH_MIN_TIME_MS = 250; // every case repeats until it ran at least this long
+	constexpr size_t BENCH_MIN_BYTES = 64; // buffer sizes go from this...
+	constexpr size_t BENCH_SIZE_STEP = 16; // ...in steps of this factor...
+	constexpr size_t BENCH_DEFAULT_MAX_BYTES = 64 * 1024 * 1024; // ...up to this, unless given (at most 1 GiB fits the protocol)
+	constexpr int BENCH_MIN_ITERATIONS = 3; // uploads per loopback case, however long they take
+	constexpr size_t BENCH_MEMORY_BUFFER = 1024 * 1024; // the streaming buffer of the --bench-check memory check...
+	constexpr size_t BENCH_MEMORY_OVERHEAD = 8 * 1024 * 1024; // ...whose upload may grow the peak resident set by this more
+
+	// protocol capture
+	constexpr const char* CAPTURE_MAGIC = "CLNTCAP1"; // the first bytes of a capture file
+	constexpr size_t CAPTURE_RECORD_HEADER_SIZE = 17; // session, event, time and length of a record
+
+	// load generator
+	constexpr size_t LOAD_DEFAULT_CLIENTS = 100;
+	constexpr long long MAX_LOAD_CLIENTS = 10000; // the most --load accepts, each a thread
+	constexpr int LOAD_DEFAULT_DURATION_S = 30;
+	constexpr int LOAD_DEFAULT_THINK_MS = 1000; // mean pause after every upload
+	constexpr int LOAD_DEFAULT_UPLOADS_PER_SESSION = 10; // then the client disconnects and reconnects
+	constexpr const char* LOAD_DEFAULT_SIZES = "4K:60,64K:30,1M:10"; // file sizes and their weights
+
 	// request and response payload sizes
 	constexpr int USERNAME_SIZE = 255;
 	constexpr int PUBLIC_KEY_SIZE = 160;
@@ -54,5 +111,16 @@ namespace Constants {
 	constexpr int Client_ID_SIZE = 16;
 	constexpr int CKSUM_SIZE = 4;
 
+	// file content carried by one send file packet
+	constexpr int PACKET_CONTENT_SIZE = PACKET_SIZE - REQUEST_HEADER_SIZE - CONTENT_SIZE_SIZE - ORIG_FILE_SIZE_SIZE - PACKET_NUMBER_SIZE
+		- TOTAL_PACKET_SIZE - FILE_NAME_SIZE;
+	constexpr int MAX_PACKETS = 0xFFFF; // the packet number is two bytes
+	constexpr size_t STREAM_CHUNK_ALIGNMENT = 8 * PACKET_CONTENT_SIZE; // whole packets and whole AES blocks
+	constexpr int FILE_PACKET_PREFIX_SIZE = PACKET_SIZE - PACKET_CONTENT_SIZE; // the header and fields before the content
+
+	// send frames
+	constexpr size_t FRAME_POOL_FRAMES = 16; // file packets a session encodes before writing them together
+	constexpr size_t FRAME_ALIGNMENT = 4096; // the frame slab starts on a page, so every frame starts on a cache line
+
 }
 #endif // CONSTANTS_H
@@ -0,0 +1,236 @@
+#include "DirectoryWatcher.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include "Constants.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef __linux__
+
+// The events every watched directory reports
+constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+/**
+ * @brief Starts watching the given directory trees.
+ *
+ * @param roots The directories to watch, recursively.
+ * @throws std::runtime_error if inotify is not available or a root cannot be watched.
+ */
+DirectoryWatcher::DirectoryWatcher(const std::vector<std::string>& roots)
+    : roots(roots), inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+    if (inotifyFd < 0) {
+        throw std::runtime_error("Could not create an inotify instance.");
+    }
+    for (const auto& root : roots) {
+        if (!fs::is_directory(root)) {
+            close(inotifyFd);
+            throw std::runtime_error("Not a directory: " + root);
+        }
+        watchTree(root, false);
+    }
+}
+
+/**
+ * @brief Stops watching and releases the inotify instance.
+ */
+DirectoryWatcher::~DirectoryWatcher() {
+    close(inotifyFd);
+}
+
+/**
+ * @brief Waits for the next batch of changed files.
+ *
+ * Sleeps in poll() until an event arrives, the debounce or batch delay expires, or maxWait passes.
+ * @param stop Returns early, with whatever is pending, once this flag is set.
+ * @param maxWait Returns early, with whatever is pending, after waiting this long.
+ * @return The paths of the changed files, possibly empty.
+ */
+std::vector<std::string> DirectoryWatcher::waitForBatch(const std::atomic<bool>& stop, std::chrono::milliseconds maxWait) {
+    using namespace std::chrono;
+    const auto debounce = milliseconds(Constants::WATCH_DEBOUNCE_MS);
+    const auto maxDelay = milliseconds(Constants::WATCH_MAX_BATCH_DELAY_MS);
+    const auto deadline = steady_clock::now() + maxWait;
+
+    while (!stop) {
+        auto now = steady_clock::now();
+        auto wakeUp = deadline;
+        if (!pending.empty()) {
+            wakeUp = std::min({ wakeUp, lastChange + debounce, firstChange + maxDelay });
+        }
+        if (now >= wakeUp) {
+            break;
+        }
+
+        // Wake up at least once a second so a stop request is noticed even without a signal
+        auto timeout = std::min(duration_cast<milliseconds>(wakeUp - now), milliseconds(1000));
+        pollfd fd = { inotifyFd, POLLIN, 0 };
+        int ready = poll(&fd, 1, static_cast<int>(timeout.count()) + 1);
+        if (ready < 0 && errno != EINTR) {
+            throw std::runtime_error("Waiting for inotify events failed.");
+        }
+        if (ready > 0) {
+            readEvents();
+        }
+    }
+
+    std::vector<std::string> batch(pending.begin(), pending.end());
+    pending.clear();
+    return batch;
+}
+
+/**
+ * @brief Watches a directory and every directory below it.
+ *
+ * @param dir The directory to watch.
+ * @param addExisting Whether to report the files already in it, for directories that appeared while watching.
+ */
+void DirectoryWatcher::watchTree(const std::string& dir, bool addExisting) {
+    std::error_code ec;
+
+    int wd = inotify_add_watch(inotifyFd, dir.c_str(), WATCH_MASK);
+    if (wd >= 0) {
+        watchedDirs[wd] = dir;
+    }
+
+    for (fs::recursive_directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec)) {
+            int subWd = inotify_add_watch(inotifyFd, it->path().c_str(), WATCH_MASK);
+            if (subWd >= 0) {
+                watchedDirs[subWd] = it->path().generic_string();
+            }
+        }
+        else if (addExisting && it->is_regular_file(ec)) {
+            // Files written before the new directory was watched produced no event of their own
+            addPending(it->path().generic_string());
+        }
+    }
+}
+
+/**
+ * @brief Reads the available inotify events and adds the changed files to the pending set.
+ */
+void DirectoryWatcher::readEvents() {
+    alignas(inotify_event) char buffer[Constants::WATCH_EVENT_BUFFER_SIZE];
+
+    for (;;) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return; // EAGAIN: drained
+        }
+
+        for (char* ptr = buffer; ptr < buffer + length; ) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost; fall back to reporting everything, the caller skips unchanged files
+                for (const auto& root : roots) {
+                    watchTree(root, true);
+                }
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watchedDirs.erase(event->wd);
+                continue;
+            }
+            if (event->mask & IN_MOVE_SELF) {
+                handleMovedDir(event->wd);
+                continue;
+            }
+
+            auto dir = watchedDirs.find(event->wd);
+            if (dir == watchedDirs.end() || event->len == 0) {
+                continue;
+            }
+            std::string path = dir->second + "/" + event->name;
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watchTree(path, true);
+                }
+            }
+            else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                addPending(path);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Drops the watches a moved directory left behind, under the path it was recorded at.
+ *
+ * A move within the watched trees already re-recorded the directory under its new path, as the watch
+ * of the same directory keeps its descriptor. Otherwise the directory and the ones below it are no longer
+ * under that path: their watches are removed, and whatever is at the path now is watched afresh.
+ * @param wd The watch descriptor of the moved directory.
+ */
+void DirectoryWatcher::handleMovedDir(int wd) {
+    auto moved = watchedDirs.find(wd);
+    if (moved == watchedDirs.end()) {
+        return;
+    }
+    const std::string dir = moved->second;
+
+    int current = inotify_add_watch(inotifyFd, dir.c_str(), WATCH_MASK);
+    if (current == wd) {
+        return; // moved within the trees and recorded under its new path
+    }
+
+    const std::string prefix = dir + "/";
+    for (auto it = watchedDirs.begin(); it != watchedDirs.end(); ) {
+        if (it->first != current && (it->second == dir || it->second.compare(0, prefix.size(), prefix) == 0)) {
+            inotify_rm_watch(inotifyFd, it->first);
+            it = watchedDirs.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    if (current >= 0) {
+        watchTree(dir, true); // another directory took the path
+    }
+}
+
+#else
+
+DirectoryWatcher::DirectoryWatcher(const std::vector<std::string>& roots) : roots(roots), inotifyFd(-1) {
+    throw std::runtime_error("Watch mode requires inotify, which is only available on Linux.");
+}
+
+DirectoryWatcher::~DirectoryWatcher() {}
+
+std::vector<std::string> DirectoryWatcher::waitForBatch(const std::atomic<bool>&, std::chrono::milliseconds) {
+    return {};
+}
+
+void DirectoryWatcher::watchTree(const std::string&, bool) {}
+
+void DirectoryWatcher::readEvents() {}
+
+void DirectoryWatcher::handleMovedDir(int) {}
+
+#endif
+
+/**
+ * @brief Adds a changed file to the pending set.
+ *
+ * @param path The path of the file.
+ */
+void DirectoryWatcher::addPending(const std::string& path) {
+    auto now = std::chrono::steady_clock::now();
+    if (pending.empty()) {
+        firstChange = now;
+    }
+    lastChange = now;
+    pending.insert(path);
+}
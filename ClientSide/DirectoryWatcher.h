@@ -0,0 +1,87 @@
+#ifndef DIRECTORY_WATCHER_H
+#define DIRECTORY_WATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class DirectoryWatcher
+ * @brief Watches directory trees with inotify and reports the files that were written, in debounced batches.
+ *
+ * A file is reported once it is closed after writing or moved into a watched tree. Sub directories are
+ * watched as they appear. Bursts of events are coalesced: a batch is handed out once the trees were quiet
+ * for Constants::WATCH_DEBOUNCE_MS, or once its oldest change waited Constants::WATCH_MAX_BATCH_DELAY_MS.
+ * If the kernel event queue overflows, every file under the roots is reported so nothing is missed.
+ * A watched directory that is moved away stops being watched, together with the directories below it.
+ *
+ * inotify is Linux only; on other platforms the constructor throws.
+ */
+class DirectoryWatcher {
+public:
+    /**
+     * @brief Starts watching the given directory trees.
+     *
+     * @param roots The directories to watch, recursively.
+     * @throws std::runtime_error if inotify is not available or a root cannot be watched.
+     */
+    explicit DirectoryWatcher(const std::vector<std::string>& roots);
+
+    /**
+     * @brief Stops watching and releases the inotify instance.
+     */
+    ~DirectoryWatcher();
+
+    /**
+     * @brief Waits for the next batch of changed files.
+     *
+     * @param stop Returns early, with whatever is pending, once this flag is set.
+     * @param maxWait Returns early, with whatever is pending, after waiting this long.
+     * @return The paths of the changed files, possibly empty.
+     */
+    std::vector<std::string> waitForBatch(const std::atomic<bool>& stop, std::chrono::milliseconds maxWait);
+
+private:
+    std::vector<std::string> roots;                         ///< The watched directory trees.
+    int inotifyFd;                                          ///< The inotify instance.
+    std::unordered_map<int, std::string> watchedDirs;       ///< Watched directories by watch descriptor.
+    std::set<std::string> pending;                          ///< Changed files not handed out yet.
+    std::chrono::steady_clock::time_point firstChange;      ///< When the oldest pending change arrived.
+    std::chrono::steady_clock::time_point lastChange;       ///< When the newest pending change arrived.
+
+    // Non-copyable: owns the inotify descriptor
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    /**
+     * @brief Watches a directory and every directory below it.
+     *
+     * @param dir The directory to watch.
+     * @param addExisting Whether to report the files already in it, for directories that appeared while watching.
+     */
+    void watchTree(const std::string& dir, bool addExisting);
+
+    /**
+     * @brief Reads the available inotify events and adds the changed files to the pending set.
+     */
+    void readEvents();
+
+    /**
+     * @brief Drops the watches a moved directory left behind, under the path it was recorded at.
+     *
+     * @param wd The watch descriptor of the moved directory.
+     */
+    void handleMovedDir(int wd);
+
+    /**
+     * @brief Adds a changed file to the pending set.
+     *
+     * @param path The path of the file.
+     */
+    void addPending(const std::string& path);
+};
+
+#endif // DIRECTORY_WATCHER_H
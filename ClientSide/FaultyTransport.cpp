@@ -0,0 +1,124 @@
+#include "FaultyTransport.h"
+
+#include <algorithm>
+#include <thread>
+
+FaultOptions FaultyTransport::options;
+std::atomic<bool> FaultyTransport::active(false);
+std::atomic<unsigned int> FaultyTransport::connections(0);
+FaultyTransport::Link FaultyTransport::upstream;
+FaultyTransport::Link FaultyTransport::downstream;
+
+/**
+ * @brief Sets the faults of every connection made from now on.
+ *
+ * Call before any connection is made; connections already wrapped read the options unsynchronized.
+ * @param options The faults; wrapping is turned off if none is set.
+ */
+void FaultyTransport::configure(const FaultOptions& options) {
+    FaultyTransport::options = options;
+    active.store(options.any(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Wraps a connection, charging the round trip of its handshake.
+ *
+ * @param inner The connection.
+ */
+FaultyTransport::FaultyTransport(std::unique_ptr<Transport> inner)
+    : inner(std::move(inner)), random(options.seed + connections++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * options.delayMs));
+}
+
+/**
+ * @brief Reads at least one byte and at most the given number, after the faults.
+ *
+ * The first read after a write waits a round trip first.
+ * @param data Receives the bytes.
+ * @param size The most bytes to read.
+ * @return The number of bytes read.
+ * @throws boost::system::system_error on a network error or an injected reset.
+ */
+size_t FaultyTransport::readSome(char* data, size_t size) {
+    beforeOperation();
+    if (writing) {
+        writing = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * options.delayMs));
+    }
+    size_t read = inner->readSome(data, chunk(size));
+    pace(downstream, read);
+    return read;
+}
+
+/**
+ * @brief Writes at least one byte and at most the given number, after the faults.
+ *
+ * @param data The bytes.
+ * @param size The most bytes to write.
+ * @return The number of bytes written.
+ * @throws boost::system::system_error on a network error or an injected reset.
+ */
+size_t FaultyTransport::writeSome(const char* data, size_t size) {
+    beforeOperation();
+    writing = true;
+    size_t written = inner->writeSome(data, chunk(size));
+    pace(upstream, written);
+    return written;
+}
+
+/**
+ * @brief Closes the connection; later reads and writes fail.
+ */
+void FaultyTransport::close() {
+    inner->close();
+}
+
+/**
+ * @brief Stalls or resets the connection, if chance decides so, before a read or write.
+ *
+ * @throws boost::system::system_error if the connection is reset.
+ */
+void FaultyTransport::beforeOperation() {
+    std::uniform_real_distribution<double> chance(0, 1);
+    if (options.stallProbability > 0 && chance(random) < options.stallProbability) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.stallMs));
+    }
+    if (options.resetProbability > 0 && chance(random) < options.resetProbability) {
+        inner->close();
+        throw boost::system::system_error(boost::asio::error::connection_reset, "injected");
+    }
+}
+
+/**
+ * @brief Returns how many bytes a read or write moves.
+ *
+ * @param size The bytes asked for.
+ * @return At most size, at most FaultOptions::maxChunk.
+ */
+size_t FaultyTransport::chunk(size_t size) {
+    if (options.maxChunk == 0 || size <= 1) {
+        return size;
+    }
+    return std::uniform_int_distribution<size_t>(1, std::min(size, options.maxChunk))(random);
+}
+
+/**
+ * @brief Waits until the link has carried some bytes at the configured bandwidth.
+ *
+ * The bytes queue behind the bytes of every other connection in the same direction.
+ * @param link The direction.
+ * @param bytes The bytes.
+ */
+void FaultyTransport::pace(Link& link, size_t bytes) {
+    if (options.bandwidth == 0) {
+        return;
+    }
+    auto duration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(static_cast<double>(bytes) / options.bandwidth));
+    Clock::time_point done;
+    {
+        std::lock_guard<std::mutex> lock(link.mutex);
+        link.free = std::max(link.free, Clock::now()) + duration;
+        done = link.free;
+    }
+    std::this_thread::sleep_until(done);
+}
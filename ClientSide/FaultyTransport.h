@@ -0,0 +1,121 @@
+#ifndef FAULTY_TRANSPORT_H
+#define FAULTY_TRANSPORT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+
+#include "Transport.h"
+
+/**
+ * @struct FaultOptions
+ * @brief The network conditions a FaultyTransport simulates.
+ */
+struct FaultOptions {
+    int delayMs = 0;                ///< One-way delay; every turn from sending to receiving waits a round trip of twice this.
+    uint64_t bandwidth = 0;         ///< Bytes per second in each direction, shared by all connections; 0 for no cap.
+    size_t maxChunk = 0;            ///< Reads and writes move between 1 and this many bytes; 0 to move as many as possible.
+    double stallProbability = 0;    ///< The chance that a read or write first stalls.
+    int stallMs = 0;                ///< How long a stall lasts.
+    double resetProbability = 0;    ///< The chance that a read or write finds the connection reset.
+    unsigned int seed = 0;          ///< Seeds the random choices; connection N uses seed + N.
+
+    /**
+     * @brief Returns whether any fault is configured.
+     *
+     * @return true if a transport would behave differently from a plain one.
+     */
+    bool any() const {
+        return delayMs > 0 || bandwidth > 0 || maxChunk > 0 || (stallProbability > 0 && stallMs > 0) || resetProbability > 0;
+    }
+};
+
+/**
+ * @class FaultyTransport
+ * @brief Wraps a transport and injects delay, bandwidth caps, short reads and writes, stalls and resets.
+ *
+ * Meant for measuring how the client's retries and timeouts behave in the tail on slow or unreliable
+ * links, without network gear. The faults are configured once per process; every connection made by
+ * Transport::connect() afterwards is wrapped. The delay is charged when a connection turns from writing
+ * to reading, so that streamed packets pay only the bandwidth, like on a real link, while every request
+ * and response exchange pays a round trip. A reset closes the connection and throws, as a peer reset would.
+ */
+class FaultyTransport : public Transport {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Sets the faults of every connection made from now on.
+     *
+     * @param options The faults; wrapping is turned off if none is set.
+     */
+    static void configure(const FaultOptions& options);
+
+    /**
+     * @brief Returns whether new connections are wrapped.
+     *
+     * @return true if faults were configured.
+     */
+    static bool enabled() {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Wraps a connection, charging the round trip of its handshake.
+     *
+     * @param inner The connection.
+     */
+    explicit FaultyTransport(std::unique_ptr<Transport> inner);
+
+    size_t readSome(char* data, size_t size) override;
+    size_t writeSome(const char* data, size_t size) override;
+    void close() override;
+
+private:
+    /**
+     * @struct Link
+     * @brief One direction of the simulated link, shared by all connections.
+     */
+    struct Link {
+        std::mutex mutex;               ///< Guards free.
+        Clock::time_point free;         ///< When the link has sent everything reserved so far.
+    };
+
+    static FaultOptions options;                ///< The configured faults.
+    static std::atomic<bool> active;            ///< Whether new connections are wrapped.
+    static std::atomic<unsigned int> connections; ///< Connections wrapped so far, for their seeds.
+    static Link upstream;                       ///< From the client to the server.
+    static Link downstream;                     ///< From the server to the client.
+
+    std::unique_ptr<Transport> inner;           ///< The wrapped connection.
+    std::mt19937 random;                        ///< The random choices of this connection.
+    bool writing = true;                        ///< Whether the last operation was a write.
+
+    /**
+     * @brief Stalls or resets the connection, if chance decides so, before a read or write.
+     *
+     * @throws boost::system::system_error if the connection is reset.
+     */
+    void beforeOperation();
+
+    /**
+     * @brief Returns how many bytes a read or write moves.
+     *
+     * @param size The bytes asked for.
+     * @return At most size, at most FaultOptions::maxChunk.
+     */
+    size_t chunk(size_t size);
+
+    /**
+     * @brief Waits until the link has carried some bytes at the configured bandwidth.
+     *
+     * @param link The direction.
+     * @param bytes The bytes.
+     */
+    static void pace(Link& link, size_t bytes);
+};
+
+#endif // FAULTY_TRANSPORT_H
@@ -0,0 +1,74 @@
+#include "FileEncryptor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include "CRC_Calculator.h"
+
+/**
+ * @brief Returns the size of the largest buffer that fits in a memory budget and holds whole chunks.
+ *
+ * @param budget The most bytes the buffer may take.
+ * @return The buffer size; at least one alignment unit plus an AES block, even over the budget.
+ */
+size_t FileEncryptor::bufferSize(size_t budget) {
+    size_t chunk = budget > AES_BLOCK ? (budget - AES_BLOCK) / Constants::STREAM_CHUNK_ALIGNMENT * Constants::STREAM_CHUNK_ALIGNMENT : 0;
+    return std::max(chunk, Constants::STREAM_CHUNK_ALIGNMENT) + AES_BLOCK;
+}
+
+/**
+ * @brief Opens a file for encryption.
+ *
+ * @param filePath The path of the file.
+ * @param aesKey The AES key of the session.
+ * @param buffer The buffer the chunks are encrypted into; must hold at least one alignment unit plus an AES block.
+ * @throws std::runtime_error if the file cannot be opened, is too large for the protocol, or the buffer is too small.
+ */
+FileEncryptor::FileEncryptor(const std::string& filePath, const std::string& aesKey, std::vector<char>& buffer)
+    : file(filePath, std::ios::in | std::ios::binary | std::ios::ate), filePath(filePath),
+    aes(reinterpret_cast<const unsigned char*>(aesKey.data()), static_cast<unsigned int>(aesKey.size())), buffer(buffer) {
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open the file at the given path.");
+    }
+    if (buffer.size() < Constants::STREAM_CHUNK_ALIGNMENT + AES_BLOCK) {
+        throw std::runtime_error("The upload buffer is too small.");
+    }
+    chunkSize = (buffer.size() - AES_BLOCK) / Constants::STREAM_CHUNK_ALIGNMENT * Constants::STREAM_CHUNK_ALIGNMENT;
+    fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    uint64_t packets = (encryptedSize() + Constants::PACKET_CONTENT_SIZE - 1) / Constants::PACKET_CONTENT_SIZE;
+    if (packets > Constants::MAX_PACKETS || fileSize > INT32_MAX) {
+        throw std::runtime_error("The file is too large for the protocol.");
+    }
+}
+
+/**
+ * @brief Reads and encrypts the next chunk into the buffer.
+ *
+ * The chunk is checksummed before it is encrypted in place; the last chunk also carries the padding.
+ * @return The number of encrypted bytes at the start of the buffer; 0 once the whole file was returned.
+ * @throws std::runtime_error if the file cannot be read to the size it had when it was opened.
+ */
+size_t FileEncryptor::next() {
+    if (finished) {
+        return 0;
+    }
+    size_t length = static_cast<size_t>(std::min<uint64_t>(chunkSize, fileSize - offset));
+    if (!file.read(buffer.data(), length)) {
+        throw std::runtime_error("The file " + filePath + " got shorter while it was uploaded.");
+    }
+    crcState = CRC_Calculator::update(crcState, buffer.data(), length);
+    offset += length;
+    finished = offset == fileSize;
+    return aes.encryptPart(buffer.data(), length, buffer.data(), chain, finished);
+}
+
+/**
+ * @brief Returns the CRC of the plaintext; only final after next() returned 0.
+ *
+ * @return The checksum.
+ */
+unsigned long FileEncryptor::crc() const {
+    return CRC_Calculator::finish(crcState, offset);
+}
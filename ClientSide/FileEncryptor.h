@@ -0,0 +1,93 @@
+#ifndef FILE_ENCRYPTOR_H
+#define FILE_ENCRYPTOR_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "AESWrapper.h"
+#include "Constants.h"
+
+/**
+ * @class FileEncryptor
+ * @brief Reads, checksums and encrypts a file one chunk at a time, into a buffer the caller owns.
+ *
+ * Used by streaming uploads, whose memory is bounded by the buffer instead of the file size. Every chunk but
+ * the last fills the buffer up to a multiple of Constants::STREAM_CHUNK_ALIGNMENT, so it ends on both a packet
+ * and an AES block boundary and can be sent before the next chunk is read. The chunks together are the same
+ * bytes AESWrapper::encrypt() makes of the whole file, and the checksum the same that CRC_Calculator::memcrc()
+ * gives for it.
+ */
+class FileEncryptor {
+public:
+    /**
+     * @brief Returns the size of the largest buffer that fits in a memory budget and holds whole chunks.
+     *
+     * @param budget The most bytes the buffer may take.
+     * @return The buffer size; at least one alignment unit plus an AES block, even over the budget.
+     */
+    static size_t bufferSize(size_t budget);
+
+    /**
+     * @brief Opens a file for encryption.
+     *
+     * @param filePath The path of the file.
+     * @param aesKey The AES key of the session.
+     * @param buffer The buffer the chunks are encrypted into; must hold at least one alignment unit plus an AES block.
+     * @throws std::runtime_error if the file cannot be opened, is too large for the protocol, or the buffer is too small.
+     */
+    FileEncryptor(const std::string& filePath, const std::string& aesKey, std::vector<char>& buffer);
+
+    /**
+     * @brief Returns the size of the file before encryption.
+     *
+     * @return The size in bytes.
+     */
+    uint64_t size() const { return fileSize; }
+
+    /**
+     * @brief Returns the size of the file after encryption, including the padding.
+     *
+     * @return The size in bytes.
+     */
+    uint64_t encryptedSize() const { return fileSize - fileSize % AES_BLOCK + AES_BLOCK; }
+
+    /**
+     * @brief Reads and encrypts the next chunk into the buffer.
+     *
+     * @return The number of encrypted bytes at the start of the buffer; 0 once the whole file was returned.
+     * @throws std::runtime_error if the file cannot be read to the size it had when it was opened.
+     */
+    size_t next();
+
+    /**
+     * @brief Returns the encrypted bytes of the last chunk.
+     *
+     * @return The start of the buffer.
+     */
+    const char* data() const { return buffer.data(); }
+
+    /**
+     * @brief Returns the CRC of the plaintext; only final after next() returned 0.
+     *
+     * @return The checksum.
+     */
+    unsigned long crc() const;
+
+private:
+    static constexpr size_t AES_BLOCK = 16;  ///< The AES block size, the most padding adds.
+
+    std::ifstream file;             ///< The file being read.
+    std::string filePath;           ///< The path of the file, for errors.
+    AESWrapper aes;                 ///< The session key.
+    std::vector<char>& buffer;      ///< The buffer the chunks are read and encrypted into, in place.
+    size_t chunkSize;               ///< The plaintext bytes of every chunk but the last.
+    uint64_t fileSize;              ///< The size of the file when it was opened.
+    uint64_t offset = 0;            ///< The plaintext bytes read so far.
+    bool finished = false;          ///< Whether the padded last chunk was returned.
+    unsigned char chain[AES_BLOCK] = { 0 };  ///< The CBC chain, the last cipher block so far.
+    unsigned long crcState = 0;     ///< The running checksum of the plaintext.
+};
+
+#endif // FILE_ENCRYPTOR_H
@@ -1,6 +1,8 @@
 #include "FileHandler.h"
 #include <fstream>
 #include <stdexcept>
+#include <filesystem>
+#include <algorithm>
 
 
 /**
@@ -43,6 +45,169 @@ std::string FileHandler::getSpecificLine(const std::string& filePath, size_t lin
     throw std::out_of_range("Line number " + std::to_string(lineNumber) + " out of range in file: " + filePath);
 }
 
+/**
+ * @brief Retrieves every non-empty line of a file starting at a given line.
+ * Trailing carriage returns are stripped and lines starting with '#' are skipped.
+ * @param filePath The path to the file.
+ * @param firstLine The first line number to retrieve (starting from 1).
+ * @return The lines from firstLine to the end of the file.
+ * @throws std::runtime_error if the file could not be opened.
+ */
+std::vector<std::string> FileHandler::getLinesFrom(const std::string& filePath, size_t firstLine) {
+    std::ifstream file(filePath);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + filePath);
+    }
+
+    std::vector<std::string> lines;
+    std::string line;
+    size_t currentLine = 1;
+
+    while (std::getline(file, line)) {
+        if (currentLine++ < firstLine) {
+            continue;
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+/**
+ * @brief Matches a single path component against a wildcard pattern.
+ * @param pattern The pattern, where '*' matches any run of characters and '?' matches one character.
+ * @param name The path component to test.
+ * @return true if the name matches the pattern, false otherwise.
+ */
+static bool wildcardMatch(const std::string& pattern, const std::string& name) {
+    size_t p = 0, n = 0, starP = std::string::npos, starN = 0;
+
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            p++;
+            n++;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            starP = p++;
+            starN = n;
+        }
+        else if (starP != std::string::npos) {
+            // backtrack: let the last '*' swallow one more character
+            p = starP + 1;
+            n = ++starN;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
+
+/**
+ * @brief Expands a path pattern into the regular files it matches.
+ * '*' matches any run of characters and '?' matches a single character, within one path component.
+ * A pattern without wildcards is returned unchanged, whether or not the file exists.
+ * @param pattern The path pattern to expand.
+ * @return The matching file paths, sorted.
+ */
+std::vector<std::string> FileHandler::expandGlob(const std::string& pattern) {
+    namespace fs = std::filesystem;
+
+    if (pattern.find_first_of("*?") == std::string::npos) {
+        return { pattern };
+    }
+
+    // Walk the pattern one component at a time, keeping every directory matched so far
+    fs::path patternPath(pattern);
+    std::vector<fs::path> candidates = { patternPath.has_root_path() ? patternPath.root_path() : fs::path() };
+    std::error_code ec;
+
+    for (const auto& component : patternPath.relative_path()) {
+        std::string part = component.string();
+        std::vector<fs::path> next;
+
+        for (const auto& base : candidates) {
+            if (part.find_first_of("*?") == std::string::npos) {
+                next.push_back(base / component);
+                continue;
+            }
+            fs::path dir = base.empty() ? fs::path(".") : base;
+            for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+                std::string name = it->path().filename().string();
+                if (wildcardMatch(part, name)) {
+                    next.push_back(base / name);
+                }
+            }
+        }
+        candidates.swap(next);
+    }
+
+    std::vector<std::string> matches;
+    for (const auto& candidate : candidates) {
+        if (fs::is_regular_file(candidate, ec)) {
+            matches.push_back(candidate.generic_string());
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+/**
+ * @brief Returns the name a file is uploaded under when it is given by its path.
+ * The name is the path relative to the working directory when the file is inside it, and the file name
+ * alone otherwise, so it never climbs out of the user's directory on the server.
+ * @param filePath The path of the file.
+ * @return The name to upload the file under, with '/' separators.
+ */
+std::string FileHandler::uploadName(const std::string& filePath) {
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    fs::path absolute = fs::absolute(filePath, ec).lexically_normal();
+    fs::path workingDirectory = fs::current_path(ec);
+    fs::path relative = ec ? fs::path() : absolute.lexically_relative(workingDirectory);
+    if (relative.empty() || *relative.begin() == "..") {
+        return fs::path(filePath).filename().generic_string();
+    }
+    return relative.generic_string();
+}
+
+/**
+ * @brief Returns the name a file found under a synced or watched directory is uploaded under.
+ * The name is the directory's own name followed by the file's path relative to it, whichever way the
+ * directory was given, so the same tree is uploaded under the same names from any working directory.
+ * @param filePath The path of the file, starting with the directory as given.
+ * @param root The directory.
+ * @return The name to upload the file under, with '/' separators.
+ */
+std::string FileHandler::uploadName(const std::string& filePath, const std::string& root) {
+    namespace fs = std::filesystem;
+
+    fs::path relative = fs::path(filePath).lexically_normal().lexically_relative(fs::path(root).lexically_normal());
+    if (relative.empty() || *relative.begin() == "..") {
+        return uploadName(filePath);
+    }
+
+    std::error_code ec;
+    fs::path rootPath = fs::absolute(root, ec).lexically_normal();
+    if (!rootPath.has_filename()) {
+        rootPath = rootPath.parent_path(); // a trailing separator, as in "dir/" or "."
+    }
+    fs::path rootName = rootPath.filename();
+    if (ec || rootName.empty() || rootName == "..") {
+        return relative.generic_string(); // the root of the file system
+    }
+    return (rootName / relative).generic_string();
+}
 
 /**
  * @brief Writes the given content to a specified file.
@@ -2,6 +2,7 @@
 #define FILE_HANDLER
 
 #include <string>
+#include <vector>
 
 /**
  * @class FileHandler
@@ -40,6 +41,44 @@ public:
 	 */
 	static std::string getSpecificLine(const std::string& filePath, size_t lineNumber);
 
+	/**
+	 * @brief Retrieves every non-empty line of a file starting at a given line.
+	 * Trailing carriage returns are stripped and lines starting with '#' are skipped.
+	 * @param filePath The path to the file.
+	 * @param firstLine The first line number to retrieve (starting from 1).
+	 * @return The lines from firstLine to the end of the file.
+	 * @throws std::runtime_error if the file could not be opened.
+	 */
+	static std::vector<std::string> getLinesFrom(const std::string& filePath, size_t firstLine);
+
+	/**
+	 * @brief Expands a path pattern into the regular files it matches.
+	 * '*' matches any run of characters and '?' matches a single character, within one path component.
+	 * A pattern without wildcards is returned unchanged, whether or not the file exists.
+	 * @param pattern The path pattern to expand.
+	 * @return The matching file paths, sorted.
+	 */
+	static std::vector<std::string> expandGlob(const std::string& pattern);
+
+	/**
+	 * @brief Returns the name a file is uploaded under when it is given by its path.
+	 * The name is the path relative to the working directory when the file is inside it, and the file name
+	 * alone otherwise, so it never climbs out of the user's directory on the server.
+	 * @param filePath The path of the file.
+	 * @return The name to upload the file under, with '/' separators.
+	 */
+	static std::string uploadName(const std::string& filePath);
+
+	/**
+	 * @brief Returns the name a file found under a synced or watched directory is uploaded under.
+	 * The name is the directory's own name followed by the file's path relative to it, whichever way the
+	 * directory was given, so the same tree is uploaded under the same names from any working directory.
+	 * @param filePath The path of the file, starting with the directory as given.
+	 * @param root The directory.
+	 * @return The name to upload the file under, with '/' separators.
+	 */
+	static std::string uploadName(const std::string& filePath, const std::string& root);
+
 	/**
 	 * @brief Returns the size of the specified file in bytes.
 	 * @param filePath The path to the file.
@@ -0,0 +1,72 @@
+#include "FilePacketEncoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "RequestHeader.h"
+
+namespace {
+    constexpr size_t PAYLOAD_SIZE_OFFSET = Constants::CLIENT_ID_SIZE + Constants::VERSION_SIZE + Constants::CODE_SIZE;
+    constexpr size_t CONTENT_SIZE_OFFSET = Constants::REQUEST_HEADER_SIZE;
+    constexpr size_t ORIG_FILE_SIZE_OFFSET = CONTENT_SIZE_OFFSET + Constants::CONTENT_SIZE_SIZE;
+    constexpr size_t PACKET_NUMBER_OFFSET = ORIG_FILE_SIZE_OFFSET + Constants::ORIG_FILE_SIZE_SIZE;
+    constexpr size_t TOTAL_PACKETS_OFFSET = PACKET_NUMBER_OFFSET + Constants::PACKET_NUMBER_SIZE;
+    constexpr size_t FILE_NAME_OFFSET = TOTAL_PACKETS_OFFSET + Constants::TOTAL_PACKET_SIZE;
+
+    /**
+     * @brief Writes the low bytes of a number, little-endian, as the protocol encodes numbers.
+     *
+     * @param out Receives the bytes.
+     * @param value The number.
+     * @param bytes The number of bytes.
+     */
+    void writeLittleEndian(char* out, uint32_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) {
+            out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+}
+
+/**
+ * @brief Encodes the fields shared by every packet of a file.
+ *
+ * The file name is cut and null-terminated within its field, as RequestPayload does.
+ * @param clientId The client ID to put in the request headers, as 32 hex digits.
+ * @param fileName The file name reported to the server.
+ * @param origFileSize The size of the file before encryption.
+ * @param encryptedFileSize The size of the whole encrypted file.
+ * @param totalPackets The number of packets of the file.
+ * @throws std::invalid_argument if the client ID is not 32 hex digits.
+ */
+FilePacketEncoder::FilePacketEncoder(const std::string& clientId, const std::string& fileName, int origFileSize, int encryptedFileSize, int totalPackets) {
+    prefix.fill('\0');
+    std::vector<char> header = RequestHeader(clientId, Constants::VERSION, RequestHeader::Code::SendFileCode,
+        Constants::PACKET_SIZE - Constants::REQUEST_HEADER_SIZE).toBytes();
+    std::copy(header.begin(), header.end(), prefix.begin());
+
+    writeLittleEndian(&prefix[CONTENT_SIZE_OFFSET], encryptedFileSize, Constants::CONTENT_SIZE_SIZE);
+    writeLittleEndian(&prefix[ORIG_FILE_SIZE_OFFSET], origFileSize, Constants::ORIG_FILE_SIZE_SIZE);
+    writeLittleEndian(&prefix[TOTAL_PACKETS_OFFSET], totalPackets, Constants::TOTAL_PACKET_SIZE);
+    size_t nameLength = std::min(fileName.size(), static_cast<size_t>(Constants::FILE_NAME_SIZE - 1));
+    std::memcpy(&prefix[FILE_NAME_OFFSET], fileName.data(), nameLength);
+}
+
+/**
+ * @brief Encodes the next packet of the file into a frame.
+ *
+ * @param frame The frame, at least Constants::PACKET_SIZE bytes.
+ * @param content The encrypted bytes of the packet.
+ * @param size The number of bytes, at most Constants::PACKET_CONTENT_SIZE.
+ * @return The number of bytes of the request in the frame.
+ */
+size_t FilePacketEncoder::encode(char* frame, const char* content, size_t size) {
+    std::memcpy(frame, prefix.data(), prefix.size());
+    if (size != static_cast<size_t>(Constants::PACKET_CONTENT_SIZE)) {
+        writeLittleEndian(frame + PAYLOAD_SIZE_OFFSET, static_cast<uint32_t>(Constants::FILE_PACKET_PREFIX_SIZE - Constants::REQUEST_HEADER_SIZE + size),
+            Constants::PAYLOAD_SIZE_SIZE);
+    }
+    writeLittleEndian(frame + PACKET_NUMBER_OFFSET, nextPacket++, Constants::PACKET_NUMBER_SIZE);
+    std::memcpy(frame + prefix.size(), content, size);
+    return prefix.size() + size;
+}
@@ -0,0 +1,55 @@
+#ifndef FILE_PACKET_ENCODER_H
+#define FILE_PACKET_ENCODER_H
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+#include "Constants.h"
+
+/**
+ * @class FilePacketEncoder
+ * @brief Encodes the send file requests of one file straight into caller-provided frames.
+ *
+ * Produces the same bytes as building a RequestHeader, RequestPayload and Request per packet and calling
+ * Request::toBytes(), without their temporaries: the header and the fields that are the same in every packet
+ * of the file are encoded once, and each packet copies them and the content into its frame and patches the
+ * packet number, and the payload size of a short last packet.
+ */
+class FilePacketEncoder {
+public:
+    /**
+     * @brief Encodes the fields shared by every packet of a file.
+     *
+     * @param clientId The client ID to put in the request headers, as 32 hex digits.
+     * @param fileName The file name reported to the server.
+     * @param origFileSize The size of the file before encryption.
+     * @param encryptedFileSize The size of the whole encrypted file.
+     * @param totalPackets The number of packets of the file.
+     * @throws std::invalid_argument if the client ID is not 32 hex digits.
+     */
+    FilePacketEncoder(const std::string& clientId, const std::string& fileName, int origFileSize, int encryptedFileSize, int totalPackets);
+
+    /**
+     * @brief Encodes the next packet of the file into a frame.
+     *
+     * @param frame The frame, at least Constants::PACKET_SIZE bytes.
+     * @param content The encrypted bytes of the packet.
+     * @param size The number of bytes, at most Constants::PACKET_CONTENT_SIZE.
+     * @return The number of bytes of the request in the frame.
+     */
+    size_t encode(char* frame, const char* content, size_t size);
+
+    /**
+     * @brief Returns the number of the packet encode() encodes next.
+     *
+     * @return The packet number, from 1.
+     */
+    int packetNumber() const { return nextPacket; }
+
+private:
+    std::array<char, Constants::FILE_PACKET_PREFIX_SIZE> prefix;    ///< The header and fields of a full packet.
+    int nextPacket = 1;     ///< The number of the next packet.
+};
+
+#endif // FILE_PACKET_ENCODER_H
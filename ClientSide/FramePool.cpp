@@ -0,0 +1,49 @@
+#include "FramePool.h"
+
+#include <new>
+
+/**
+ * @brief Allocates the frames.
+ *
+ * @param frameSize The size of every frame; a multiple of the alignment keeps every frame aligned.
+ * @param frameCount The number of frames.
+ * @param alignment The alignment of the slab, a power of two.
+ */
+FramePool::FramePool(size_t frameSize, size_t frameCount, size_t alignment)
+    : size(frameSize), count(frameCount), alignment(alignment),
+    slab(static_cast<char*>(::operator new(frameSize * frameCount, std::align_val_t(alignment)))) {
+    free.reserve(count);
+    for (size_t i = count; i-- > 0; ) {
+        free.push_back(slab + i * size);
+    }
+}
+
+/**
+ * @brief Frees the frames; none may be in use.
+ */
+FramePool::~FramePool() {
+    ::operator delete(slab, std::align_val_t(alignment));
+}
+
+/**
+ * @brief Takes a free frame.
+ *
+ * @return The frame, or nullptr if every frame is in use.
+ */
+char* FramePool::acquire() {
+    if (free.empty()) {
+        return nullptr;
+    }
+    char* frame = free.back();
+    free.pop_back();
+    return frame;
+}
+
+/**
+ * @brief Returns a frame taken with acquire().
+ *
+ * @param frame The frame.
+ */
+void FramePool::release(char* frame) {
+    free.push_back(frame);
+}
@@ -0,0 +1,72 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @class FramePool
+ * @brief A fixed set of equally sized, aligned buffers that requests are encoded into before they are written.
+ *
+ * All the frames live in one aligned slab allocated when the pool is created, and acquiring and releasing a
+ * frame only moves a pointer on a stack whose capacity is reserved up front, so a send loop that takes its
+ * frames from the pool does not allocate. Frames are handed out lowest address first and a frame released is
+ * the next one acquired, so frames acquired together and released in reverse are adjacent again the next time,
+ * which lets the writer send a run of full frames in one write. Not thread-safe; each session owns its pool.
+ */
+class FramePool {
+public:
+    /**
+     * @brief Allocates the frames.
+     *
+     * @param frameSize The size of every frame; a multiple of the alignment keeps every frame aligned.
+     * @param frameCount The number of frames.
+     * @param alignment The alignment of the slab, a power of two.
+     */
+    FramePool(size_t frameSize, size_t frameCount, size_t alignment);
+
+    /**
+     * @brief Frees the frames; none may be in use.
+     */
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /**
+     * @brief Takes a free frame.
+     *
+     * @return The frame, or nullptr if every frame is in use.
+     */
+    char* acquire();
+
+    /**
+     * @brief Returns a frame taken with acquire().
+     *
+     * @param frame The frame.
+     */
+    void release(char* frame);
+
+    /**
+     * @brief Returns the size of every frame.
+     *
+     * @return The size in bytes.
+     */
+    size_t frameSize() const { return size; }
+
+    /**
+     * @brief Returns the number of frames, free or not.
+     *
+     * @return The frame count.
+     */
+    size_t frameCount() const { return count; }
+
+private:
+    size_t size;                    ///< The size of every frame.
+    size_t count;                   ///< The number of frames.
+    size_t alignment;               ///< The alignment of the slab.
+    char* slab;                     ///< The frames, one after another.
+    std::vector<char*> free;        ///< The free frames; the back is acquired next.
+};
+
+#endif // FRAME_POOL_H
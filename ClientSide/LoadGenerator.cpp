@@ -0,0 +1,369 @@
+#include "LoadGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    /// The operation names, by LoadGenerator::Operation.
+    const char* const OPERATION_NAMES[] = { "connect", "reconnect", "register", "upload" };
+
+    /**
+     * @brief Returns a percentile of some samples, by the nearest rank.
+     *
+     * @param sorted The samples, sorted.
+     * @param fraction The percentile, between 0 and 1.
+     * @return The percentile, or 0 if there are no samples.
+     */
+    double percentile(const std::vector<double>& sorted, double fraction) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+        return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+}
+
+/**
+ * @brief Creates the load generator.
+ *
+ * @param address The server address.
+ * @param port The server port.
+ * @param userName The prefix of the simulated user names.
+ * @param options The shape of the load.
+ * @param reconnect Reconnects a session of a client with cached credentials.
+ * @param registerUser Registers a session of a client without them.
+ * @throws std::invalid_argument if the size mix is empty or a size needs more packets than the protocol can number.
+ */
+LoadGenerator::LoadGenerator(const std::string& address, const std::string& port, const std::string& userName,
+    const LoadOptions& options, Reconnector reconnect, Registrar registerUser)
+    : address(address), port(port), userName(userName), options(options), reconnect(std::move(reconnect)),
+    registerUser(std::move(registerUser)) {
+    if (options.sizes.empty()) {
+        throw std::invalid_argument("The load needs at least one file size.");
+    }
+
+    std::mt19937 random(0);
+    for (const LoadFileSize& size : options.sizes) {
+        size_t encryptedSize = (size.bytes / 16 + 1) * 16; // CBC with PKCS#7 padding
+        if ((encryptedSize + Constants::PACKET_CONTENT_SIZE - 1) / Constants::PACKET_CONTENT_SIZE > Constants::MAX_PACKETS) {
+            throw std::invalid_argument("File size " + std::to_string(size.bytes) + " needs more packets than the protocol can number.");
+        }
+        SyntheticFile file;
+        file.name = "load-" + std::to_string(size.bytes) + ".bin";
+        file.content.resize(size.bytes);
+        for (char& byte : file.content) {
+            byte = static_cast<char>(random());
+        }
+        file.crc = CRC_Calculator::memcrc(file.content.data(), file.content.size());
+        files.push_back(std::move(file));
+    }
+}
+
+/**
+ * @brief Runs the load, printing the progress every second and the report at the end.
+ *
+ * The clients arrive at the configured rate, or all at once; clients that would arrive after the end of
+ * the run are not started. If the system refuses to start more threads, the run goes on with the clients
+ * already started.
+ * @param out Where the progress and the report are printed.
+ * @return The report.
+ */
+LoadReport LoadGenerator::run(std::ostream& out) {
+    fs::create_directories(options.cacheDir);
+
+    std::vector<ClientStats> stats(options.clients);
+    std::vector<std::thread> threads;
+    threads.reserve(options.clients);
+
+    auto start = Clock::now();
+    deadline = start + std::chrono::seconds(options.durationSeconds);
+    std::mt19937 random(static_cast<unsigned int>(options.clients));
+    std::exponential_distribution<double> gap(options.arrivalRate > 0 ? options.arrivalRate : 1);
+    double arrivalSeconds = 0;
+    for (size_t i = 0; i < options.clients; i++) {
+        auto arrival = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(arrivalSeconds));
+        if (arrival >= deadline) {
+            break;
+        }
+        try {
+            threads.emplace_back(&LoadGenerator::simulate, this, i, arrival, std::ref(stats[i]));
+        }
+        catch (const std::system_error& e) {
+            Log::warn("Could not start more clients", { { "started", threads.size() }, { "reason", e.what() } });
+            break;
+        }
+        if (options.arrivalRate > 0) {
+            arrivalSeconds += gap(random);
+        }
+    }
+    stats.resize(threads.size());
+
+    out << std::right << std::setw(8) << "second" << std::setw(10) << "active" << std::setw(12) << "uploads/s"
+        << std::setw(10) << "MB/s" << std::setw(10) << "errors" << std::endl;
+    std::vector<LoadSample> timeline;
+    uint64_t lastUploads = 0;
+    uint64_t lastBytes = 0;
+    uint64_t lastFailures = 0;
+    for (int second = 1; second <= options.durationSeconds; second++) {
+        std::this_thread::sleep_until(start + std::chrono::seconds(second));
+        LoadSample sample;
+        sample.second = second;
+        sample.active = activeClients.load();
+        uint64_t totalUploads = uploads.load();
+        uint64_t totalBytes = uploadedBytes.load();
+        uint64_t totalFailures = failures.load();
+        sample.uploads = totalUploads - lastUploads;
+        sample.bytes = totalBytes - lastBytes;
+        sample.errors = totalFailures - lastFailures;
+        lastUploads = totalUploads;
+        lastBytes = totalBytes;
+        lastFailures = totalFailures;
+        timeline.push_back(sample);
+        out << std::setw(8) << sample.second << std::setw(10) << sample.active << std::setw(12) << sample.uploads
+            << std::fixed << std::setprecision(1) << std::setw(10) << sample.bytes / 1e6 << std::setw(10) << sample.errors << std::endl;
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    LoadReport report = summarize(stats, seconds);
+    report.timeline = std::move(timeline);
+    print(report, out);
+    return report;
+}
+
+/**
+ * @brief Writes a report as JSON, for comparing runs.
+ *
+ * @param report The report.
+ * @param path The file to write.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void LoadGenerator::writeJson(const LoadReport& report, const std::string& path) {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+
+    file << std::fixed << std::setprecision(3) << "{\n  \"clients\":" << report.clients << ",\"seconds\":" << report.seconds
+        << ",\"uploads\":" << report.uploads << ",\"bytes\":" << report.bytes << ",\n  \"operations\":[\n";
+    for (size_t i = 0; i < report.operations.size(); i++) {
+        const LoadOperationStats& operation = report.operations[i];
+        file << "    {\"name\":" << TransferMetrics::quoteJson(operation.name) << ",\"count\":" << operation.count
+            << ",\"errors\":" << operation.errors << ",\"p50_ms\":" << operation.p50Ms << ",\"p90_ms\":" << operation.p90Ms
+            << ",\"p99_ms\":" << operation.p99Ms << ",\"p999_ms\":" << operation.p999Ms << ",\"max_ms\":" << operation.maxMs
+            << (i + 1 < report.operations.size() ? "},\n" : "}\n");
+    }
+    file << "  ],\n  \"errors\":{";
+    for (auto it = report.errors.begin(); it != report.errors.end(); ++it) {
+        file << (it == report.errors.begin() ? "" : ",") << TransferMetrics::quoteJson(it->first) << ":" << it->second;
+    }
+    file << "},\n  \"timeline\":[\n";
+    for (size_t i = 0; i < report.timeline.size(); i++) {
+        const LoadSample& sample = report.timeline[i];
+        file << "    {\"second\":" << sample.second << ",\"active\":" << sample.active << ",\"uploads\":" << sample.uploads
+            << ",\"bytes\":" << sample.bytes << ",\"errors\":" << sample.errors << (i + 1 < report.timeline.size() ? "},\n" : "}\n");
+    }
+    file << "  ]\n}\n";
+
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+/**
+ * @brief Runs one simulated client until the deadline.
+ *
+ * Every session connects, authenticates and uploads up to LoadOptions::uploadsPerSession files, pausing
+ * after each. A session that failed is dropped, and the client pauses before the next one.
+ * @param index The number of the client, naming its user and seeding its random choices.
+ * @param arrival When the client starts.
+ * @param stats Receives what the client measured.
+ */
+void LoadGenerator::simulate(size_t index, Clock::time_point arrival, ClientStats& stats) {
+    std::mt19937 random(static_cast<unsigned int>(index));
+    std::exponential_distribution<double> think(options.thinkTimeMs > 0 ? 1.0 / options.thinkTimeMs : 1);
+    std::vector<double> weights;
+    for (const LoadFileSize& size : options.sizes) {
+        weights.push_back(size.weight);
+    }
+    std::discrete_distribution<size_t> pickFile(weights.begin(), weights.end());
+    auto pause = [&]() {
+        if (options.thinkTimeMs > 0) {
+            auto wake = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(think(random)));
+            std::this_thread::sleep_until(std::min(wake, deadline));
+        }
+    };
+
+    std::string user = userName + "-load-" + std::to_string(index);
+    std::string credentialsDir = (fs::path(options.cacheDir) / user).string();
+    fs::create_directories(credentialsDir);
+
+    std::this_thread::sleep_until(arrival);
+    while (Clock::now() < deadline) {
+        std::unique_ptr<ClientSession> session;
+        if (!timed(Connect, nullptr, [&]() { session = std::make_unique<ClientSession>(address, port, credentialsDir); return true; }, stats)) {
+            pause();
+            continue;
+        }
+        activeClients++;
+
+        std::string clientId;
+        bool connected = true; // false once the session failed in a way that leaves the connection unusable
+        bool authenticated = false;
+        if (session->hasCredentials()) {
+            authenticated = timed(Reconnect, session.get(), [&]() { return reconnect(*session, clientId); }, stats);
+            connected = authenticated || session->lastResponseCode() == ResponseHeader::Code::ReconnectionFailure;
+        }
+        if (!authenticated && connected) {
+            authenticated = timed(Register, session.get(), [&]() { return registerUser(*session, user, clientId); }, stats);
+        }
+        connected = authenticated;
+
+        // Encrypted once per size and session, as the AES key changes with every session
+        std::map<size_t, std::vector<char>> encrypted;
+        for (int upload = 0; connected && upload < options.uploadsPerSession && Clock::now() < deadline; upload++) {
+            size_t choice = pickFile(random);
+            const SyntheticFile& file = files[choice];
+            std::vector<char>& content = encrypted[choice];
+            if (content.empty()) {
+                const std::string& aesKey = session->getAESKey();
+                AESWrapper aes(reinterpret_cast<const unsigned char*>(aesKey.data()), static_cast<unsigned int>(aesKey.size()));
+                std::string cipher = aes.encrypt(file.content.data(), static_cast<unsigned int>(file.content.size()));
+                content.assign(cipher.begin(), cipher.end());
+            }
+
+            // A refused upload or a CRC mismatch leaves the session usable, an exception does not
+            connected = false;
+            if (timed(Upload, session.get(), [&]() {
+                unsigned long crc = session->getServerCRC(file.name, static_cast<int>(file.content.size()), content, clientId);
+                connected = true;
+                return crc == file.crc;
+            }, stats)) {
+                stats.uploadedBytes += file.content.size();
+                uploads++;
+                uploadedBytes += file.content.size();
+            }
+            pause();
+        }
+
+        activeClients--;
+        if (!authenticated) {
+            pause();
+        }
+    }
+}
+
+/**
+ * @brief Runs an operation of a client and records its latency, or its failure and cause.
+ *
+ * A refused operation is recorded by the response code of the server, or as a CRC mismatch if the server
+ * received the file; an operation that threw is recorded by its exception, usually the network error.
+ * @param operation The operation.
+ * @param session The session the operation uses, for the response code of a failure; null while connecting.
+ * @param action The operation; returns false if the server refused it or the CRC did not match.
+ * @param stats Receives the latency or the failure.
+ * @return true if the operation succeeded.
+ */
+bool LoadGenerator::timed(Operation operation, const ClientSession* session, const std::function<bool()>& action, ClientStats& stats) {
+    std::string cause;
+    auto start = Clock::now();
+    try {
+        if (action()) {
+            stats.latenciesMs[operation].push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            return true;
+        }
+        int code = session ? session->lastResponseCode() : 0;
+        cause = code == ResponseHeader::Code::FileReceived ? "CRC mismatch" : "response " + std::to_string(code);
+    }
+    catch (const std::exception& e) {
+        cause = e.what();
+    }
+    stats.errors[operation]++;
+    stats.causes[std::string(OPERATION_NAMES[operation]) + ": " + cause]++;
+    failures++;
+    return false;
+}
+
+/**
+ * @brief Summarizes the measurements of every client.
+ *
+ * @param stats What the clients measured.
+ * @param seconds How long the run took.
+ * @return The report, without the timeline.
+ */
+LoadReport LoadGenerator::summarize(const std::vector<ClientStats>& stats, double seconds) {
+    LoadReport report;
+    report.clients = stats.size();
+    report.seconds = seconds;
+    report.bytes = 0;
+    for (const ClientStats& client : stats) {
+        report.bytes += client.uploadedBytes;
+        for (const auto& cause : client.causes) {
+            report.errors[cause.first] += cause.second;
+        }
+    }
+
+    for (int operation = 0; operation < OperationCount; operation++) {
+        std::vector<double> latencies;
+        LoadOperationStats summary;
+        summary.name = OPERATION_NAMES[operation];
+        summary.errors = 0;
+        for (const ClientStats& client : stats) {
+            latencies.insert(latencies.end(), client.latenciesMs[operation].begin(), client.latenciesMs[operation].end());
+            summary.errors += client.errors[operation];
+        }
+        std::sort(latencies.begin(), latencies.end());
+        summary.count = latencies.size();
+        summary.p50Ms = percentile(latencies, 0.50);
+        summary.p90Ms = percentile(latencies, 0.90);
+        summary.p99Ms = percentile(latencies, 0.99);
+        summary.p999Ms = percentile(latencies, 0.999);
+        summary.maxMs = latencies.empty() ? 0 : latencies.back();
+        report.operations.push_back(summary);
+    }
+    report.uploads = report.operations[Upload].count;
+    return report;
+}
+
+/**
+ * @brief Prints a report as tables.
+ *
+ * @param report The report.
+ * @param out Where it is printed.
+ */
+void LoadGenerator::print(const LoadReport& report, std::ostream& out) {
+    out << "\n" << report.clients << " clients, " << report.uploads << " uploads in " << std::fixed << std::setprecision(1)
+        << report.seconds << " s: " << report.uploads / report.seconds << " uploads/s, " << report.bytes / 1e6 / report.seconds
+        << " MB/s\n\n";
+
+    out << std::left << std::setw(12) << "operation" << std::right << std::setw(10) << "count" << std::setw(10) << "errors"
+        << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "p99.9 ms"
+        << std::setw(10) << "max ms" << std::endl;
+    for (const LoadOperationStats& operation : report.operations) {
+        out << std::left << std::setw(12) << operation.name << std::right << std::setw(10) << operation.count << std::setw(10)
+            << operation.errors << std::setprecision(2) << std::setw(10) << operation.p50Ms << std::setw(10) << operation.p90Ms
+            << std::setw(10) << operation.p99Ms << std::setw(10) << operation.p999Ms << std::setw(10) << operation.maxMs << std::endl;
+    }
+
+    if (!report.errors.empty()) {
+        out << "\n" << std::right << std::setw(10) << "count" << "  error" << std::endl;
+        for (const auto& error : report.errors) {
+            out << std::setw(10) << error.second << "  " << error.first << std::endl;
+        }
+    }
+}
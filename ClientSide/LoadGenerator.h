@@ -0,0 +1,218 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ClientSission.h"
+
+/**
+ * @struct LoadFileSize
+ * @brief One file size of the synthetic upload mix, with its relative weight.
+ */
+struct LoadFileSize {
+    size_t bytes;   ///< The file size.
+    double weight;  ///< How often the size is picked, relative to the other sizes.
+};
+
+/**
+ * @struct LoadOptions
+ * @brief The shape of the simulated load.
+ */
+struct LoadOptions {
+    size_t clients = Constants::LOAD_DEFAULT_CLIENTS;           ///< The number of simulated clients, each on its own thread.
+    int durationSeconds = Constants::LOAD_DEFAULT_DURATION_S;   ///< How long the load runs; no upload starts after it.
+    double arrivalRate = 0;                                     ///< Clients arriving per second, as a Poisson process; 0 starts them all at once.
+    int thinkTimeMs = Constants::LOAD_DEFAULT_THINK_MS;         ///< The mean of the exponential pause after every upload.
+    int uploadsPerSession = Constants::LOAD_DEFAULT_UPLOADS_PER_SESSION; ///< Uploads before the client disconnects and reconnects.
+    std::vector<LoadFileSize> sizes;                            ///< The upload mix; may not be empty.
+    std::string cacheDir = Constants::LOAD_CACHE_DIR;           ///< Holds the credentials of every simulated user between runs.
+    std::string jsonPath;                                       ///< The JSON file of the report, or empty.
+};
+
+/**
+ * @struct LoadOperationStats
+ * @brief The latencies of one kind of operation over a load run.
+ */
+struct LoadOperationStats {
+    std::string name;       ///< connect, reconnect, register or upload.
+    uint64_t count;         ///< The operations that succeeded.
+    uint64_t errors;        ///< The operations that failed.
+    double p50Ms;           ///< Latency percentiles of the successful operations, in milliseconds.
+    double p90Ms;
+    double p99Ms;
+    double p999Ms;
+    double maxMs;           ///< The longest successful operation, in milliseconds.
+};
+
+/**
+ * @struct LoadSample
+ * @brief The progress of a load run in one second.
+ */
+struct LoadSample {
+    int second;             ///< Seconds since the run started.
+    uint64_t active;        ///< Clients connected at the end of the second.
+    uint64_t uploads;       ///< Uploads completed within the second.
+    uint64_t bytes;         ///< Bytes of the files uploaded within the second.
+    uint64_t errors;        ///< Operations failed within the second.
+};
+
+/**
+ * @struct LoadReport
+ * @brief The results of a load run.
+ */
+struct LoadReport {
+    size_t clients;                             ///< The clients that were started.
+    double seconds;                             ///< How long the run took, including the uploads in flight at its end.
+    uint64_t uploads;                           ///< The files whose CRC the server confirmed.
+    uint64_t bytes;                             ///< Their total size.
+    std::vector<LoadOperationStats> operations; ///< The latencies, by operation.
+    std::map<std::string, uint64_t> errors;     ///< How often every failure happened, by operation and cause.
+    std::vector<LoadSample> timeline;           ///< The progress, second by second.
+};
+
+/**
+ * @class LoadGenerator
+ * @brief Drives a server with many concurrent simulated clients, to find where it stops keeping up.
+ *
+ * Every simulated client is a user of its own, named after the configured user name, and runs on its own
+ * thread with its own blocking ClientSession, like a separate client process would. After arriving it
+ * repeatedly connects, reconnects with its cached credentials or registers when it has none or the server
+ * forgot them, then uploads synthetic files drawn from the size mix, pausing an exponentially distributed
+ * think time after each upload, until the run ends. The credentials live in a directory per user under the
+ * cache directory, so later runs reuse the RSA keys instead of generating thousands of them again.
+ *
+ * The latencies are measured per operation; failures are counted by the server's response code, a CRC
+ * mismatch, or the network error that ended the session. The file content is encrypted once per session and
+ * size, outside the measured upload, so that the generating machine spends its CPU on the connections.
+ */
+class LoadGenerator {
+public:
+    /**
+     * @brief Reconnects a session with its stored credentials, giving the client ID; false if the server refused.
+     */
+    using Reconnector = std::function<bool(ClientSession&, std::string&)>;
+
+    /**
+     * @brief Registers a session as the given user, giving the client ID; false if the server refused.
+     */
+    using Registrar = std::function<bool(ClientSession&, const std::string&, std::string&)>;
+
+    /**
+     * @brief Creates the load generator.
+     *
+     * @param address The server address.
+     * @param port The server port.
+     * @param userName The prefix of the simulated user names.
+     * @param options The shape of the load.
+     * @param reconnect Reconnects a session of a client with cached credentials.
+     * @param registerUser Registers a session of a client without them.
+     * @throws std::invalid_argument if the size mix is empty or a size needs more packets than the protocol can number.
+     */
+    LoadGenerator(const std::string& address, const std::string& port, const std::string& userName,
+        const LoadOptions& options, Reconnector reconnect, Registrar registerUser);
+
+    /**
+     * @brief Runs the load, printing the progress every second and the report at the end.
+     *
+     * @param out Where the progress and the report are printed.
+     * @return The report.
+     */
+    LoadReport run(std::ostream& out);
+
+    /**
+     * @brief Writes a report as JSON, for comparing runs.
+     *
+     * @param report The report.
+     * @param path The file to write.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    static void writeJson(const LoadReport& report, const std::string& path);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief The measured operations.
+     */
+    enum Operation { Connect, Reconnect, Register, Upload, OperationCount };
+
+    /**
+     * @struct SyntheticFile
+     * @brief The content of one size of the mix, shared by every client.
+     */
+    struct SyntheticFile {
+        std::string name;           ///< The file name sent to the server.
+        std::vector<char> content;  ///< The random content.
+        unsigned long crc;          ///< The CRC of the content.
+    };
+
+    /**
+     * @struct ClientStats
+     * @brief What one simulated client measured; only its thread writes it.
+     */
+    struct ClientStats {
+        std::vector<double> latenciesMs[OperationCount];    ///< The successful operations.
+        uint64_t errors[OperationCount] = {};               ///< The failed operations.
+        std::map<std::string, uint64_t> causes;             ///< The failures, by operation and cause.
+        uint64_t uploadedBytes = 0;                         ///< The size of the confirmed files.
+    };
+
+    std::string address;                    ///< The server address.
+    std::string port;                       ///< The server port.
+    std::string userName;                   ///< The prefix of the user names.
+    LoadOptions options;                    ///< The shape of the load.
+    Reconnector reconnect;                  ///< Reconnects sessions.
+    Registrar registerUser;                 ///< Registers sessions.
+    std::vector<SyntheticFile> files;       ///< The content of every size of the mix.
+    Clock::time_point deadline;             ///< No operation starts after it.
+    std::atomic<uint64_t> activeClients{ 0 };   ///< Clients with a connected session.
+    std::atomic<uint64_t> uploads{ 0 };         ///< Uploads confirmed so far.
+    std::atomic<uint64_t> uploadedBytes{ 0 };   ///< Their total size.
+    std::atomic<uint64_t> failures{ 0 };        ///< Operations failed so far.
+
+    /**
+     * @brief Runs one simulated client until the deadline.
+     *
+     * @param index The number of the client, naming its user and seeding its random choices.
+     * @param arrival When the client starts.
+     * @param stats Receives what the client measured.
+     */
+    void simulate(size_t index, Clock::time_point arrival, ClientStats& stats);
+
+    /**
+     * @brief Runs an operation of a client and records its latency, or its failure and cause.
+     *
+     * @param operation The operation.
+     * @param session The session the operation uses, for the response code of a failure; null while connecting.
+     * @param action The operation; returns false if the server refused it or the CRC did not match.
+     * @param stats Receives the latency or the failure.
+     * @return true if the operation succeeded.
+     */
+    bool timed(Operation operation, const ClientSession* session, const std::function<bool()>& action, ClientStats& stats);
+
+    /**
+     * @brief Summarizes the measurements of every client.
+     *
+     * @param stats What the clients measured.
+     * @param seconds How long the run took.
+     * @return The report, without the timeline.
+     */
+    static LoadReport summarize(const std::vector<ClientStats>& stats, double seconds);
+
+    /**
+     * @brief Prints a report as tables.
+     *
+     * @param report The report.
+     * @param out Where it is printed.
+     */
+    static void print(const LoadReport& report, std::ostream& out);
+};
+
+#endif // LOAD_GENERATOR_H
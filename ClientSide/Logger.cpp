@@ -0,0 +1,365 @@
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "TransferMetrics.h"
+
+namespace {
+
+    constexpr size_t RING_MASK = Constants::LOG_RING_CAPACITY - 1;
+    static_assert((Constants::LOG_RING_CAPACITY & RING_MASK) == 0, "LOG_RING_CAPACITY must be a power of two");
+    static_assert(Constants::LOG_TEXT_CAPACITY <= UINT16_MAX, "LOG_TEXT_CAPACITY must fit a text offset");
+
+    /**
+     * @brief Returns a small id of the calling thread, numbered from 1 in the order threads first log.
+     *
+     * @return The id of the calling thread.
+     */
+    uint32_t currentThreadId() {
+        static std::atomic<uint32_t> nextId(1);
+        thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+    /**
+     * @brief Returns the name of a level as written in a record.
+     *
+     * @param level The level.
+     * @return The upper-case name.
+     */
+    const char* levelName(LogLevel level) {
+        switch (level) {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warn: return "WARN";
+        case LogLevel::Error: return "ERROR";
+        default: return "OFF";
+        }
+    }
+
+    /**
+     * @brief Returns whether a text value must be quoted in a text record.
+     *
+     * @param text The value.
+     * @return true if the value is empty or contains spaces, quotes, '=' or control characters.
+     */
+    bool needsQuotes(std::string_view text) {
+        if (text.empty()) {
+            return true;
+        }
+        for (char c : text) {
+            if (c == ' ' || c == '"' || c == '=' || static_cast<unsigned char>(c) < 0x20) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+/**
+ * @brief Returns the logger of the process, starting its writer thread on first use.
+ *
+ * @return The process-wide instance.
+ */
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+/**
+ * @brief Creates the ring and starts the writer thread. Logs Info and above as text until configured.
+ */
+Logger::Logger()
+    : cells(new Cell[Constants::LOG_RING_CAPACITY]), enqueuePosition(0), dequeuePosition(0), dropped(0), written(0),
+      minLevel(static_cast<int>(LogLevel::Info)), json(false), stopping(false) {
+    for (size_t i = 0; i < Constants::LOG_RING_CAPACITY; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer = std::thread(&Logger::run, this);
+}
+
+/**
+ * @brief Stops the writer thread after it wrote every queued record.
+ */
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+/**
+ * @brief Sets the lowest level that is logged and the output format.
+ *
+ * @param level The lowest logged level.
+ * @param json Whether records are written as JSON lines instead of text.
+ */
+void Logger::configure(LogLevel level, bool json) {
+    minLevel = static_cast<int>(level);
+    this->json = json;
+}
+
+/**
+ * @brief Queues a record for the writer thread.
+ *
+ * Claims a cell of the ring with one compare-and-swap (Vyukov's bounded queue) and copies the record into
+ * it; text values are cut to what fits Constants::LOG_TEXT_CAPACITY. Never blocks: if the ring is full, the
+ * record is dropped and counted, and the count is reported with the next record written.
+ * @param level The level of the record.
+ * @param message The message, a string literal.
+ * @param fields The structured fields.
+ */
+void Logger::write(LogLevel level, const char* message, std::initializer_list<LogField> fields) {
+    Cell* cell;
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &cells[position & RING_MASK];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    Record& record = cell->record;
+    record.level = level;
+    record.threadId = currentThreadId();
+    record.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.message = message;
+    record.fieldCount = 0;
+    record.textUsed = 0;
+    for (const LogField& field : fields) {
+        if (record.fieldCount == Constants::LOG_MAX_FIELDS) {
+            break;
+        }
+        Record::Field& copy = record.fields[record.fieldCount++];
+        copy.key = field.key;
+        copy.type = field.type;
+        copy.signedValue = field.signedValue;
+        copy.unsignedValue = field.unsignedValue;
+        copy.realValue = field.realValue;
+        copy.textOffset = record.textUsed;
+        copy.textLength = 0;
+        if (field.type == LogField::Type::Text) {
+            size_t length = std::min(field.text.size(), Constants::LOG_TEXT_CAPACITY - record.textUsed);
+            std::memcpy(record.text + record.textUsed, field.text.data(), length);
+            copy.textLength = static_cast<uint16_t>(length);
+            record.textUsed = static_cast<uint16_t>(record.textUsed + length);
+        }
+    }
+
+    cell->sequence.store(position + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Waits until every record queued so far was written.
+ *
+ * Call before the process exits, and before writing to the console directly, so that the output is in order.
+ */
+void Logger::flush() {
+    size_t target = enqueuePosition.load(std::memory_order_acquire);
+    while (written.load(std::memory_order_acquire) < target) {
+        wake.notify_one();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+/**
+ * @brief Parses a level name: debug, info, warn, error or off.
+ *
+ * @param name The level name.
+ * @param level Receives the level.
+ * @return true if the name is a level.
+ */
+bool Logger::parseLevel(const std::string& name, LogLevel& level) {
+    static const struct { const char* name; LogLevel level; } levels[] = {
+        { "debug", LogLevel::Debug }, { "info", LogLevel::Info }, { "warn", LogLevel::Warn },
+        { "error", LogLevel::Error }, { "off", LogLevel::Off }
+    };
+    for (const auto& entry : levels) {
+        if (name == entry.name) {
+            level = entry.level;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Writer loop: drains the ring periodically until stopped, then drains it a last time.
+ */
+void Logger::run() {
+    for (;;) {
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(Constants::LOG_DRAIN_INTERVAL_MS), [this] { return stopping.load(); });
+            stop = stopping;
+        }
+        drain();
+        if (stop) {
+            // Producers that claimed a cell before the stop are still filling it
+            while (dequeuePosition != enqueuePosition.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+                drain();
+            }
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Writes every record currently in the ring.
+ *
+ * Debug and Info records go to the standard output, Warn and Error records to the standard error. Each
+ * stream is written and flushed once per drain.
+ * @return The number of records written.
+ */
+size_t Logger::drain() {
+    std::string out;
+    std::string errors;
+    size_t count = 0;
+
+    for (;;) {
+        Cell& cell = cells[dequeuePosition & RING_MASK];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+            break;
+        }
+        format(cell.record, cell.record.level >= LogLevel::Warn ? errors : out);
+        cell.sequence.store(dequeuePosition + Constants::LOG_RING_CAPACITY, std::memory_order_release);
+        ++dequeuePosition;
+        ++count;
+    }
+
+    uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0) {
+        Record record{};
+        record.level = LogLevel::Warn;
+        record.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        record.message = "Log records dropped";
+        record.fieldCount = 1;
+        record.fields[0] = { "count", LogField::Type::Unsigned, 0, lost, 0, 0, 0 };
+        format(record, errors);
+    }
+
+    if (!out.empty()) {
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+    }
+    if (!errors.empty()) {
+        std::fwrite(errors.data(), 1, errors.size(), stderr);
+        std::fflush(stderr);
+    }
+    written.fetch_add(count, std::memory_order_release);
+    return count;
+}
+
+/**
+ * @brief Appends a record to the output buffer in the configured format.
+ *
+ * Text records read "2026-01-31T12:00:00.000000Z INFO  message key=value ..."; JSON records are objects
+ * with "ts", "level", "thread", "msg" and one member per field.
+ * @param record The record.
+ * @param out The output buffer.
+ */
+void Logger::format(const Record& record, std::string& out) const {
+    std::time_t seconds = static_cast<std::time_t>(record.timeUs / 1000000);
+    std::tm utc{};
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char timestamp[64];
+    std::snprintf(timestamp, sizeof(timestamp), "%04d-%02d-%02dT%02d:%02d:%02d.%06dZ", utc.tm_year + 1900, utc.tm_mon + 1,
+        utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec, static_cast<int>(record.timeUs % 1000000));
+
+    bool asJson = json.load(std::memory_order_relaxed);
+    char number[32];
+    if (asJson) {
+        out += "{\"ts\":\"";
+        out += timestamp;
+        out += "\",\"level\":\"";
+        out += levelName(record.level);
+        out += "\",\"thread\":";
+        out += std::to_string(record.threadId);
+        out += ",\"msg\":";
+        out += TransferMetrics::quoteJson(record.message);
+    }
+    else {
+        std::snprintf(number, sizeof(number), " %-5s ", levelName(record.level));
+        out += timestamp;
+        out += number;
+        out += record.message;
+    }
+
+    for (uint8_t i = 0; i < record.fieldCount; ++i) {
+        const Record::Field& field = record.fields[i];
+        if (asJson) {
+            out += ",\"";
+            out += field.key;
+            out += "\":";
+        }
+        else {
+            out += ' ';
+            out += field.key;
+            out += '=';
+        }
+
+        switch (field.type) {
+        case LogField::Type::Signed:
+            std::snprintf(number, sizeof(number), "%" PRId64, field.signedValue);
+            out += number;
+            break;
+        case LogField::Type::Unsigned:
+            std::snprintf(number, sizeof(number), "%" PRIu64, field.unsignedValue);
+            out += number;
+            break;
+        case LogField::Type::Real:
+            std::snprintf(number, sizeof(number), "%.6g", field.realValue);
+            out += number;
+            break;
+        case LogField::Type::Text: {
+            std::string_view text(record.text + field.textOffset, field.textLength);
+            if (asJson) {
+                out += TransferMetrics::quoteJson(std::string(text));
+            }
+            else if (needsQuotes(text)) {
+                out += '"';
+                for (char c : text) {
+                    if (c == '"' || c == '\\') {
+                        out += '\\';
+                    }
+                    out += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+                }
+                out += '"';
+            }
+            else {
+                out += text;
+            }
+            break;
+        }
+        }
+    }
+    out += asJson ? "}\n" : "\n";
+}
@@ -0,0 +1,245 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+#include "Constants.h"
+
+/**
+ * @enum LogLevel
+ * @brief The severity of a log record.
+ */
+enum class LogLevel : int {
+    Debug = 0,  ///< Protocol details: requests, responses, packets.
+    Info = 1,   ///< Progress of the client.
+    Warn = 2,   ///< Recoverable problems.
+    Error = 3,  ///< Failures.
+    Off = 4     ///< Disables logging, not a level of a record.
+};
+
+// Records below this level are compiled out. Release builds (NDEBUG) keep Info and above by default.
+#ifndef CLIENT_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define CLIENT_LOG_MIN_LEVEL 1
+#else
+#define CLIENT_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+/**
+ * @struct LogField
+ * @brief A structured key/value field of a log record.
+ *
+ * A field only refers to its value; the logger copies it into the record. Keys must be string literals.
+ */
+struct LogField {
+    /**
+     * @enum Type
+     * @brief The type of the value.
+     */
+    enum class Type : uint8_t { Signed, Unsigned, Real, Text };
+
+    const char* key;        ///< The field name, a string literal.
+    Type type;              ///< Which member of the value is set.
+    int64_t signedValue;    ///< The value of a Signed field.
+    uint64_t unsignedValue; ///< The value of an Unsigned field.
+    double realValue;       ///< The value of a Real field.
+    std::string_view text;  ///< The value of a Text field; copied when the record is queued.
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
+    LogField(const char* key, T value) : key(key), type(Type::Signed), signedValue(value), unsignedValue(0), realValue(0) {}
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, int>::type = 0>
+    LogField(const char* key, T value) : key(key), type(Type::Unsigned), signedValue(0), unsignedValue(value), realValue(0) {}
+
+    LogField(const char* key, double value) : key(key), type(Type::Real), signedValue(0), unsignedValue(0), realValue(value) {}
+    LogField(const char* key, std::string_view value) : key(key), type(Type::Text), signedValue(0), unsignedValue(0), realValue(0), text(value) {}
+    LogField(const char* key, const std::string& value) : LogField(key, std::string_view(value)) {}
+    LogField(const char* key, const char* value) : LogField(key, std::string_view(value)) {}
+};
+
+/**
+ * @class Logger
+ * @brief An asynchronous leveled logger of structured records.
+ *
+ * Logging threads copy a record (level, time, thread, message and fields) into a bounded lock-free ring
+ * buffer and return; a background thread formats the records and writes them in batches, flushing once
+ * per batch rather than per line. When the ring is full the record is dropped and counted, so logging
+ * never blocks an upload. Records are written as text, or as one JSON object per line.
+ *
+ * Use the Log functions; records below CLIENT_LOG_MIN_LEVEL are removed at compile time and records
+ * below the runtime level are discarded before they are copied.
+ */
+class Logger {
+public:
+    /**
+     * @brief Returns the logger of the process, starting its writer thread on first use.
+     *
+     * @return The process-wide instance.
+     */
+    static Logger& instance();
+
+    /**
+     * @brief Stops the writer thread after it wrote every queued record.
+     */
+    ~Logger();
+
+    /**
+     * @brief Sets the lowest level that is logged and the output format.
+     *
+     * @param level The lowest logged level.
+     * @param json Whether records are written as JSON lines instead of text.
+     */
+    void configure(LogLevel level, bool json);
+
+    /**
+     * @brief Returns whether records of the given level are logged.
+     *
+     * @param level The level.
+     * @return true if the level is at or above the runtime level.
+     */
+    bool isEnabled(LogLevel level) const {
+        return static_cast<int>(level) >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Queues a record for the writer thread.
+     *
+     * @param level The level of the record.
+     * @param message The message, a string literal.
+     * @param fields The structured fields.
+     */
+    void write(LogLevel level, const char* message, std::initializer_list<LogField> fields);
+
+    /**
+     * @brief Waits until every record queued so far was written.
+     */
+    void flush();
+
+    /**
+     * @brief Parses a level name: debug, info, warn, error or off.
+     *
+     * @param name The level name.
+     * @param level Receives the level.
+     * @return true if the name is a level.
+     */
+    static bool parseLevel(const std::string& name, LogLevel& level);
+
+private:
+    /**
+     * @struct Record
+     * @brief A queued log record. Text field values are copied into its own storage, so it never allocates.
+     */
+    struct Record {
+        /**
+         * @struct Field
+         * @brief A copied field; text values refer to the record's text storage.
+         */
+        struct Field {
+            const char* key;
+            LogField::Type type;
+            int64_t signedValue;
+            uint64_t unsignedValue;
+            double realValue;
+            uint16_t textOffset;
+            uint16_t textLength;
+        };
+
+        LogLevel level;
+        uint32_t threadId;
+        int64_t timeUs;     ///< Wall clock time, in microseconds since the Unix epoch.
+        const char* message;
+        uint8_t fieldCount;
+        Field fields[Constants::LOG_MAX_FIELDS];
+        uint16_t textUsed;
+        char text[Constants::LOG_TEXT_CAPACITY];
+    };
+
+    /**
+     * @struct Cell
+     * @brief A slot of the ring; its sequence number tells producers and the consumer whose turn it is.
+     */
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    std::unique_ptr<Cell[]> cells;                      ///< The ring, Constants::LOG_RING_CAPACITY cells.
+    alignas(64) std::atomic<size_t> enqueuePosition;    ///< The next cell a producer claims.
+    alignas(64) size_t dequeuePosition;                 ///< The next cell the writer reads; writer thread only.
+    std::atomic<uint64_t> dropped;                      ///< Records dropped because the ring was full.
+    std::atomic<uint64_t> written;                      ///< Records taken from the ring by the writer.
+    std::atomic<int> minLevel;                          ///< The runtime level.
+    std::atomic<bool> json;                             ///< Whether records are written as JSON lines.
+    std::atomic<bool> stopping;                         ///< Set to end the writer thread.
+    std::mutex wakeMutex;                               ///< Guards the writer's sleep.
+    std::condition_variable wake;                       ///< Wakes the writer early for flush and stop.
+    std::thread writer;                                 ///< Drains the ring.
+
+    Logger();
+
+    // Non-copyable: owns the writer thread
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /**
+     * @brief Writer loop: drains the ring periodically until stopped, then drains it a last time.
+     */
+    void run();
+
+    /**
+     * @brief Writes every record currently in the ring.
+     *
+     * @return The number of records written.
+     */
+    size_t drain();
+
+    /**
+     * @brief Appends a record to the output buffer in the configured format.
+     *
+     * @param record The record.
+     * @param out The output buffer.
+     */
+    void format(const Record& record, std::string& out) const;
+};
+
+/**
+ * @namespace Log
+ * @brief The logging calls. Messages and field keys must be string literals; field values should be cheap
+ * to produce, since they are evaluated even when the record is compiled out.
+ */
+namespace Log {
+
+    /**
+     * @brief Logs a record of a level known at compile time.
+     *
+     * @tparam level The level of the record.
+     * @param message The message, a string literal.
+     * @param fields The structured fields.
+     */
+    template <LogLevel level>
+    inline void write(const char* message, std::initializer_list<LogField> fields) {
+        if constexpr (static_cast<int>(level) >= CLIENT_LOG_MIN_LEVEL) {
+            Logger& logger = Logger::instance();
+            if (logger.isEnabled(level)) {
+                logger.write(level, message, fields);
+            }
+        }
+    }
+
+    inline void debug(const char* message, std::initializer_list<LogField> fields = {}) { write<LogLevel::Debug>(message, fields); }
+    inline void info(const char* message, std::initializer_list<LogField> fields = {}) { write<LogLevel::Info>(message, fields); }
+    inline void warn(const char* message, std::initializer_list<LogField> fields = {}) { write<LogLevel::Warn>(message, fields); }
+    inline void error(const char* message, std::initializer_list<LogField> fields = {}) { write<LogLevel::Error>(message, fields); }
+}
+
+#endif // LOGGER_H
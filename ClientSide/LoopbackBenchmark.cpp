@@ -0,0 +1,379 @@
+#include "LoopbackBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+
+#include "AESWrapper.h"
+#include "BatchUploader.h"
+#include "CRC_Calculator.h"
+#include "Constants.h"
+#include "LoopbackServer.h"
+#include "TransferMetrics.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    /**
+     * @class ScratchDirectory
+     * @brief Makes a new empty directory the working directory, and restores and removes it when destroyed.
+     */
+    class ScratchDirectory {
+    public:
+        ScratchDirectory() : previous(fs::current_path()) {
+            std::random_device random;
+            path = fs::temp_directory_path() / ("client-loopback-" + std::to_string(random()));
+            fs::create_directories(path);
+            fs::current_path(path);
+        }
+
+        ~ScratchDirectory() {
+            std::error_code ec;
+            fs::current_path(previous, ec);
+            fs::remove_all(path, ec);
+        }
+
+    private:
+        fs::path previous;  ///< The working directory before.
+        fs::path path;      ///< The scratch directory.
+    };
+
+    /**
+     * @brief Formats a file size for a case name, as 64B, 16KiB or 4MiB.
+     *
+     * @param bytes The size.
+     * @return The formatted size.
+     */
+    std::string formatSize(size_t bytes) {
+        const char* units[] = { "B", "KiB", "MiB", "GiB" };
+        size_t unit = 0;
+        while (unit < 3 && bytes >= 1024 && bytes % 1024 == 0) {
+            bytes /= 1024;
+            unit++;
+        }
+        return std::to_string(bytes) + units[unit];
+    }
+
+#ifndef _WIN32
+    /**
+     * @class ServerProcess
+     * @brief Runs a LoopbackServer in a child process, and stops it when destroyed.
+     */
+    class ServerProcess {
+    public:
+        ServerProcess() {
+            int portPipe[2];
+            int stopPipe[2];
+            if (pipe(portPipe) != 0) {
+                throw std::runtime_error("Could not create a pipe for the loopback server.");
+            }
+            if (pipe(stopPipe) != 0) {
+                close(portPipe[0]);
+                close(portPipe[1]);
+                throw std::runtime_error("Could not create a pipe for the loopback server.");
+            }
+
+            pid = fork();
+            if (pid == 0) {
+                // Serve until the parent closes its end of the stop pipe; an empty port pipe tells it the server failed
+                close(portPipe[0]);
+                close(stopPipe[1]);
+                int status = 1;
+                try {
+                    LoopbackServer server;
+                    std::string port = server.port() + "\n";
+                    if (write(portPipe[1], port.data(), port.size()) == static_cast<ssize_t>(port.size())) {
+                        char byte;
+                        while (read(stopPipe[0], &byte, 1) > 0) {}
+                        status = 0;
+                    }
+                }
+                catch (...) {}
+                _exit(status);
+            }
+
+            close(portPipe[1]);
+            close(stopPipe[0]);
+            stopFd = stopPipe[1];
+            char buffer[16];
+            ssize_t length = pid > 0 ? read(portPipe[0], buffer, sizeof(buffer)) : -1;
+            close(portPipe[0]);
+            if (length <= 1 || buffer[length - 1] != '\n') {
+                stop();
+                throw std::runtime_error("Could not start the loopback server process.");
+            }
+            serverPort.assign(buffer, length - 1);
+        }
+
+        ~ServerProcess() {
+            stop();
+        }
+
+        /**
+         * @brief Returns the port the server listens on.
+         */
+        const std::string& port() const {
+            return serverPort;
+        }
+
+    private:
+        pid_t pid = -1;         ///< The child process.
+        int stopFd = -1;        ///< The parent's end of the stop pipe.
+        std::string serverPort; ///< The port the server listens on.
+
+        void stop() {
+            if (stopFd >= 0) {
+                close(stopFd);
+                stopFd = -1;
+            }
+            if (pid > 0) {
+                waitpid(pid, nullptr, 0);
+                pid = -1;
+            }
+        }
+    };
+
+    /**
+     * @brief Returns the peak resident set of the process so far.
+     *
+     * @return The peak, in bytes.
+     */
+    size_t peakResidentBytes() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024; // in KiB on Linux
+#endif
+    }
+#endif
+
+    /**
+     * @brief Returns the median of some samples.
+     *
+     * @param samples The samples; sorted in place.
+     * @return The median.
+     */
+    double median(std::vector<double>& samples) {
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+}
+
+/**
+ * @brief Creates the benchmark.
+ *
+ * @param filter Only sizes whose case name contains it are run; empty runs every size.
+ * @param maxBytes The largest file size.
+ * @param authenticate Authenticates every session before its upload.
+ */
+LoopbackBenchmark::LoopbackBenchmark(const std::string& filter, size_t maxBytes, Authenticator authenticate)
+    : filter(filter), maxBytes(maxBytes), authenticate(std::move(authenticate)) {}
+
+/**
+ * @brief Runs the selected sizes, printing each result as it completes.
+ *
+ * @param out Where the result table is printed.
+ * @return The results, in the order they ran.
+ * @throws std::runtime_error if an upload fails or its CRC does not match.
+ */
+std::vector<LoopbackResult> LoopbackBenchmark::run(std::ostream& out) {
+    ScratchDirectory scratch;
+    LoopbackServer server;
+    std::vector<LoopbackResult> results;
+
+    out << std::left << std::setw(24) << "case" << std::right << std::setw(12) << "iterations" << std::setw(12) << "MB/s"
+        << std::setw(16) << "first byte us" << std::setw(16) << "latency us" << std::setw(16) << "max us" << std::endl;
+
+    for (size_t size = Constants::BENCH_MIN_BYTES; size <= maxBytes; size *= Constants::BENCH_SIZE_STEP) {
+        std::string name = "loopback/" + formatSize(size);
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            continue;
+        }
+        size_t encryptedSize = (size / 16 + 1) * 16; // CBC with PKCS#7 padding
+        if ((encryptedSize + Constants::PACKET_CONTENT_SIZE - 1) / Constants::PACKET_CONTENT_SIZE > Constants::MAX_PACKETS) {
+            out << std::left << std::setw(24) << name << "  skipped: more packets than the protocol can number" << std::endl;
+            continue;
+        }
+
+        LoopbackResult result = measure(server, name, size);
+        results.push_back(result);
+        out << std::left << std::setw(24) << name << std::right << std::setw(12) << result.iterations << std::fixed
+            << std::setprecision(1) << std::setw(12) << result.mbPerSecond << std::setw(16) << result.firstByteUs
+            << std::setw(16) << result.latencyUs << std::setw(16) << result.maxLatencyUs << std::endl;
+    }
+    return results;
+}
+
+/**
+ * @brief Streams the largest file the protocol carries and checks that the client's memory stays bounded.
+ *
+ * The file is written to the scratch directory a piece at a time and the session is authenticated before the
+ * peak is first read, so only the upload itself counts.
+ * @param out Where the growth of the peak resident set is printed.
+ * @return true if the growth stayed within the limit, or the filter excludes the case.
+ * @throws std::runtime_error if the server cannot be started or the upload fails.
+ */
+bool LoopbackBenchmark::checkStreamingMemory(std::ostream& out) {
+    // The largest file whose padded encryption still fits the packets the protocol can number
+    const size_t size = static_cast<size_t>(Constants::MAX_PACKETS) * Constants::PACKET_CONTENT_SIZE / 16 * 16 - 1;
+    std::string name = "stream_memory/" + std::to_string(size) + "B";
+    if (!filter.empty() && name.find(filter) == std::string::npos) {
+        return true;
+    }
+#ifdef _WIN32
+    throw std::runtime_error("The streaming memory check requires fork and getrusage, which are not available on Windows.");
+#else
+    ScratchDirectory scratch;
+    ServerProcess server;
+
+    const std::string fileName = "stream-memory.bin";
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        std::mt19937 random(static_cast<unsigned int>(size));
+        std::vector<char> piece(Constants::STREAM_CHUNK_ALIGNMENT);
+        for (size_t written = 0; written < size && file; written += piece.size()) {
+            for (char& byte : piece) {
+                byte = static_cast<char>(random());
+            }
+            file.write(piece.data(), static_cast<std::streamsize>(std::min(piece.size(), size - written)));
+        }
+        if (!file) {
+            throw std::runtime_error("Could not write the file of the streaming memory check.");
+        }
+    }
+
+    ClientSession session("127.0.0.1", server.port());
+    std::string clientId;
+    if (!authenticate(session, clientId)) {
+        throw std::runtime_error("Authentication with the loopback server failed.");
+    }
+    UploadOptions options;
+    options.connections = 1;
+    options.maxBuffer = Constants::BENCH_MEMORY_BUFFER;
+    BatchUploader uploader(session, "127.0.0.1", server.port(), clientId, options);
+
+    size_t before = peakResidentBytes();
+    if (!uploader.upload({ fileName })) {
+        throw std::runtime_error("The streamed upload of " + fileName + " to the loopback server failed.");
+    }
+    size_t growth = peakResidentBytes() - before;
+
+    const size_t limit = Constants::BENCH_MEMORY_BUFFER + Constants::BENCH_MEMORY_OVERHEAD;
+    out << std::left << std::setw(24) << name << "  peak resident set grew by " << growth / 1024 << " KiB, limit "
+        << limit / 1024 << " KiB" << (growth > limit ? ": over the limit" : "") << std::endl;
+    return growth <= limit;
+#endif
+}
+
+/**
+ * @brief Writes results as a JSON array, for comparing runs.
+ *
+ * @param results The results.
+ * @param path The file to write.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void LoopbackBenchmark::writeJson(const std::vector<LoopbackResult>& results, const std::string& path) {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+
+    file << std::fixed << std::setprecision(3) << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const LoopbackResult& result = results[i];
+        file << "  {\"name\":" << TransferMetrics::quoteJson(result.name) << ",\"bytes\":" << result.bytes
+            << ",\"iterations\":" << result.iterations << ",\"mb_per_s\":" << result.mbPerSecond
+            << ",\"first_byte_us\":" << result.firstByteUs << ",\"latency_us\":" << result.latencyUs
+            << ",\"max_latency_us\":" << result.maxLatencyUs << (i + 1 < results.size() ? "},\n" : "}\n");
+    }
+    file << "]\n";
+
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+/**
+ * @brief Uploads a file of one size repeatedly and summarizes the uploads.
+ *
+ * The first upload warms up, and registers the user on the first size; it is not counted. Then uploads
+ * repeat until Constants::BENCH_MIN_TIME_MS passed and at least Constants::BENCH_MIN_ITERATIONS ran.
+ * @param server The server to upload to.
+ * @param name The case name.
+ * @param size The file size.
+ * @return The result of the size.
+ * @throws std::runtime_error if an upload fails or its CRC does not match.
+ */
+LoopbackResult LoopbackBenchmark::measure(LoopbackServer& server, const std::string& name, size_t size) {
+    using Clock = LoopbackServer::Clock;
+
+    std::mt19937 random(static_cast<unsigned int>(size));
+    std::vector<char> content(size);
+    for (char& byte : content) {
+        byte = static_cast<char>(random());
+    }
+    unsigned long crc = CRC_Calculator::memcrc(content.data(), content.size());
+    std::string fileName = "loopback-" + formatSize(size) + ".bin";
+
+    std::vector<double> throughputs;
+    std::vector<double> firstBytes;
+    std::vector<double> latencies;
+    const auto minTime = std::chrono::milliseconds(Constants::BENCH_MIN_TIME_MS);
+    auto measuringStart = Clock::now();
+    for (int iteration = 0; iteration <= Constants::BENCH_MIN_ITERATIONS || Clock::now() - measuringStart < minTime; iteration++) {
+        auto start = Clock::now();
+        ClientSession session("127.0.0.1", server.port());
+        std::string clientId;
+        if (!authenticate(session, clientId)) {
+            throw std::runtime_error("Authentication with the loopback server failed.");
+        }
+        auto authenticated = Clock::now();
+
+        const std::string& aesKey = session.getAESKey();
+        AESWrapper aes(reinterpret_cast<const unsigned char*>(aesKey.data()), static_cast<unsigned int>(aesKey.size()));
+        std::string encrypted = aes.encrypt(content.data(), static_cast<unsigned int>(content.size()));
+        std::vector<char> encryptedFile(encrypted.begin(), encrypted.end());
+
+        auto sendStart = Clock::now();
+        unsigned long serverCrc = session.getServerCRC(fileName, static_cast<int>(size), encryptedFile, clientId);
+        auto end = Clock::now();
+        if (serverCrc != crc) {
+            throw std::runtime_error("The loopback server's CRC of " + fileName + " does not match.");
+        }
+
+        if (iteration == 0) {
+            measuringStart = Clock::now();
+            continue;
+        }
+        // Connecting and authenticating, then sending; the local encryption in between is left out
+        double authUs = std::chrono::duration<double, std::micro>(authenticated - start).count();
+        double sendUs = std::chrono::duration<double, std::micro>(end - sendStart).count();
+        firstBytes.push_back(authUs + std::chrono::duration<double, std::micro>(server.lastFirstPacketTime() - sendStart).count());
+        latencies.push_back(authUs + sendUs);
+        throughputs.push_back(size / sendUs);
+    }
+
+    LoopbackResult result;
+    result.name = name;
+    result.bytes = size;
+    result.iterations = latencies.size();
+    result.maxLatencyUs = *std::max_element(latencies.begin(), latencies.end());
+    result.mbPerSecond = median(throughputs);
+    result.firstByteUs = median(firstBytes);
+    result.latencyUs = median(latencies);
+    return result;
+}
@@ -0,0 +1,105 @@
+#ifndef LOOPBACK_BENCHMARK_H
+#define LOOPBACK_BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ClientSission.h"
+
+class LoopbackServer;
+
+/**
+ * @struct LoopbackResult
+ * @brief The measurements of one file size of the loopback benchmark.
+ */
+struct LoopbackResult {
+    std::string name;           ///< The case name, "loopback/<file size>".
+    size_t bytes;               ///< The file size.
+    uint64_t iterations;        ///< The measured uploads.
+    double mbPerSecond;         ///< Median upload throughput in MB (10^6 bytes) per second, from the first packet to the CRC.
+    double firstByteUs;         ///< Median time from connecting until the server received the first packet, in microseconds.
+    double latencyUs;           ///< Median time from connecting until the server's CRC arrived, in microseconds.
+    double maxLatencyUs;        ///< The longest such time, in microseconds.
+};
+
+/**
+ * @class LoopbackBenchmark
+ * @brief Measures whole uploads of the real ClientSession against an in-process LoopbackServer.
+ *
+ * Every upload connects, authenticates and sends one file, as a one-shot client run does, and is checked
+ * against the CRC of the file. File sizes go from Constants::BENCH_MIN_BYTES up to a maximum in steps of
+ * Constants::BENCH_SIZE_STEP; sizes with more packets than the protocol can number are skipped. Local
+ * encryption is not timed, it is measured by MicroBenchmark.
+ *
+ * The benchmark registers a user of its own, so it runs in a scratch directory to leave the ME and key
+ * files of the working directory alone. For --bench-check it also checks that a streamed upload of the
+ * largest file keeps the client's memory within its buffer.
+ */
+class LoopbackBenchmark {
+public:
+    /**
+     * @brief Authenticates a session as the client does, giving the client ID; false if the server refused.
+     */
+    using Authenticator = std::function<bool(ClientSession&, std::string&)>;
+
+    /**
+     * @brief Creates the benchmark.
+     *
+     * @param filter Only sizes whose case name contains it are run; empty runs every size.
+     * @param maxBytes The largest file size.
+     * @param authenticate Authenticates every session before its upload.
+     */
+    LoopbackBenchmark(const std::string& filter, size_t maxBytes, Authenticator authenticate);
+
+    /**
+     * @brief Runs the selected sizes, printing each result as it completes.
+     *
+     * @param out Where the result table is printed.
+     * @return The results, in the order they ran.
+     * @throws std::runtime_error if an upload fails or its CRC does not match.
+     */
+    std::vector<LoopbackResult> run(std::ostream& out);
+
+    /**
+     * @brief Streams the largest file the protocol carries and checks that the client's memory stays bounded.
+     *
+     * The file is uploaded as BatchUploader streams it, with a buffer of Constants::BENCH_MEMORY_BUFFER, and
+     * the peak resident set of the process may grow by at most that plus Constants::BENCH_MEMORY_OVERHEAD
+     * during the upload. The server runs in a child process, so its copy of the file is not counted. The peak
+     * is a high-water mark of the whole process, so the check runs before anything else that uses memory.
+     * Runs only when the filter selects the case "stream_memory/<file size>".
+     * @param out Where the growth of the peak resident set is printed.
+     * @return true if the growth stayed within the limit, or the filter excludes the case.
+     * @throws std::runtime_error if the server cannot be started or the upload fails.
+     */
+    bool checkStreamingMemory(std::ostream& out);
+
+    /**
+     * @brief Writes results as a JSON array, for comparing runs.
+     *
+     * @param results The results.
+     * @param path The file to write.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    static void writeJson(const std::vector<LoopbackResult>& results, const std::string& path);
+
+private:
+    std::string filter;             ///< The substring selecting sizes.
+    size_t maxBytes;                ///< The largest file size.
+    Authenticator authenticate;     ///< Authenticates the sessions.
+
+    /**
+     * @brief Uploads a file of one size repeatedly and summarizes the uploads.
+     *
+     * @param server The server to upload to.
+     * @param name The case name.
+     * @param size The file size.
+     * @return The result of the size.
+     */
+    LoopbackResult measure(LoopbackServer& server, const std::string& name, size_t size);
+};
+
+#endif // LOOPBACK_BENCHMARK_H
@@ -0,0 +1,347 @@
+#include "LoopbackServer.h"
+
+#include <algorithm>
+#include <random>
+
+#include "AESWrapper.h"
+#include "CRC_Calculator.h"
+#include "Constants.h"
+#include "RequestHeader.h"
+#include "ResponseHeader.h"
+#include "RSAWrapper.h"
+
+namespace {
+
+    /**
+     * @brief Reads a little-endian number from a buffer.
+     *
+     * @param bytes The buffer.
+     * @param offset Where the number starts.
+     * @param size The size of the number in bytes.
+     * @return The number.
+     */
+    uint32_t readNumber(const std::vector<char>& bytes, size_t offset, size_t size) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < size; i++) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes.at(offset + i))) << (8 * i);
+        }
+        return value;
+    }
+
+    /**
+     * @brief Reads a null-padded string of a fixed size field.
+     *
+     * @param bytes The buffer.
+     * @param offset Where the field starts.
+     * @param size The size of the field.
+     * @return The string, up to the first null byte.
+     */
+    std::string readString(const std::vector<char>& bytes, size_t offset, size_t size) {
+        std::string value(bytes.begin() + offset, bytes.begin() + std::min(bytes.size(), offset + size));
+        return value.substr(0, value.find('\0'));
+    }
+
+    /**
+     * @brief Appends a little-endian number to a buffer.
+     *
+     * @param bytes The buffer.
+     * @param value The number.
+     * @param size The size of the number in bytes.
+     */
+    void appendNumber(std::string& bytes, uint32_t value, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            bytes += static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+}
+
+/**
+ * @brief Starts listening on an ephemeral loopback port.
+ *
+ * @throws boost::system::system_error if the port cannot be opened.
+ */
+LoopbackServer::LoopbackServer() : acceptor(io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)) {
+    listenPort = std::to_string(acceptor.local_endpoint().port());
+    acceptNext();
+    ioThread = std::thread([this] { io.run(); });
+}
+
+/**
+ * @brief Stops the server, closing the connections still open.
+ */
+LoopbackServer::~LoopbackServer() {
+    stopping = true;
+    boost::asio::post(io, [this] {
+        boost::system::error_code ec;
+        acceptor.close(ec);
+    });
+    ioThread.join();
+
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (auto& connection : connections) {
+        boost::system::error_code ec;
+        connection.socket->shutdown(tcp::socket::shutdown_both, ec);
+    }
+    for (auto& connection : connections) {
+        connection.thread.join();
+    }
+}
+
+/**
+ * @brief Returns the port the server listens on.
+ *
+ * @return The port, as ClientSession takes it.
+ */
+std::string LoopbackServer::port() const {
+    return listenPort;
+}
+
+/**
+ * @brief Returns when the first packet of the latest file upload arrived.
+ *
+ * @return The arrival time of the packet.
+ */
+LoopbackServer::Clock::time_point LoopbackServer::lastFirstPacketTime() const {
+    return Clock::time_point(Clock::duration(firstPacketTime.load()));
+}
+
+/**
+ * @brief Waits for the next connection, asynchronously.
+ *
+ * Joins the threads of connections that ended, so a long benchmark does not accumulate them.
+ */
+void LoopbackServer::acceptNext() {
+    auto socket = std::make_shared<tcp::socket>(io);
+    acceptor.async_accept(*socket, [this, socket](const boost::system::error_code& ec) {
+        if (ec) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto it = connections.begin(); it != connections.end(); ) {
+            if (it->done) {
+                it->thread.join();
+                it = connections.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        if (stopping) {
+            return;
+        }
+
+        connections.emplace_back();
+        Connection& connection = connections.back();
+        connection.socket = socket;
+        connection.thread = std::thread(&LoopbackServer::serve, this, std::ref(connection));
+        acceptNext();
+    });
+}
+
+/**
+ * @brief Serves requests on a connection until the client closes it.
+ *
+ * @param connection The connection.
+ */
+void LoopbackServer::serve(Connection& connection) {
+    tcp::socket& socket = *connection.socket;
+    std::map<std::string, std::string> files;
+    try {
+        for (;;) {
+            std::vector<char> header(Constants::REQUEST_HEADER_SIZE);
+            boost::system::error_code ec;
+            boost::asio::read(socket, boost::asio::buffer(header), ec);
+            if (ec) {
+                break; // the client closed the connection
+            }
+            std::string clientId(header.begin(), header.begin() + Constants::CLIENT_ID_SIZE);
+            int code = readNumber(header, Constants::CLIENT_ID_SIZE + Constants::VERSION_SIZE, Constants::CODE_SIZE);
+            size_t payloadSize = readNumber(header, Constants::CLIENT_ID_SIZE + Constants::VERSION_SIZE + Constants::CODE_SIZE,
+                Constants::PAYLOAD_SIZE_SIZE);
+
+            std::vector<char> payload(payloadSize);
+            boost::asio::read(socket, boost::asio::buffer(payload));
+
+            switch (code) {
+            case RequestHeader::Code::RegistrationCode:
+                handleRegistration(socket, payload);
+                break;
+            case RequestHeader::Code::PublicKeyCode:
+            case RequestHeader::Code::ReconnectingCode:
+                handleKeyRequest(socket, code, clientId, payload);
+                break;
+            case RequestHeader::Code::SendFileCode:
+                handleFilePacket(socket, clientId, payload, files);
+                break;
+            case RequestHeader::Code::ValidCRC:
+            case RequestHeader::Code::NotValidCRC4th:
+                respond(socket, ResponseHeader::Code::MessageReceived, clientId);
+                break;
+            case RequestHeader::Code::NotValidCRC:
+                break; // the client sends the file again
+            default:
+                respond(socket, ResponseHeader::Code::GeneralError);
+            }
+        }
+    }
+    catch (const std::exception&) {
+        // The client went away in the middle of a request
+    }
+    connection.done = true;
+}
+
+/**
+ * @brief Answers a registration request.
+ *
+ * A user name that is already registered is refused, as the Python server does.
+ * @param socket The connection.
+ * @param payload The request payload.
+ */
+void LoopbackServer::handleRegistration(tcp::socket& socket, const std::vector<char>& payload) {
+    std::string userName = readString(payload, 0, Constants::USERNAME_SIZE);
+    std::string clientId;
+    {
+        std::lock_guard<std::mutex> lock(usersMutex);
+        if (users.count(userName) == 0) {
+            thread_local std::mt19937_64 random(std::random_device{}());
+            for (int i = 0; i < Constants::CLIENT_ID_SIZE; i++) {
+                clientId += static_cast<char>(random() & 0xFF);
+            }
+            users[userName].clientId = clientId;
+            userNames[clientId] = userName;
+        }
+    }
+
+    if (clientId.empty()) {
+        respond(socket, ResponseHeader::Code::RegistrationFailure);
+    }
+    else {
+        respond(socket, ResponseHeader::Code::RegistrationSuccess, clientId);
+    }
+}
+
+/**
+ * @brief Answers a public key submission, or a reconnection request, with a new AES key.
+ *
+ * The key is encrypted with the user's public key; a submission stores the key first.
+ * @param socket The connection.
+ * @param code The request code.
+ * @param clientId The client ID of the request header.
+ * @param payload The request payload.
+ */
+void LoopbackServer::handleKeyRequest(tcp::socket& socket, int code, const std::string& clientId, const std::vector<char>& payload) {
+    std::string userName = readString(payload, 0, Constants::USERNAME_SIZE);
+    unsigned char aesKey[AESWrapper::DEFAULT_KEYLENGTH];
+    AESWrapper::GenerateKey(aesKey, AESWrapper::DEFAULT_KEYLENGTH);
+
+    std::string publicKey;
+    std::string userId;
+    {
+        std::lock_guard<std::mutex> lock(usersMutex);
+        auto user = users.find(userName);
+        if (user != users.end()) {
+            if (code == RequestHeader::Code::PublicKeyCode) {
+                user->second.publicKey.assign(payload.begin() + Constants::USERNAME_SIZE, payload.end());
+            }
+            user->second.aesKey.assign(reinterpret_cast<char*>(aesKey), AESWrapper::DEFAULT_KEYLENGTH);
+            publicKey = user->second.publicKey;
+            userId = user->second.clientId;
+        }
+    }
+
+    if (publicKey.empty()) {
+        if (code == RequestHeader::Code::ReconnectingCode) {
+            respond(socket, ResponseHeader::Code::ReconnectionFailure, clientId);
+        }
+        else {
+            respond(socket, ResponseHeader::Code::GeneralError);
+        }
+        return;
+    }
+
+    RSAPublicWrapper rsa(publicKey);
+    std::string encryptedKey = rsa.encrypt(reinterpret_cast<char*>(aesKey), AESWrapper::DEFAULT_KEYLENGTH);
+    respond(socket, code == RequestHeader::Code::PublicKeyCode ? ResponseHeader::Code::PublicKeyReceived : ResponseHeader::Code::ReconnectionSuccess,
+        userId + encryptedKey);
+}
+
+/**
+ * @brief Collects a file packet, and answers the last packet of a file with the CRC of the decrypted file.
+ *
+ * @param socket The connection.
+ * @param clientId The client ID of the request header.
+ * @param payload The request payload.
+ * @param files The encrypted content received so far on the connection, by file name.
+ */
+void LoopbackServer::handleFilePacket(tcp::socket& socket, const std::string& clientId, const std::vector<char>& payload,
+    std::map<std::string, std::string>& files) {
+    const size_t packetNumberOffset = Constants::CONTENT_SIZE_SIZE + Constants::ORIG_FILE_SIZE_SIZE;
+    const size_t totalPacketsOffset = packetNumberOffset + Constants::PACKET_NUMBER_SIZE;
+    const size_t fileNameOffset = totalPacketsOffset + Constants::TOTAL_PACKET_SIZE;
+    const size_t contentOffset = fileNameOffset + Constants::FILE_NAME_SIZE;
+
+    uint32_t packetNumber = readNumber(payload, packetNumberOffset, Constants::PACKET_NUMBER_SIZE);
+    uint32_t totalPackets = readNumber(payload, totalPacketsOffset, Constants::TOTAL_PACKET_SIZE);
+    std::string fileName = readString(payload, fileNameOffset, Constants::FILE_NAME_SIZE);
+    if (packetNumber == 1) {
+        firstPacketTime = Clock::now().time_since_epoch().count();
+        files[fileName].clear();
+    }
+    std::string& content = files[fileName];
+    content.append(payload.begin() + contentOffset, payload.end());
+    if (packetNumber != totalPackets) {
+        return;
+    }
+
+    std::string aesKey;
+    {
+        std::lock_guard<std::mutex> lock(usersMutex);
+        auto userName = userNames.find(clientId);
+        if (userName != userNames.end()) {
+            aesKey = users[userName->second].aesKey;
+        }
+    }
+    if (aesKey.empty()) {
+        files.erase(fileName);
+        respond(socket, ResponseHeader::Code::GeneralError);
+        return;
+    }
+
+    unsigned long crc;
+    try {
+        AESWrapper aes(reinterpret_cast<const unsigned char*>(aesKey.data()), AESWrapper::DEFAULT_KEYLENGTH);
+        std::string plain = aes.decrypt(content.data(), static_cast<unsigned int>(content.size()));
+        crc = CRC_Calculator::memcrc(plain.data(), plain.size());
+    }
+    catch (const std::exception&) {
+        files.erase(fileName);
+        respond(socket, ResponseHeader::Code::GeneralError);
+        return;
+    }
+
+    std::string response = clientId;
+    appendNumber(response, static_cast<uint32_t>(content.size()), Constants::CONTENT_SIZE_SIZE);
+    std::string paddedName = fileName.substr(0, Constants::FILE_NAME_SIZE);
+    paddedName.resize(Constants::FILE_NAME_SIZE, '\0');
+    response += paddedName;
+    appendNumber(response, static_cast<uint32_t>(crc), Constants::CKSUM_SIZE);
+    files.erase(fileName);
+    respond(socket, ResponseHeader::Code::FileReceived, response);
+}
+
+/**
+ * @brief Writes a response.
+ *
+ * @param socket The connection.
+ * @param code The response code.
+ * @param payload The response payload.
+ */
+void LoopbackServer::respond(tcp::socket& socket, int code, const std::string& payload) {
+    std::string response;
+    appendNumber(response, Constants::VERSION, Constants::VERSION_SIZE);
+    appendNumber(response, code, Constants::CODE_SIZE);
+    appendNumber(response, static_cast<uint32_t>(payload.size()), Constants::PAYLOAD_SIZE_SIZE);
+    response += payload;
+    boost::asio::write(socket, boost::asio::buffer(response));
+}
@@ -0,0 +1,144 @@
+#ifndef LOOPBACK_SERVER_H
+#define LOOPBACK_SERVER_H
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @class LoopbackServer
+ * @brief An in-process stand-in for the server, listening on the loopback interface.
+ *
+ * Speaks the same protocol as the Python server: registration, public key submission, reconnection, file
+ * upload in packets answered with the CRC of the decrypted file, and CRC confirmation. It keeps users and
+ * files in memory and prints nothing, so that benchmarks measure the client and the wire rather than the
+ * server's disk and console. Every connection is served on its own thread, like the Python server does.
+ */
+class LoopbackServer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Starts listening on an ephemeral loopback port.
+     *
+     * @throws boost::system::system_error if the port cannot be opened.
+     */
+    LoopbackServer();
+
+    /**
+     * @brief Stops the server, closing the connections still open.
+     */
+    ~LoopbackServer();
+
+    /**
+     * @brief Returns the port the server listens on.
+     *
+     * @return The port, as ClientSession takes it.
+     */
+    std::string port() const;
+
+    /**
+     * @brief Returns when the first packet of the latest file upload arrived.
+     *
+     * @return The arrival time of the packet.
+     */
+    Clock::time_point lastFirstPacketTime() const;
+
+private:
+    using tcp = boost::asio::ip::tcp;
+
+    /**
+     * @struct User
+     * @brief A registered user.
+     */
+    struct User {
+        std::string clientId;   ///< The client ID, 16 raw bytes.
+        std::string publicKey;  ///< The RSA public key, once submitted.
+        std::string aesKey;     ///< The AES key sent to the user most recently.
+    };
+
+    /**
+     * @struct Connection
+     * @brief A client connection, served on its own thread.
+     */
+    struct Connection {
+        std::shared_ptr<tcp::socket> socket;    ///< The connection.
+        std::thread thread;                     ///< The thread serving it.
+        std::atomic<bool> done{ false };        ///< Set when the thread is about to end.
+    };
+
+    boost::asio::io_context io;                             ///< Runs the acceptor.
+    tcp::acceptor acceptor;                                 ///< Accepts the client connections.
+    std::string listenPort;                                 ///< The port of the acceptor.
+    std::thread ioThread;                                   ///< Runs io.
+    std::list<Connection> connections;                      ///< The connections not yet joined.
+    std::mutex connectionsMutex;                            ///< Guards connections.
+    std::atomic<bool> stopping{ false };                    ///< Set once the server stops.
+    std::map<std::string, User> users;                      ///< The registered users, by user name.
+    std::map<std::string, std::string> userNames;           ///< The user names, by client ID.
+    std::mutex usersMutex;                                  ///< Guards users and userNames.
+    std::atomic<Clock::rep> firstPacketTime{ 0 };           ///< See lastFirstPacketTime().
+
+    // Non-copyable: owns threads that refer to it
+    LoopbackServer(const LoopbackServer&) = delete;
+    LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+    /**
+     * @brief Waits for the next connection, asynchronously.
+     */
+    void acceptNext();
+
+    /**
+     * @brief Serves requests on a connection until the client closes it.
+     *
+     * @param connection The connection.
+     */
+    void serve(Connection& connection);
+
+    /**
+     * @brief Answers a registration request.
+     *
+     * @param socket The connection.
+     * @param payload The request payload.
+     */
+    void handleRegistration(tcp::socket& socket, const std::vector<char>& payload);
+
+    /**
+     * @brief Answers a public key submission, or a reconnection request, with a new AES key.
+     *
+     * @param socket The connection.
+     * @param code The request code.
+     * @param clientId The client ID of the request header.
+     * @param payload The request payload.
+     */
+    void handleKeyRequest(tcp::socket& socket, int code, const std::string& clientId, const std::vector<char>& payload);
+
+    /**
+     * @brief Collects a file packet, and answers the last packet of a file with the CRC of the decrypted file.
+     *
+     * @param socket The connection.
+     * @param clientId The client ID of the request header.
+     * @param payload The request payload.
+     * @param files The encrypted content received so far on the connection, by file name.
+     */
+    void handleFilePacket(tcp::socket& socket, const std::string& clientId, const std::vector<char>& payload,
+        std::map<std::string, std::string>& files);
+
+    /**
+     * @brief Writes a response.
+     *
+     * @param socket The connection.
+     * @param code The response code.
+     * @param payload The response payload.
+     */
+    static void respond(tcp::socket& socket, int code, const std::string& payload = "");
+};
+
+#endif // LOOPBACK_SERVER_H
@@ -0,0 +1,458 @@
+#include "MicroBenchmark.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <stdexcept>
+
+#include "AESWrapper.h"
+#include "AllocationCounter.h"
+#include "Base64Wrapper.h"
+#include "CRC_Calculator.h"
+#include "ClientSission.h"
+#include "Constants.h"
+#include "FilePacketEncoder.h"
+#include "FramePool.h"
+#include "RSAWrapper.h"
+#include "Request.h"
+#include "ResponseHeader.h"
+#include "ResponsePayload.h"
+#include "TransferMetrics.h"
+
+namespace {
+
+    /// Keeps the results of measured operations, so the compiler cannot drop the work.
+    volatile size_t sink = 0;
+
+    /// The most heap allocations per operation of the protocol cases. The packet path must not allocate; the
+    /// request classes are held at their current counts, so that another copy, such as a request built by value,
+    /// fails the check.
+    const std::map<std::string, double> ALLOCATION_BUDGETS = {
+        { "request_header/to_bytes", 6 },
+        { "request_payload/to_bytes", 12 },
+        { "request/packet", 31 },
+        { "request/packet_frame", 0 },
+        { "response_header/parse", 0 },
+        { "response_payload/parse", 9 },
+        { "send/per_packet", 0 },
+    };
+
+    /// The packets of the two files of the send loop cases.
+    constexpr int SEND_SMALL_PACKETS = 16;
+    constexpr int SEND_LARGE_PACKETS = 256;
+
+    /**
+     * @class DiscardTransport
+     * @brief A connection that drops every request and answers every read from a canned response.
+     */
+    class DiscardTransport : public Transport {
+    public:
+        /**
+         * @brief Creates the connection.
+         *
+         * @param response The bytes every response repeats.
+         */
+        explicit DiscardTransport(std::vector<char> response) : response(std::move(response)) {}
+
+        size_t readSome(char* data, size_t size) override {
+            size_t length = std::min(size, response.size() - offset);
+            std::memcpy(data, response.data() + offset, length);
+            offset = (offset + length) % response.size();
+            return length;
+        }
+
+        size_t writeSome(const char*, size_t size) override {
+            return size;
+        }
+
+        void close() override {}
+
+    private:
+        std::vector<char> response;     ///< The canned response.
+        size_t offset = 0;              ///< Where the next read starts in it.
+    };
+
+    /**
+     * @brief Formats a buffer size for a case name, as 64B, 16KiB, 4MiB or 1GiB.
+     *
+     * @param bytes The size.
+     * @return The formatted size.
+     */
+    std::string formatSize(size_t bytes) {
+        const char* units[] = { "B", "KiB", "MiB", "GiB" };
+        size_t unit = 0;
+        while (unit < 3 && bytes >= 1024 && bytes % 1024 == 0) {
+            bytes /= 1024;
+            unit++;
+        }
+        return std::to_string(bytes) + units[unit];
+    }
+
+    /**
+     * @brief Returns a buffer of pseudo-random bytes, the same on every run.
+     *
+     * @param size The buffer size.
+     * @return The buffer.
+     */
+    std::string randomBytes(size_t size) {
+        std::mt19937_64 random(size);
+        std::string bytes(size, '\0');
+        for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+            uint64_t value = random();
+            for (size_t j = 0; j < sizeof(uint64_t) && i + j < size; j++) {
+                bytes[i + j] = static_cast<char>(value >> (8 * j));
+            }
+        }
+        return bytes;
+    }
+}
+
+/**
+ * @brief Creates the suite.
+ *
+ * @param filter Only cases whose name contains it are run; empty runs every case.
+ * @param maxBytes The largest buffer size.
+ */
+MicroBenchmark::MicroBenchmark(const std::string& filter, size_t maxBytes) : filter(filter), maxBytes(maxBytes) {}
+
+/**
+ * @brief Runs the selected cases, printing each result as it completes.
+ *
+ * @param out Where the result table is printed.
+ * @return The results, in the order they ran.
+ */
+std::vector<BenchmarkResult> MicroBenchmark::run(std::ostream& out) {
+    this->out = &out;
+    results.clear();
+
+    out << std::left << std::setw(36) << "case" << std::right << std::setw(12) << "iterations" << std::setw(16) << "ns/op"
+        << std::setw(12) << "MB/s" << std::setw(12) << "allocs/op" << std::endl;
+
+    benchmarkCrc();
+    benchmarkAes();
+    benchmarkBase64();
+    benchmarkRsa();
+    benchmarkSerialization();
+    benchmarkSendLoop();
+    return results;
+}
+
+/**
+ * @brief Writes results as a JSON array, for comparing runs.
+ *
+ * @param results The results.
+ * @param path The file to write.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void MicroBenchmark::writeJson(const std::vector<BenchmarkResult>& results, const std::string& path) {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+
+    file << std::fixed << std::setprecision(3) << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        file << "  {\"name\":" << TransferMetrics::quoteJson(result.name) << ",\"bytes\":" << result.bytes
+            << ",\"iterations\":" << result.iterations << ",\"ns_per_op\":" << result.nsPerOp
+            << ",\"mb_per_s\":" << result.mbPerSecond << ",\"allocs_per_op\":" << result.allocationsPerOp
+            << (i + 1 < results.size() ? "},\n" : "}\n");
+    }
+    file << "]\n";
+
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+/**
+ * @brief Reports every case that allocated more than its budget.
+ *
+ * @param results The results.
+ * @param out Where the cases over budget are reported, with the sizes of their first allocations.
+ * @return true if every case with a budget stayed within it.
+ */
+bool MicroBenchmark::checkBudgets(const std::vector<BenchmarkResult>& results, std::ostream& out) {
+    bool withinBudgets = true;
+    for (const BenchmarkResult& result : results) {
+        if (result.allocationBudget < 0 || result.allocationsPerOp <= result.allocationBudget) {
+            continue;
+        }
+        withinBudgets = false;
+        out << result.name << ": " << std::fixed << std::setprecision(2) << result.allocationsPerOp
+            << " allocations per operation, over the budget of " << result.allocationBudget;
+        if (!result.allocationSizes.empty()) {
+            out << "; first allocation sizes:";
+            for (size_t size : result.allocationSizes) {
+                out << " " << size;
+            }
+        }
+        out << std::endl;
+    }
+    return withinBudgets;
+}
+
+/**
+ * @brief Returns the buffer sizes of the buffer-sized cases.
+ *
+ * @return The sizes, smallest first.
+ */
+std::vector<size_t> MicroBenchmark::sizes() const {
+    std::vector<size_t> sizes;
+    for (size_t size = Constants::BENCH_MIN_BYTES; size <= maxBytes; size *= Constants::BENCH_SIZE_STEP) {
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+/**
+ * @brief Measures one case, unless the filter excludes it.
+ *
+ * The allocations are counted on the calling thread, so operations that allocate on other threads are
+ * undercounted. The sizes of the first allocations are sampled, to tell which copies a case makes.
+ * @param name The case name.
+ * @param bytes The bytes processed per operation, or 0.
+ * @param operation The operation; its return value is kept so the work is not optimized away.
+ */
+void MicroBenchmark::measure(const std::string& name, size_t bytes, const std::function<size_t()>& operation) {
+    using Clock = std::chrono::steady_clock;
+    if (!selected(name)) {
+        return;
+    }
+
+    sink = sink + operation(); // warm-up
+
+    const auto minTime = std::chrono::milliseconds(Constants::BENCH_MIN_TIME_MS);
+    uint64_t iterations = 0;
+    AllocationScope allocations(1);
+    auto start = Clock::now();
+    Clock::duration elapsed{};
+    for (uint64_t batch = 1; elapsed < minTime; batch *= 2) {
+        for (uint64_t i = 0; i < batch; i++) {
+            sink = sink + operation();
+        }
+        iterations += batch;
+        elapsed = Clock::now() - start;
+    }
+    uint64_t allocationCount = allocations.allocations(); // before the result allocates
+
+    BenchmarkResult result;
+    result.name = name;
+    result.bytes = bytes;
+    result.iterations = iterations;
+    result.nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    result.mbPerSecond = bytes == 0 ? 0 : bytes * 1e3 / result.nsPerOp;
+    result.allocationsPerOp = static_cast<double>(allocationCount) / iterations;
+    result.allocationSizes.assign(allocations.samples(), allocations.samples() + allocations.sampleCount());
+    report(result);
+}
+
+/**
+ * @brief Keeps a result and prints it as a row of the table.
+ *
+ * @param result The result; its allocation budget is looked up by name.
+ */
+void MicroBenchmark::report(BenchmarkResult result) {
+    auto budget = ALLOCATION_BUDGETS.find(result.name);
+    if (budget != ALLOCATION_BUDGETS.end()) {
+        result.allocationBudget = budget->second;
+    }
+    *out << std::left << std::setw(36) << result.name << std::right << std::setw(12) << result.iterations << std::fixed
+        << std::setprecision(1) << std::setw(16) << result.nsPerOp << std::setw(12) << result.mbPerSecond
+        << std::setprecision(2) << std::setw(12) << result.allocationsPerOp << std::endl;
+    results.push_back(std::move(result));
+}
+
+/**
+ * @brief Returns whether the filter selects a case.
+ *
+ * @param name The case name.
+ * @return true if the case runs.
+ */
+bool MicroBenchmark::selected(const std::string& name) const {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+/**
+ * @brief Measures CRC_Calculator::memcrc for every buffer size.
+ */
+void MicroBenchmark::benchmarkCrc() {
+    for (size_t size : sizes()) {
+        std::string name = "crc/memcrc/" + formatSize(size);
+        if (!selected(name)) {
+            continue;
+        }
+        std::string data = randomBytes(size);
+        measure(name, size, [&data] { return static_cast<size_t>(CRC_Calculator::memcrc(data.data(), data.size())); });
+    }
+}
+
+/**
+ * @brief Measures AESWrapper::encrypt and decrypt for every buffer size.
+ */
+void MicroBenchmark::benchmarkAes() {
+    std::string key = randomBytes(AESWrapper::DEFAULT_KEYLENGTH);
+    AESWrapper aes(reinterpret_cast<const unsigned char*>(key.data()), AESWrapper::DEFAULT_KEYLENGTH);
+
+    for (size_t size : sizes()) {
+        std::string encryptName = "aes/encrypt/" + formatSize(size);
+        std::string decryptName = "aes/decrypt/" + formatSize(size);
+        if (!selected(encryptName) && !selected(decryptName)) {
+            continue;
+        }
+        std::string plain = randomBytes(size);
+        measure(encryptName, size, [&] { return aes.encrypt(plain.data(), static_cast<unsigned int>(plain.size())).size(); });
+
+        if (selected(decryptName)) {
+            std::string cipher = aes.encrypt(plain.data(), static_cast<unsigned int>(plain.size()));
+            measure(decryptName, size, [&] { return aes.decrypt(cipher.data(), static_cast<unsigned int>(cipher.size())).size(); });
+        }
+    }
+}
+
+/**
+ * @brief Measures Base64Wrapper::encode and decode for every buffer size.
+ */
+void MicroBenchmark::benchmarkBase64() {
+    for (size_t size : sizes()) {
+        std::string encodeName = "base64/encode/" + formatSize(size);
+        std::string decodeName = "base64/decode/" + formatSize(size);
+        if (!selected(encodeName) && !selected(decodeName)) {
+            continue;
+        }
+        std::string plain = randomBytes(size);
+        measure(encodeName, size, [&plain] { return Base64Wrapper::encode(plain).size(); });
+
+        if (selected(decodeName)) {
+            std::string encoded = Base64Wrapper::encode(plain);
+            measure(decodeName, size, [&encoded] { return Base64Wrapper::decode(encoded).size(); });
+        }
+    }
+}
+
+/**
+ * @brief Measures RSA key generation, and the decryption of an AES key as received from the server.
+ */
+void MicroBenchmark::benchmarkRsa() {
+    measure("rsa/keygen", 0, [] { return RSAPrivateWrapper().getPublicKey().size(); });
+
+    if (selected("rsa/decrypt")) {
+        RSAPrivateWrapper privateKey;
+        RSAPublicWrapper publicKey(privateKey.getPublicKey());
+        std::string cipher = publicKey.encrypt(randomBytes(AESWrapper::DEFAULT_KEYLENGTH));
+        measure("rsa/decrypt", AESWrapper::DEFAULT_KEYLENGTH, [&] { return privateKey.decrypt(cipher).size(); });
+    }
+}
+
+/**
+ * @brief Measures the protocol classes on full-size packets: building and serializing a file packet with the
+ * request classes and encoding one into a pooled frame as the send loop does, and parsing the response to a file.
+ */
+void MicroBenchmark::benchmarkSerialization() {
+    const std::string clientId(2 * Constants::CLIENT_ID_SIZE, 'a');
+    const int contentSize = Constants::PACKET_CONTENT_SIZE;
+    std::string content = randomBytes(contentSize);
+    std::vector<char> contentVec(content.begin(), content.end());
+
+    RequestPayload payload;
+    payload.setContentSize(contentSize);
+    payload.setOrigFileSize(contentSize);
+    payload.setPacketNumber(1);
+    payload.setTotalPackets(1);
+    payload.setFileName("benchmark.bin");
+    payload.setContent(contentVec);
+    RequestHeader header(clientId, Constants::VERSION, RequestHeader::Code::SendFileCode, payload.size());
+
+    measure("request_header/to_bytes", Constants::REQUEST_HEADER_SIZE, [&header] { return header.toBytes().size(); });
+    measure("request_payload/to_bytes", payload.size(), [&payload] { return payload.toBytes(RequestHeader::Code::SendFileCode).size(); });
+    measure("request/packet", Constants::PACKET_SIZE, [&] {
+        RequestPayload packet;
+        packet.setContentSize(contentSize);
+        packet.setOrigFileSize(contentSize);
+        packet.setPacketNumber(1);
+        packet.setTotalPackets(1);
+        packet.setFileName("benchmark.bin");
+        packet.setContent(contentVec);
+        RequestHeader packetHeader(clientId, Constants::VERSION, RequestHeader::Code::SendFileCode, packet.size());
+        Request request(packetHeader, packet);
+        return request.toBytes().size();
+    });
+    if (selected("request/packet_frame")) {
+        FramePool pool(Constants::PACKET_SIZE, 1, Constants::FRAME_ALIGNMENT);
+        FilePacketEncoder encoder(clientId, "benchmark.bin", contentSize, contentSize, 1);
+        measure("request/packet_frame", Constants::PACKET_SIZE, [&] {
+            char* frame = pool.acquire();
+            size_t length = encoder.encode(frame, content.data(), content.size());
+            pool.release(frame);
+            return length;
+        });
+    }
+
+    std::vector<char> rawHeader = { static_cast<char>(Constants::VERSION), static_cast<char>(ResponseHeader::Code::FileReceived & 0xFF),
+        static_cast<char>(ResponseHeader::Code::FileReceived >> 8), 0, 0, 0, 0 };
+    measure("response_header/parse", rawHeader.size(), [&rawHeader] { return static_cast<size_t>(ResponseHeader(rawHeader).getPayloadSize()); });
+
+    std::vector<char> rawPayload(Constants::CLIENT_ID_SIZE + Constants::CONTENT_SIZE_SIZE + Constants::FILE_NAME_SIZE + Constants::CKSUM_SIZE, '\0');
+    std::snprintf(rawPayload.data() + Constants::CLIENT_ID_SIZE + Constants::CONTENT_SIZE_SIZE, Constants::FILE_NAME_SIZE, "benchmark.bin");
+    measure("response_payload/parse", rawPayload.size(), [&rawPayload] {
+        ResponsePayload response(ResponseHeader::Code::FileReceived, rawPayload);
+        return static_cast<size_t>(std::get<unsigned long>(response.getField("cksum")));
+    });
+}
+
+/**
+ * @brief Measures ClientSession::getServerCRC on files of two sizes over a transport that discards the
+ * requests, and derives the cost of one more packet from the difference.
+ *
+ * The difference cancels what every file costs, such as parsing the response, so send/per_packet is what the
+ * packet loop itself costs: it must not allocate. It is derived only when both sizes are selected.
+ */
+void MicroBenchmark::benchmarkSendLoop() {
+    const std::string smallName = "send/file/" + std::to_string(SEND_SMALL_PACKETS) + "_packets";
+    const std::string largeName = "send/file/" + std::to_string(SEND_LARGE_PACKETS) + "_packets";
+    if (!selected(smallName) && !selected(largeName)) {
+        return;
+    }
+
+    std::vector<char> response(Constants::HEADER_RESPONSE_SIZE + Constants::CLIENT_ID_SIZE + Constants::CONTENT_SIZE_SIZE
+        + Constants::FILE_NAME_SIZE + Constants::CKSUM_SIZE, '\0');
+    int payloadSize = static_cast<int>(response.size()) - Constants::HEADER_RESPONSE_SIZE;
+    response[0] = static_cast<char>(Constants::VERSION);
+    response[1] = static_cast<char>(ResponseHeader::Code::FileReceived & 0xFF);
+    response[2] = static_cast<char>(ResponseHeader::Code::FileReceived >> 8);
+    response[3] = static_cast<char>(payloadSize & 0xFF);
+    response[4] = static_cast<char>(payloadSize >> 8);
+    ClientSession session(std::make_unique<DiscardTransport>(response));
+    const std::string clientId(2 * Constants::CLIENT_ID_SIZE, 'a');
+
+    std::string smallContent = randomBytes(SEND_SMALL_PACKETS * Constants::PACKET_CONTENT_SIZE);
+    std::string largeContent = randomBytes(SEND_LARGE_PACKETS * Constants::PACKET_CONTENT_SIZE);
+    std::vector<char> small(smallContent.begin(), smallContent.end());
+    std::vector<char> large(largeContent.begin(), largeContent.end());
+    auto send = [&](const std::vector<char>& file) {
+        return static_cast<size_t>(session.getServerCRC("benchmark.bin", static_cast<int>(file.size()), file, clientId));
+    };
+
+    measure(smallName, SEND_SMALL_PACKETS * Constants::PACKET_SIZE, [&] { return send(small); });
+    measure(largeName, SEND_LARGE_PACKETS * Constants::PACKET_SIZE, [&] { return send(large); });
+    if (results.size() < 2 || results[results.size() - 2].name != smallName || results.back().name != largeName) {
+        return; // the per-packet case needs both sizes
+    }
+
+    const BenchmarkResult& smallResult = results[results.size() - 2];
+    const BenchmarkResult& largeResult = results[results.size() - 1];
+    BenchmarkResult result;
+    result.name = "send/per_packet";
+    result.bytes = Constants::PACKET_SIZE;
+    result.iterations = std::min(smallResult.iterations, largeResult.iterations);
+    result.nsPerOp = (largeResult.nsPerOp - smallResult.nsPerOp) / (SEND_LARGE_PACKETS - SEND_SMALL_PACKETS);
+    result.mbPerSecond = result.nsPerOp > 0 ? result.bytes * 1e3 / result.nsPerOp : 0;
+    result.allocationsPerOp = (largeResult.allocationsPerOp - smallResult.allocationsPerOp) / (SEND_LARGE_PACKETS - SEND_SMALL_PACKETS);
+    result.allocationSizes = largeResult.allocationSizes;
+    report(result);
+}
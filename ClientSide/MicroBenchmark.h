@@ -0,0 +1,140 @@
+#ifndef MICRO_BENCHMARK_H
+#define MICRO_BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @struct BenchmarkResult
+ * @brief The measurements of one benchmark case.
+ */
+struct BenchmarkResult {
+    std::string name;           ///< The case name, "<operation>/<buffer size>".
+    size_t bytes;               ///< The bytes processed per operation, or 0 if it has no input size.
+    uint64_t iterations;        ///< The measured operations.
+    double nsPerOp;             ///< Wall time per operation, in nanoseconds.
+    double mbPerSecond;         ///< Throughput in MB (10^6 bytes) per second, or 0 if bytes is 0.
+    double allocationsPerOp;    ///< Heap allocations per operation, see AllocationCounter.
+    double allocationBudget = -1;       ///< The most allocations per operation allowed, or negative for no budget.
+    std::vector<size_t> allocationSizes; ///< The sizes of the first allocations of the measured operations.
+};
+
+/**
+ * @class MicroBenchmark
+ * @brief Measures the hot paths of the client in isolation: CRC, AES, RSA, Base64, protocol serialization and
+ * the packet send loop.
+ *
+ * Buffer-sized operations run for every size from Constants::BENCH_MIN_BYTES up to a maximum, in steps of
+ * Constants::BENCH_SIZE_STEP. Every case runs once to warm up and then repeats, in doubling batches, until
+ * it ran for at least Constants::BENCH_MIN_TIME_MS. The protocol cases have allocation budgets, which
+ * checkBudgets() holds them to, so that a copy reintroduced on the packet path fails the check.
+ */
+class MicroBenchmark {
+public:
+    /**
+     * @brief Creates the suite.
+     *
+     * @param filter Only cases whose name contains it are run; empty runs every case.
+     * @param maxBytes The largest buffer size.
+     */
+    MicroBenchmark(const std::string& filter, size_t maxBytes);
+
+    /**
+     * @brief Runs the selected cases, printing each result as it completes.
+     *
+     * @param out Where the result table is printed.
+     * @return The results, in the order they ran.
+     */
+    std::vector<BenchmarkResult> run(std::ostream& out);
+
+    /**
+     * @brief Writes results as a JSON array, for comparing runs.
+     *
+     * @param results The results.
+     * @param path The file to write.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    static void writeJson(const std::vector<BenchmarkResult>& results, const std::string& path);
+
+    /**
+     * @brief Reports every case that allocated more than its budget.
+     *
+     * @param results The results.
+     * @param out Where the cases over budget are reported, with the sizes of their first allocations.
+     * @return true if every case with a budget stayed within it.
+     */
+    static bool checkBudgets(const std::vector<BenchmarkResult>& results, std::ostream& out);
+
+private:
+    std::string filter;                     ///< The substring selecting cases.
+    size_t maxBytes;                        ///< The largest buffer size.
+    std::vector<BenchmarkResult> results;   ///< The results so far.
+    std::ostream* out = nullptr;            ///< Where results are printed.
+
+    /**
+     * @brief Returns the buffer sizes of the buffer-sized cases.
+     *
+     * @return The sizes, smallest first.
+     */
+    std::vector<size_t> sizes() const;
+
+    /**
+     * @brief Measures one case, unless the filter excludes it.
+     *
+     * @param name The case name.
+     * @param bytes The bytes processed per operation, or 0.
+     * @param operation The operation; its return value is kept so the work is not optimized away.
+     */
+    void measure(const std::string& name, size_t bytes, const std::function<size_t()>& operation);
+
+    /**
+     * @brief Keeps a result and prints it as a row of the table.
+     *
+     * @param result The result; its allocation budget is looked up by name.
+     */
+    void report(BenchmarkResult result);
+
+    /**
+     * @brief Returns whether the filter selects a case.
+     *
+     * @param name The case name.
+     * @return true if the case runs.
+     */
+    bool selected(const std::string& name) const;
+
+    /**
+     * @brief Measures CRC_Calculator::memcrc for every buffer size.
+     */
+    void benchmarkCrc();
+
+    /**
+     * @brief Measures AESWrapper::encrypt and decrypt for every buffer size.
+     */
+    void benchmarkAes();
+
+    /**
+     * @brief Measures Base64Wrapper::encode and decode for every buffer size.
+     */
+    void benchmarkBase64();
+
+    /**
+     * @brief Measures RSA key generation, and the decryption of an AES key as received from the server.
+     */
+    void benchmarkRsa();
+
+    /**
+     * @brief Measures building, serializing and parsing full-size protocol packets.
+     */
+    void benchmarkSerialization();
+
+    /**
+     * @brief Measures ClientSession::getServerCRC on files of two sizes over a transport that discards the
+     * requests, and derives the cost of one more packet from the difference.
+     */
+    void benchmarkSendLoop();
+};
+
+#endif // MICRO_BENCHMARK_H
@@ -0,0 +1,169 @@
+#include "ProtocolRecorder.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "Constants.h"
+
+std::atomic<bool> ProtocolRecorder::active(false);
+
+namespace {
+
+    /**
+     * @brief Appends a number to a buffer, little-endian.
+     *
+     * @param buffer The buffer.
+     * @param value The number.
+     * @param size Its width in bytes.
+     */
+    void putNumber(std::vector<char>& buffer, uint64_t value, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+    }
+
+    /**
+     * @brief Reads a little-endian number from a stream.
+     *
+     * @param in The stream.
+     * @param size The width of the number in bytes.
+     * @param value Receives the number.
+     * @return false if the stream ended first.
+     */
+    bool getNumber(std::istream& in, size_t size, uint64_t& value) {
+        unsigned char bytes[8];
+        if (!in.read(reinterpret_cast<char*>(bytes), size)) {
+            return false;
+        }
+        value = 0;
+        for (size_t i = 0; i < size; i++) {
+            value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        }
+        return true;
+    }
+}
+
+/**
+ * @brief Returns the recorder of the process.
+ *
+ * @return The process-wide instance.
+ */
+ProtocolRecorder& ProtocolRecorder::instance() {
+    static ProtocolRecorder recorder;
+    return recorder;
+}
+
+/**
+ * @brief Starts recording every session connected from now on to the given file.
+ *
+ * @param path The capture file; it is overwritten.
+ * @throws std::runtime_error if the file cannot be opened.
+ */
+void ProtocolRecorder::start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+    file.write(Constants::CAPTURE_MAGIC, std::strlen(Constants::CAPTURE_MAGIC));
+    this->path = path;
+    epoch = Clock::now();
+    sessions = 0;
+    active.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Stops recording and closes the capture file.
+ *
+ * @throws std::runtime_error if the capture could not be written completely.
+ */
+void ProtocolRecorder::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active.exchange(false)) {
+        return;
+    }
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+/**
+ * @brief Numbers a newly connected session and records its Open event.
+ *
+ * @param endpoint The server's address:port.
+ * @return The session number, from 1.
+ */
+uint32_t ProtocolRecorder::openSession(const std::string& endpoint) {
+    uint32_t session;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        session = ++sessions;
+    }
+    record(session, CaptureEvent::Open, endpoint.data(), endpoint.size());
+    return session;
+}
+
+/**
+ * @brief Records an event of a session.
+ *
+ * The record is serialized before the lock is taken, so sessions only contend on the write itself.
+ * Events after stop() are ignored.
+ * @param session The session number given by openSession().
+ * @param event The kind of event.
+ * @param data The bytes sent or received.
+ * @param size The number of bytes.
+ */
+void ProtocolRecorder::record(uint32_t session, CaptureEvent event, const char* data, size_t size) {
+    std::vector<char> header;
+    header.reserve(Constants::CAPTURE_RECORD_HEADER_SIZE);
+    putNumber(header, session, 4);
+    putNumber(header, static_cast<uint8_t>(event), 1);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    putNumber(header, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count(), 8);
+    putNumber(header, size, 4);
+    file.write(header.data(), header.size());
+    if (size > 0) {
+        file.write(data, size);
+    }
+}
+
+/**
+ * @brief Reads a capture file.
+ *
+ * @param path The capture file.
+ * @return Its records, in the order they happened.
+ * @throws std::runtime_error if the file cannot be read or is not a capture.
+ */
+std::vector<CaptureRecord> ProtocolRecorder::read(const std::string& path) {
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+    std::string magic(std::strlen(Constants::CAPTURE_MAGIC), '\0');
+    if (!in.read(&magic[0], magic.size()) || magic != Constants::CAPTURE_MAGIC) {
+        throw std::runtime_error("Not a protocol capture: " + path);
+    }
+
+    std::vector<CaptureRecord> records;
+    uint64_t session;
+    while (getNumber(in, 4, session)) {
+        uint64_t event;
+        uint64_t timeNs;
+        uint64_t size;
+        if (!getNumber(in, 1, event) || !getNumber(in, 8, timeNs) || !getNumber(in, 4, size)
+            || event > static_cast<uint8_t>(CaptureEvent::Close)) {
+            throw std::runtime_error("Truncated or corrupt protocol capture: " + path);
+        }
+        CaptureRecord record{ static_cast<uint32_t>(session), static_cast<CaptureEvent>(event), timeNs, std::vector<char>(size) };
+        if (size > 0 && !in.read(record.bytes.data(), size)) {
+            throw std::runtime_error("Truncated or corrupt protocol capture: " + path);
+        }
+        records.push_back(std::move(record));
+    }
+    return records;
+}
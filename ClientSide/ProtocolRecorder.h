@@ -0,0 +1,118 @@
+#ifndef PROTOCOL_RECORDER_H
+#define PROTOCOL_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The kinds of events in a protocol capture.
+ */
+enum class CaptureEvent : uint8_t {
+    Open,               ///< A session connected; the bytes are the server's address:port.
+    Request,            ///< A request was sent; the bytes are the request as written to the socket.
+    ResponseHeader,     ///< A response header arrived.
+    ResponsePayload,    ///< A response payload arrived.
+    Close               ///< The session ended; no bytes.
+};
+
+/**
+ * @struct CaptureRecord
+ * @brief One event of a protocol capture.
+ */
+struct CaptureRecord {
+    uint32_t session;           ///< The session of the event, numbered from 1 in the order the sessions connected.
+    CaptureEvent event;         ///< The kind of event.
+    uint64_t timeNs;            ///< When the event happened, in nanoseconds since the capture started.
+    std::vector<char> bytes;    ///< The bytes sent or received.
+};
+
+/**
+ * @class ProtocolRecorder
+ * @brief An opt-in recorder of the exact bytes every ClientSession sends and receives, with timestamps.
+ *
+ * The capture is a binary file: Constants::CAPTURE_MAGIC, then every record as its session (4 bytes), event
+ * (1 byte), time (8 bytes) and length (4 bytes), little-endian, followed by its bytes. Records are appended
+ * in the order they happened across all sessions, so a capture of concurrent sessions keeps their
+ * interleaving. While recording is off, a session checks one relaxed atomic load per request and response.
+ *
+ * Captures hold the uploaded files, encrypted, and the user names; treat them like the files themselves.
+ */
+class ProtocolRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Returns the recorder of the process.
+     *
+     * @return The process-wide instance.
+     */
+    static ProtocolRecorder& instance();
+
+    /**
+     * @brief Returns whether sessions are being recorded.
+     *
+     * @return true if recording was started and not stopped.
+     */
+    static bool enabled() {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Starts recording every session connected from now on to the given file.
+     *
+     * @param path The capture file; it is overwritten.
+     * @throws std::runtime_error if the file cannot be opened.
+     */
+    void start(const std::string& path);
+
+    /**
+     * @brief Stops recording and closes the capture file.
+     *
+     * @throws std::runtime_error if the capture could not be written completely.
+     */
+    void stop();
+
+    /**
+     * @brief Numbers a newly connected session and records its Open event.
+     *
+     * @param endpoint The server's address:port.
+     * @return The session number, from 1.
+     */
+    uint32_t openSession(const std::string& endpoint);
+
+    /**
+     * @brief Records an event of a session.
+     *
+     * @param session The session number given by openSession().
+     * @param event The kind of event.
+     * @param data The bytes sent or received.
+     * @param size The number of bytes.
+     */
+    void record(uint32_t session, CaptureEvent event, const char* data = nullptr, size_t size = 0);
+
+    /**
+     * @brief Reads a capture file.
+     *
+     * @param path The capture file.
+     * @return Its records, in the order they happened.
+     * @throws std::runtime_error if the file cannot be read or is not a capture.
+     */
+    static std::vector<CaptureRecord> read(const std::string& path);
+
+private:
+    static std::atomic<bool> active;        ///< Whether sessions are recorded.
+    std::ofstream file;                     ///< The capture file.
+    std::string path;                       ///< Its path, for errors.
+    Clock::time_point epoch;                ///< When recording started.
+    uint32_t sessions = 0;                  ///< The sessions numbered so far.
+    std::mutex mutex;                       ///< Guards the file and the session count.
+
+    ProtocolRecorder() = default;
+};
+
+#endif // PROTOCOL_RECORDER_H
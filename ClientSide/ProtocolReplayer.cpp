@@ -0,0 +1,433 @@
+#include "ProtocolReplayer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "AESWrapper.h"
+#include "ClientSission.h"
+#include "Constants.h"
+#include "Logger.h"
+#include "Request.h"
+#include "ResponseHeader.h"
+#include "ResponsePayload.h"
+#include "TransferMetrics.h"
+
+namespace {
+
+    // Offsets of the request fields the replay changes
+    constexpr size_t CODE_OFFSET = Constants::CLIENT_ID_SIZE + Constants::VERSION_SIZE;
+    constexpr size_t PAYLOAD_OFFSET = Constants::REQUEST_HEADER_SIZE;
+    constexpr size_t PUBLIC_KEY_OFFSET = PAYLOAD_OFFSET + Constants::USERNAME_SIZE;
+    constexpr size_t ORIG_FILE_SIZE_OFFSET = PAYLOAD_OFFSET + Constants::CONTENT_SIZE_SIZE;
+    constexpr size_t PACKET_NUMBER_OFFSET = ORIG_FILE_SIZE_OFFSET + Constants::ORIG_FILE_SIZE_SIZE;
+    constexpr size_t CONTENT_OFFSET = PACKET_NUMBER_OFFSET + Constants::PACKET_NUMBER_SIZE + Constants::TOTAL_PACKET_SIZE
+        + Constants::FILE_NAME_SIZE;
+
+    /**
+     * @brief Reads a little-endian number of a request.
+     *
+     * @param bytes The request.
+     * @param offset Where the number starts.
+     * @param size Its width in bytes.
+     * @return The number.
+     */
+    uint32_t readNumber(const std::vector<char>& bytes, size_t offset, size_t size) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < size; i++) {
+            value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[offset + i])) << (8 * i);
+        }
+        return value;
+    }
+
+    /**
+     * @brief Returns the user name of a registration, public key or reconnection request.
+     *
+     * @param bytes The request.
+     * @return The user name, or empty if the request has none.
+     */
+    std::string userNameOf(const std::vector<char>& bytes) {
+        if (bytes.size() < PAYLOAD_OFFSET + Constants::USERNAME_SIZE) {
+            return "";
+        }
+        const char* field = bytes.data() + PAYLOAD_OFFSET;
+        return std::string(field, std::find(field, field + Constants::USERNAME_SIZE, '\0'));
+    }
+
+    /**
+     * @brief Returns a short name of a request code, for the report.
+     *
+     * @param code The request code.
+     * @return The name.
+     */
+    const char* codeName(int code) {
+        switch (code) {
+        case RequestHeader::Code::RegistrationCode: return "register";
+        case RequestHeader::Code::PublicKeyCode: return "public key";
+        case RequestHeader::Code::ReconnectingCode: return "reconnect";
+        case RequestHeader::Code::SendFileCode: return "send file";
+        case RequestHeader::Code::ValidCRC: return "crc valid";
+        case RequestHeader::Code::NotValidCRC: return "crc retry";
+        case RequestHeader::Code::NotValidCRC4th: return "crc failed";
+        default: return "unknown";
+        }
+    }
+
+    /**
+     * @brief Returns the median of some samples.
+     *
+     * @param samples The samples; sorted in place.
+     * @return The median, or 0 if there are none.
+     */
+    double median(std::vector<double>& samples) {
+        if (samples.empty()) {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+}
+
+/**
+ * @brief Reads a capture to replay.
+ *
+ * @param capturePath The capture file.
+ * @param address The address of the server to replay to.
+ * @param port The port of the server.
+ * @param originalSpeed Whether to keep the recorded times, rather than replaying as fast as possible.
+ * @throws std::runtime_error if the capture cannot be read.
+ */
+ProtocolReplayer::ProtocolReplayer(const std::string& capturePath, const std::string& address, const std::string& port, bool originalSpeed)
+    : records(ProtocolRecorder::read(capturePath)), address(address), port(port), originalSpeed(originalSpeed) {
+    std::random_device random;
+    std::ostringstream suffix;
+    suffix << "-replay-" << std::hex << random();
+    userSuffix = suffix.str();
+}
+
+/**
+ * @brief Replays the capture and prints the report.
+ *
+ * A session that fails on a network error is dropped, and the rest of its events are skipped.
+ * @param out Where the report is printed.
+ * @return The report.
+ * @throws std::runtime_error if a user that the capture only reconnects cannot be registered.
+ */
+ReplayReport ProtocolReplayer::run(std::ostream& out) {
+    registerReconnectedUsers();
+
+    tcp::resolver resolver(io);
+    tcp::resolver::results_type resolved = resolver.resolve(address, port);
+    auto start = Clock::now();
+    for (size_t i = 0; i < records.size(); i++) {
+        const CaptureRecord& record = records[i];
+        if (originalSpeed && (record.event == CaptureEvent::Open || record.event == CaptureEvent::Request)) {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.timeNs - records.front().timeNs));
+        }
+        try {
+            replay(i, resolved);
+        }
+        catch (const std::exception& e) {
+            Log::warn("Replayed session failed", { { "session", record.session }, { "reason", e.what() } });
+            failedSessions++;
+            sessions[record.session] = Session();
+        }
+    }
+
+    ReplayReport report;
+    report.sessions = sessions.size();
+    report.failedSessions = failedSessions;
+    report.replayedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report.recordedSeconds = records.empty() ? 0 : (records.back().timeNs - records.front().timeNs) / 1e9;
+    for (auto& entry : exchanges) {
+        Exchanges& exchange = entry.second;
+        ReplayCodeStats stats;
+        stats.code = entry.first;
+        stats.count = exchange.replayedMs.size();
+        stats.mismatches = exchange.mismatches;
+        stats.recordedMaxMs = exchange.recordedMs.empty() ? 0 : *std::max_element(exchange.recordedMs.begin(), exchange.recordedMs.end());
+        stats.replayedMaxMs = exchange.replayedMs.empty() ? 0 : *std::max_element(exchange.replayedMs.begin(), exchange.replayedMs.end());
+        stats.recordedP50Ms = median(exchange.recordedMs);
+        stats.replayedP50Ms = median(exchange.replayedMs);
+        report.codes.push_back(stats);
+    }
+
+    out << report.sessions << " sessions, " << std::fixed << std::setprecision(3) << report.recordedSeconds << " s recorded, "
+        << report.replayedSeconds << " s replayed" << (originalSpeed ? " at the original speed" : "");
+    if (report.failedSessions > 0) {
+        out << ", " << report.failedSessions << " sessions failed";
+    }
+    out << "\n\n" << std::left << std::setw(18) << "request" << std::right << std::setw(8) << "count" << std::setw(12)
+        << "mismatches" << std::setw(14) << "recorded ms" << std::setw(14) << "replayed ms" << std::setw(14) << "rec max ms"
+        << std::setw(14) << "rep max ms" << std::endl;
+    for (const ReplayCodeStats& stats : report.codes) {
+        out << std::left << std::setw(18) << (std::to_string(stats.code) + " " + codeName(stats.code)) << std::right
+            << std::setw(8) << stats.count << std::setw(12) << stats.mismatches << std::setw(14) << stats.recordedP50Ms
+            << std::setw(14) << stats.replayedP50Ms << std::setw(14) << stats.recordedMaxMs << std::setw(14) << stats.replayedMaxMs << std::endl;
+    }
+    return report;
+}
+
+/**
+ * @brief Writes a report as JSON, for comparing runs.
+ *
+ * @param report The report.
+ * @param path The file to write.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void ProtocolReplayer::writeJson(const ReplayReport& report, const std::string& path) {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+
+    file << std::fixed << std::setprecision(3) << "{\n  \"sessions\":" << report.sessions << ",\"failed_sessions\":"
+        << report.failedSessions << ",\"recorded_s\":" << report.recordedSeconds << ",\"replayed_s\":" << report.replayedSeconds
+        << ",\n  \"requests\":[\n";
+    for (size_t i = 0; i < report.codes.size(); i++) {
+        const ReplayCodeStats& stats = report.codes[i];
+        file << "    {\"code\":" << stats.code << ",\"name\":" << TransferMetrics::quoteJson(codeName(stats.code))
+            << ",\"count\":" << stats.count << ",\"mismatches\":" << stats.mismatches << ",\"recorded_p50_ms\":"
+            << stats.recordedP50Ms << ",\"replayed_p50_ms\":" << stats.replayedP50Ms << ",\"recorded_max_ms\":"
+            << stats.recordedMaxMs << ",\"replayed_max_ms\":" << stats.replayedMaxMs << (i + 1 < report.codes.size() ? "},\n" : "}\n");
+    }
+    file << "  ]\n}\n";
+
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+/**
+ * @brief Registers the users that the capture reconnects without registering them first.
+ *
+ * They were registered before the capture started; the server of the replay does not know them. Each is
+ * registered with the replayer's public key, over a connection of its own, before the timing starts.
+ * @throws std::runtime_error if the server refuses a registration.
+ */
+void ProtocolReplayer::registerReconnectedUsers() {
+    std::set<std::string> registered;
+    for (const CaptureRecord& record : records) {
+        if (record.event != CaptureEvent::Request || record.bytes.size() < PAYLOAD_OFFSET) {
+            continue;
+        }
+        int code = readNumber(record.bytes, CODE_OFFSET, Constants::CODE_SIZE);
+        std::string userName = userNameOf(record.bytes);
+        if (code == RequestHeader::Code::RegistrationCode) {
+            registered.insert(userName);
+        }
+        if (code != RequestHeader::Code::ReconnectingCode || !registered.insert(userName).second) {
+            continue;
+        }
+
+        tcp::socket socket(io);
+        boost::asio::connect(socket, tcp::resolver(io).resolve(address, port));
+        RequestPayload registration;
+        registration.setUserName(renamed(userName));
+        Request registrationRequest(RequestHeader(std::string(2 * Constants::CLIENT_ID_SIZE, 'F'), Constants::VERSION,
+            RequestHeader::Code::RegistrationCode, registration.size()), registration);
+        boost::asio::write(socket, boost::asio::buffer(registrationRequest.toBytes()));
+        std::vector<char> payload;
+        int responseCode = readResponse(socket, payload);
+        if (responseCode != ResponseHeader::Code::RegistrationSuccess) {
+            throw std::runtime_error("Could not register " + renamed(userName) + " before the replay: response " + std::to_string(responseCode));
+        }
+        std::string liveId(payload.begin(), payload.begin() + Constants::CLIENT_ID_SIZE);
+
+        RequestPayload keySubmission;
+        keySubmission.setUserName(renamed(userName));
+        keySubmission.setPublicKey(rsa.getPublicKey());
+        std::string liveIdHex = std::get<std::string>(ResponsePayload(responseCode, payload).getField("client_id"));
+        Request keyRequest(RequestHeader(liveIdHex, Constants::VERSION,
+            RequestHeader::Code::PublicKeyCode, keySubmission.size()), keySubmission);
+        boost::asio::write(socket, boost::asio::buffer(keyRequest.toBytes()));
+        responseCode = readResponse(socket, payload);
+        learn(responseCode, payload, responseCode, payload);
+
+        clientIds[std::string(record.bytes.begin(), record.bytes.begin() + Constants::CLIENT_ID_SIZE)] = liveId;
+    }
+}
+
+/**
+ * @brief Replays one event of the capture.
+ *
+ * A response header is replayed together with its payload: the payload the server sends is read right
+ * away, and the captured payload after the header is only used to learn from.
+ * @param index The index of the event.
+ * @param resolved The server's endpoints.
+ */
+void ProtocolReplayer::replay(size_t index, const tcp::resolver::results_type& resolved) {
+    const CaptureRecord& record = records[index];
+    Session& session = sessions[record.session];
+    if (record.event != CaptureEvent::Open && !session.socket) {
+        return; // the session failed earlier
+    }
+
+    switch (record.event) {
+    case CaptureEvent::Open:
+        session = Session();
+        session.socket = std::make_unique<tcp::socket>(io);
+        boost::asio::connect(*session.socket, resolved);
+        break;
+
+    case CaptureEvent::Request: {
+        if (!session.inExchange && record.bytes.size() >= PAYLOAD_OFFSET) {
+            session.inExchange = true;
+            session.code = readNumber(record.bytes, CODE_OFFSET, Constants::CODE_SIZE);
+            session.recordedStartNs = record.timeNs;
+            session.start = Clock::now();
+        }
+        std::vector<char> bytes = record.bytes;
+        rewriteRequest(bytes, session);
+        boost::asio::write(*session.socket, boost::asio::buffer(bytes));
+        break;
+    }
+
+    case CaptureEvent::ResponseHeader: {
+        std::vector<char> livePayload;
+        int liveCode = readResponse(*session.socket, livePayload);
+        auto end = Clock::now();
+
+        // The captured payload, if the session read one after this header
+        const CaptureRecord* recordedPayload = nullptr;
+        for (size_t next = index + 1; next < records.size(); next++) {
+            if (records[next].session == record.session) {
+                if (records[next].event == CaptureEvent::ResponsePayload) {
+                    recordedPayload = &records[next];
+                }
+                break;
+            }
+        }
+        int recordedCode = ResponseHeader(record.bytes).getCode();
+        learn(recordedCode, recordedPayload ? recordedPayload->bytes : std::vector<char>(), liveCode, livePayload);
+
+        if (session.inExchange) {
+            Exchanges& exchange = exchanges[session.code];
+            uint64_t recordedEndNs = recordedPayload ? recordedPayload->timeNs : record.timeNs;
+            exchange.recordedMs.push_back((recordedEndNs - session.recordedStartNs) / 1e6);
+            exchange.replayedMs.push_back(std::chrono::duration<double, std::milli>(end - session.start).count());
+            exchange.mismatches += liveCode != recordedCode;
+            session.inExchange = false;
+        }
+        break;
+    }
+
+    case CaptureEvent::ResponsePayload:
+        break; // read with its header
+
+    case CaptureEvent::Close:
+        session.socket->close();
+        session.socket.reset();
+        break;
+    }
+}
+
+/**
+ * @brief Adjusts a captured request for the replay, see the class description.
+ *
+ * @param bytes The request; changed in place.
+ * @param session The session sending it.
+ */
+void ProtocolReplayer::rewriteRequest(std::vector<char>& bytes, Session& session) {
+    if (bytes.size() < PAYLOAD_OFFSET) {
+        return;
+    }
+    auto liveId = clientIds.find(std::string(bytes.begin(), bytes.begin() + Constants::CLIENT_ID_SIZE));
+    if (liveId != clientIds.end()) {
+        std::copy(liveId->second.begin(), liveId->second.end(), bytes.begin());
+    }
+    int code = readNumber(bytes, CODE_OFFSET, Constants::CODE_SIZE);
+
+    if ((code == RequestHeader::Code::RegistrationCode || code == RequestHeader::Code::PublicKeyCode
+        || code == RequestHeader::Code::ReconnectingCode) && bytes.size() >= PAYLOAD_OFFSET + Constants::USERNAME_SIZE) {
+        std::string userName = renamed(userNameOf(bytes));
+        std::fill(bytes.begin() + PAYLOAD_OFFSET, bytes.begin() + PAYLOAD_OFFSET + Constants::USERNAME_SIZE, '\0');
+        std::copy(userName.begin(), userName.end(), bytes.begin() + PAYLOAD_OFFSET);
+    }
+
+    if (code == RequestHeader::Code::PublicKeyCode && bytes.size() >= PUBLIC_KEY_OFFSET + Constants::PUBLIC_KEY_SIZE) {
+        std::string publicKey = rsa.getPublicKey();
+        std::copy(publicKey.begin(), publicKey.begin() + std::min<size_t>(publicKey.size(), Constants::PUBLIC_KEY_SIZE),
+            bytes.begin() + PUBLIC_KEY_OFFSET);
+    }
+
+    if (code == RequestHeader::Code::SendFileCode && bytes.size() >= CONTENT_OFFSET) {
+        auto aesKey = aesKeys.find(std::string(bytes.begin(), bytes.begin() + Constants::CLIENT_ID_SIZE));
+        if (aesKey == aesKeys.end()) {
+            return; // no key of the replay to encrypt with; the server will not decrypt the captured content
+        }
+        uint32_t packetNumber = readNumber(bytes, PACKET_NUMBER_OFFSET, Constants::PACKET_NUMBER_SIZE);
+        if (packetNumber == 1) {
+            uint32_t contentSize = readNumber(bytes, PAYLOAD_OFFSET, Constants::CONTENT_SIZE_SIZE);
+            std::vector<char> zeros(readNumber(bytes, ORIG_FILE_SIZE_OFFSET, Constants::ORIG_FILE_SIZE_SIZE));
+            AESWrapper aes(reinterpret_cast<const unsigned char*>(aesKey->second.data()), static_cast<unsigned int>(aesKey->second.size()));
+            session.fileContent = aes.encrypt(zeros.data(), static_cast<unsigned int>(zeros.size()));
+            if (session.fileContent.size() != contentSize) {
+                session.fileContent.clear();
+            }
+        }
+        size_t offset = (packetNumber - 1) * Constants::PACKET_CONTENT_SIZE;
+        size_t length = bytes.size() - CONTENT_OFFSET;
+        if (offset + length <= session.fileContent.size()) {
+            std::memcpy(bytes.data() + CONTENT_OFFSET, session.fileContent.data() + offset, length);
+        }
+    }
+}
+
+/**
+ * @brief Learns the client IDs and AES keys the server gave in a response.
+ *
+ * @param recordedCode The response code in the capture.
+ * @param recordedPayload The response payload in the capture.
+ * @param liveCode The response code in the replay.
+ * @param livePayload The response payload in the replay.
+ */
+void ProtocolReplayer::learn(int recordedCode, const std::vector<char>& recordedPayload, int liveCode, const std::vector<char>& livePayload) {
+    if (livePayload.size() < Constants::CLIENT_ID_SIZE) {
+        return;
+    }
+    std::string liveId(livePayload.begin(), livePayload.begin() + Constants::CLIENT_ID_SIZE);
+
+    bool givesId = liveCode == ResponseHeader::Code::RegistrationSuccess || liveCode == ResponseHeader::Code::PublicKeyReceived
+        || liveCode == ResponseHeader::Code::ReconnectionSuccess;
+    if (givesId && recordedCode == liveCode && recordedPayload.size() >= Constants::CLIENT_ID_SIZE) {
+        clientIds[std::string(recordedPayload.begin(), recordedPayload.begin() + Constants::CLIENT_ID_SIZE)] = liveId;
+    }
+    if (liveCode == ResponseHeader::Code::PublicKeyReceived || liveCode == ResponseHeader::Code::ReconnectionSuccess) {
+        aesKeys[liveId] = rsa.decrypt(livePayload.data() + Constants::CLIENT_ID_SIZE,
+            static_cast<unsigned int>(livePayload.size() - Constants::CLIENT_ID_SIZE));
+    }
+}
+
+/**
+ * @brief Returns a user name with the replay's suffix.
+ *
+ * @param userName The user name of the capture.
+ * @return The user name of the replay, shortened to Constants::MAX_USERNAME_LENGTH if needed.
+ */
+std::string ProtocolReplayer::renamed(const std::string& userName) const {
+    return userName.substr(0, Constants::MAX_USERNAME_LENGTH - userSuffix.size()) + userSuffix;
+}
+
+/**
+ * @brief Reads a response.
+ *
+ * @param socket The connection.
+ * @param payload Receives the payload.
+ * @return The response code.
+ */
+int ProtocolReplayer::readResponse(tcp::socket& socket, std::vector<char>& payload) {
+    std::vector<char> header(Constants::HEADER_RESPONSE_SIZE);
+    boost::asio::read(socket, boost::asio::buffer(header));
+    ResponseHeader responseHeader(header);
+    payload.resize(responseHeader.getPayloadSize());
+    boost::asio::read(socket, boost::asio::buffer(payload));
+    return responseHeader.getCode();
+}
@@ -0,0 +1,180 @@
+#ifndef PROTOCOL_REPLAYER_H
+#define PROTOCOL_REPLAYER_H
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ProtocolRecorder.h"
+#include "RSAWrapper.h"
+
+/**
+ * @struct ReplayCodeStats
+ * @brief The exchanges of one request code in a replay, next to the same exchanges in the capture.
+ */
+struct ReplayCodeStats {
+    int code;                   ///< The code of the request opening the exchanges.
+    uint64_t count;             ///< The exchanges replayed completely.
+    uint64_t mismatches;        ///< The exchanges answered with another response code than in the capture.
+    double recordedP50Ms;       ///< Median time from the request to its response in the capture, in milliseconds.
+    double replayedP50Ms;       ///< The same in the replay.
+    double recordedMaxMs;       ///< The longest such time in the capture, in milliseconds.
+    double replayedMaxMs;       ///< The same in the replay.
+};
+
+/**
+ * @struct ReplayReport
+ * @brief The results of a replay.
+ */
+struct ReplayReport {
+    size_t sessions;                        ///< The sessions in the capture.
+    uint64_t failedSessions;                ///< The sessions that ended early on a network error.
+    double recordedSeconds;                 ///< The time from the first to the last event of the capture.
+    double replayedSeconds;                 ///< The time the replay took.
+    std::vector<ReplayCodeStats> codes;     ///< The exchanges, by request code.
+};
+
+/**
+ * @class ProtocolReplayer
+ * @brief Sends the requests of a protocol capture to a server again, for regression timing on identical workloads.
+ *
+ * The events of every session of the capture are replayed on one thread, in exactly the order they were
+ * recorded across sessions: a request is sent once every earlier event was, and a response is waited for
+ * where one was received. At the original speed every connection and request also waits for its recorded
+ * time; otherwise they follow each other as fast as the server answers.
+ *
+ * The server gives out new client IDs and AES keys, so the requests are adjusted as little as needed for
+ * the server to do the same work: client IDs are replaced by the ones the server gave for them in the
+ * replay, user names get a suffix unique to the replay so they do not clash with users the server knows,
+ * the public key sent is the replayer's own, and the file content is replaced by zeros of the original size
+ * encrypted with the replay's AES key, which has the same length as the captured content. Users that the
+ * capture only reconnects are registered before the replay starts.
+ */
+class ProtocolReplayer {
+public:
+    /**
+     * @brief Reads a capture to replay.
+     *
+     * @param capturePath The capture file.
+     * @param address The address of the server to replay to.
+     * @param port The port of the server.
+     * @param originalSpeed Whether to keep the recorded times, rather than replaying as fast as possible.
+     * @throws std::runtime_error if the capture cannot be read.
+     */
+    ProtocolReplayer(const std::string& capturePath, const std::string& address, const std::string& port, bool originalSpeed);
+
+    /**
+     * @brief Replays the capture and prints the report.
+     *
+     * @param out Where the report is printed.
+     * @return The report.
+     * @throws std::runtime_error if a user that the capture only reconnects cannot be registered.
+     */
+    ReplayReport run(std::ostream& out);
+
+    /**
+     * @brief Writes a report as JSON, for comparing runs.
+     *
+     * @param report The report.
+     * @param path The file to write.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    static void writeJson(const ReplayReport& report, const std::string& path);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using tcp = boost::asio::ip::tcp;
+
+    /**
+     * @struct Session
+     * @brief The replay of one session of the capture.
+     */
+    struct Session {
+        std::unique_ptr<tcp::socket> socket;    ///< The connection; null before Open, after Close, and after a failure.
+        bool inExchange = false;                ///< Whether requests were sent that are not answered yet.
+        int code = 0;                           ///< The code of the request that opened the exchange.
+        uint64_t recordedStartNs = 0;           ///< When that request was sent in the capture.
+        Clock::time_point start;                ///< When it was sent in the replay.
+        std::string fileContent;                ///< The replacement content of the file being sent, or empty.
+    };
+
+    /**
+     * @struct Exchanges
+     * @brief The durations of the exchanges of one request code.
+     */
+    struct Exchanges {
+        std::vector<double> recordedMs;     ///< In the capture.
+        std::vector<double> replayedMs;     ///< In the replay.
+        uint64_t mismatches = 0;            ///< Answered with another response code than in the capture.
+    };
+
+    std::vector<CaptureRecord> records;             ///< The capture.
+    std::string address;                            ///< The server address.
+    std::string port;                               ///< The server port.
+    bool originalSpeed;                             ///< Whether to keep the recorded times.
+    boost::asio::io_context io;                     ///< Runs the connections.
+    RSAPrivateWrapper rsa;                          ///< The replayer's key pair, for the AES keys of the replay.
+    std::string userSuffix;                         ///< Appended to every user name.
+    std::map<std::string, std::string> clientIds;   ///< The client IDs of the replay, by the ones in the capture.
+    std::map<std::string, std::string> aesKeys;     ///< The AES keys of the replay, by client ID of the replay.
+    std::map<uint32_t, Session> sessions;           ///< The sessions, by number.
+    std::map<int, Exchanges> exchanges;             ///< The exchanges, by request code.
+    uint64_t failedSessions = 0;                    ///< Sessions that ended early.
+
+    /**
+     * @brief Registers the users that the capture reconnects without registering them first.
+     *
+     * @throws std::runtime_error if the server refuses a registration.
+     */
+    void registerReconnectedUsers();
+
+    /**
+     * @brief Replays one event of the capture.
+     *
+     * @param index The index of the event.
+     * @param resolved The server's endpoints.
+     */
+    void replay(size_t index, const tcp::resolver::results_type& resolved);
+
+    /**
+     * @brief Adjusts a captured request for the replay, see the class description.
+     *
+     * @param bytes The request; changed in place.
+     * @param session The session sending it.
+     */
+    void rewriteRequest(std::vector<char>& bytes, Session& session);
+
+    /**
+     * @brief Learns the client IDs and AES keys the server gave in a response.
+     *
+     * @param recordedCode The response code in the capture.
+     * @param recordedPayload The response payload in the capture.
+     * @param liveCode The response code in the replay.
+     * @param livePayload The response payload in the replay.
+     */
+    void learn(int recordedCode, const std::vector<char>& recordedPayload, int liveCode, const std::vector<char>& livePayload);
+
+    /**
+     * @brief Returns a user name with the replay's suffix.
+     *
+     * @param userName The user name of the capture.
+     * @return The user name of the replay.
+     */
+    std::string renamed(const std::string& userName) const;
+
+    /**
+     * @brief Reads a response.
+     *
+     * @param socket The connection.
+     * @param payload Receives the payload.
+     * @return The response code.
+     */
+    static int readResponse(tcp::socket& socket, std::vector<char>& payload);
+};
+
+#endif // PROTOCOL_REPLAYER_H
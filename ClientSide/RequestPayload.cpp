@@ -46,7 +46,7 @@ void RequestPayload::setPublicKey(const std::string& publicKey) {
  *
  * This method iterates through all fields stored in the payload and prints their names and values.
  * It handles fields of different types (int, unsigned long, and string) by checking their types using `std::holds_alternative`
- * and then prints the appropriate value.
+ * and then prints the appropriate value. The encrypted file content and the public key are printed as their size only.
  *
  * @param os The output stream where the payload will be printed.
  * @param payload The RequestPayload object whose fields will be printed.
@@ -61,6 +61,9 @@ std::ostream& operator<<(std::ostream& os, const RequestPayload& payload) {
         else if (std::holds_alternative<unsigned long>(field.second)) {
             os << std::get<unsigned long>(field.second);
         }
+        else if (field.first == "content" || field.first == "public key") {
+            os << "<" << std::get<std::string>(field.second).size() << " bytes>";
+        }
         else if (std::holds_alternative<std::string>(field.second)) {
             os << std::get<std::string>(field.second);
         }
@@ -39,7 +39,7 @@ public:
 	/**
 	 * @brief Overloads the << operator to print the payload's contents.
 	 *
-	 * Prints all the fields stored in the payload to the output stream.
+	 * Prints all the fields stored in the payload to the output stream. The file content and the public key are printed as their size only.
 	 * @param os The output stream.
 	 * @param payload The RequestPayload object to be printed.
 	 * @return The output stream after printing the payload.
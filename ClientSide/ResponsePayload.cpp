@@ -55,7 +55,7 @@ ResponsePayload::ResponsePayload(int code, const std::vector<char>& payloadData)
             offset += Constants::FILE_NAME_SIZE;
 
             // Checksum (4 bytes)
-            unsigned long cksum = readNumber(payloadData, offset, Constants::CKSUM_SIZE);
+            unsigned long cksum = static_cast<uint32_t>(readNumber(payloadData, offset, Constants::CKSUM_SIZE));
             attributes.push_back({ "cksum", cksum });
             offset += Constants::CKSUM_SIZE;
         }
@@ -74,6 +74,7 @@ ResponsePayload::ResponsePayload(int code, const std::vector<char>& payloadData)
  * @brief Overloads the << operator to print the contents of the payload.
  *
  * This method prints all the attributes stored in the payload, including fields like client ID, file name, etc.
+ * The AES key is printed as its size only.
  * @param os The output stream to print to.
  * @param payload The ResponsePayload object to print.
  * @return The output stream after printing the payload.
@@ -88,6 +89,9 @@ std::ostream& operator<<(std::ostream& os, const ResponsePayload& payload) {
         else if (std::holds_alternative<unsigned long>(attr.second)) {
             os << std::get<unsigned long>(attr.second);
         }
+        else if (attr.first == "aes_key") {
+            os << "<" << std::get<std::string>(attr.second).size() << " bytes>";
+        }
         else if (std::holds_alternative<std::string>(attr.second)) {
             os << std::get<std::string>(attr.second);
         }
@@ -38,6 +38,7 @@ public:
      * @brief Overloads the << operator to print the contents of the payload.
      *
      * This method prints all the attributes stored in the payload, including fields like client ID, file name, etc.
+     * The AES key is printed as its size only.
      * @param os The output stream to print to.
      * @param payload The ResponsePayload object to print.
      * @return The output stream after printing the payload.
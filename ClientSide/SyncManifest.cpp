@@ -0,0 +1,228 @@
+#include "SyncManifest.h"
+
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+#include "Constants.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Loads the manifest and replays its journal, if they exist.
+ *
+ * Journal lines override manifest lines, so uploads recorded by an interrupted sync are not repeated.
+ * @param manifestPath The path of the manifest file.
+ */
+SyncManifest::SyncManifest(const std::string& manifestPath)
+    : manifestPath(manifestPath), journalPath(manifestPath + Constants::SYNC_JOURNAL_SUFFIX) {
+    load(this->manifestPath);
+    load(journalPath);
+}
+
+/**
+ * @brief Closes the journal.
+ */
+SyncManifest::~SyncManifest() {
+    if (journal.is_open()) {
+        journal.close();
+    }
+}
+
+/**
+ * @brief Walks a directory tree and returns the regular files that are new or changed since their last upload.
+ *
+ * A file is unchanged when both its size and its last write time match its entry; its content is never read here.
+ * The manifest and its journal are skipped when they live inside the tree.
+ * @param root The directory to walk.
+ * @return The paths of the new or changed files.
+ * @throws std::filesystem::filesystem_error if the root directory cannot be read.
+ */
+std::vector<std::string> SyncManifest::findChanged(const std::string& root) {
+    std::vector<std::string> changed;
+    std::error_code pathError;
+    fs::path manifestFile = fs::absolute(manifestPath, pathError);
+    fs::path journalFile = fs::absolute(journalPath, pathError);
+
+    auto check = [&](const fs::directory_entry& entry) {
+        std::error_code ec;
+        if (!entry.is_regular_file(ec)) {
+            return;
+        }
+
+        fs::path absolute = fs::absolute(entry.path(), ec);
+        if (!ec && (absolute == manifestFile || absolute == journalFile)) {
+            return;
+        }
+
+        ManifestEntry current;
+        current.size = entry.file_size(ec);
+        current.mtime = entry.last_write_time(ec).time_since_epoch().count();
+        if (ec) {
+            return; // removed while scanning
+        }
+
+        std::string path = entry.path().generic_string();
+        auto known = entries.find(path);
+        if (known != entries.end() && known->second.size == current.size && known->second.mtime == current.mtime) {
+            return;
+        }
+        scanned[path] = current;
+        changed.push_back(path);
+    };
+
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied), end;
+    while (it != end) {
+        check(*it);
+        fs::path previous = it->path();
+        it.increment(ec);
+        if (ec) {
+            ec.clear();
+            if (it == end) {
+                break; // some implementations end the walk when a directory cannot be entered
+            }
+            if (it->path() == previous) {
+                // Still on the directory that could not be entered, so step over it instead of failing on it again
+                it.disable_recursion_pending();
+                it.increment(ec);
+                ec.clear();
+            }
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief Checks whether a single file is new or changed since its last upload. Safe to call from several threads.
+ *
+ * Used for the paths reported by a watcher, where a full scan would defeat the point.
+ * @param path The path of the file.
+ * @return true if the path is a regular file, other than the manifest and its journal, that is new or changed.
+ */
+bool SyncManifest::checkChanged(const std::string& path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    if (absolute == fs::absolute(manifestPath, ec) || absolute == fs::absolute(journalPath, ec)
+        || absolute == fs::absolute(manifestPath + Constants::SYNC_TEMP_SUFFIX, ec)) {
+        return false;
+    }
+
+    fs::directory_entry file(path, ec);
+    if (ec || !file.is_regular_file(ec)) {
+        return false; // removed before it could be uploaded
+    }
+
+    ManifestEntry current;
+    current.size = file.file_size(ec);
+    current.mtime = file.last_write_time(ec).time_since_epoch().count();
+    if (ec) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto known = entries.find(path);
+    if (known != entries.end() && known->second.size == current.size && known->second.mtime == current.mtime) {
+        return false;
+    }
+    scanned[path] = current;
+    return true;
+}
+
+/**
+ * @brief Records a server-confirmed upload by appending it to the journal. Safe to call from several threads.
+ *
+ * Each upload is written as one complete line and flushed, so a crash loses at most the line being written,
+ * which load() then ignores.
+ * @param path The path of the uploaded file, as returned by findChanged.
+ * @param cksum The CRC confirmed by the server.
+ */
+void SyncManifest::recordUpload(const std::string& path, unsigned long cksum) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // The metadata is only needed until the upload is recorded
+    ManifestEntry entry = scanned[path];
+    scanned.erase(path);
+    entry.cksum = cksum;
+    entries[path] = entry;
+
+    if (!journal.is_open()) {
+        journal.open(journalPath, std::ios::out | std::ios::app | std::ios::binary);
+        if (!journal.is_open()) {
+            throw std::runtime_error("Could not open file: " + journalPath);
+        }
+    }
+    journal << formatLine(path, entry);
+    journal.flush();
+}
+
+/**
+ * @brief Atomically replaces the manifest with the current entries and removes the journal.
+ *
+ * The entries are written to a temporary file that is then renamed over the manifest, so readers see either
+ * the old or the new manifest. The journal is removed last; replaying it again would be harmless.
+ * @throws std::runtime_error if the new manifest could not be written.
+ */
+void SyncManifest::compact() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::string tempPath = manifestPath + Constants::SYNC_TEMP_SUFFIX;
+    std::ofstream file(tempPath, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + tempPath);
+    }
+    for (const auto& entry : entries) {
+        file << formatLine(entry.first, entry.second);
+    }
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Could not write file: " + tempPath);
+    }
+
+    fs::rename(tempPath, manifestPath);
+
+    if (journal.is_open()) {
+        journal.close();
+    }
+    std::error_code ec;
+    fs::remove(journalPath, ec);
+}
+
+/**
+ * @brief Reads manifest lines from a file into the entries. Incomplete or malformed lines are ignored.
+ *
+ * @param path The file to read.
+ */
+void SyncManifest::load(const std::string& path) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        return;
+    }
+
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t lineStart = 0;
+    size_t lineEnd;
+
+    // Only complete lines count: a torn last line of an interrupted write has no newline
+    while ((lineEnd = content.find('\n', lineStart)) != std::string::npos) {
+        std::istringstream line(content.substr(lineStart, lineEnd - lineStart));
+        lineStart = lineEnd + 1;
+
+        ManifestEntry entry;
+        std::string filePath;
+        if (line >> entry.size >> entry.mtime >> entry.cksum && line.get() == '\t' && std::getline(line, filePath) && !filePath.empty()) {
+            entries[filePath] = entry;
+        }
+    }
+}
+
+/**
+ * @brief Formats an entry as a manifest line: size, mtime, cksum and path, separated by tabs.
+ *
+ * @param path The path of the file.
+ * @param entry The entry to format.
+ * @return The line, including its trailing newline.
+ */
+std::string SyncManifest::formatLine(const std::string& path, const ManifestEntry& entry) {
+    return std::to_string(entry.size) + "\t" + std::to_string(entry.mtime) + "\t" + std::to_string(entry.cksum) + "\t" + path + "\n";
+}
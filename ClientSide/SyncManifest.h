@@ -0,0 +1,103 @@
+#ifndef SYNC_MANIFEST_H
+#define SYNC_MANIFEST_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct ManifestEntry
+ * @brief What is known about a file from its last successful upload.
+ */
+struct ManifestEntry {
+    uintmax_t size = 0;         ///< The file size in bytes.
+    long long mtime = 0;        ///< The last write time, in ticks of the file system clock.
+    unsigned long cksum = 0;    ///< The CRC confirmed by the server.
+};
+
+/**
+ * @class SyncManifest
+ * @brief Remembers which files of a directory tree were uploaded, so a sync only sends new or changed files.
+ *
+ * A file is considered unchanged when its size and last write time match its entry, so the common case
+ * of a sync is a stat-only scan. Every server-confirmed upload is appended to a journal next to the
+ * manifest as one complete line, so an interrupted sync keeps what it already uploaded; compact() folds
+ * the journal into the manifest by writing a temporary file and renaming it over the old one.
+ */
+class SyncManifest {
+public:
+    /**
+     * @brief Loads the manifest and replays its journal, if they exist.
+     *
+     * @param manifestPath The path of the manifest file.
+     */
+    explicit SyncManifest(const std::string& manifestPath);
+
+    /**
+     * @brief Closes the journal.
+     */
+    ~SyncManifest();
+
+    /**
+     * @brief Walks a directory tree and returns the regular files that are new or changed since their last upload.
+     *
+     * Only file metadata is read. The size and last write time of every returned file are kept for recordUpload.
+     * @param root The directory to walk.
+     * @return The paths of the new or changed files.
+     * @throws std::filesystem::filesystem_error if the root directory cannot be read.
+     */
+    std::vector<std::string> findChanged(const std::string& root);
+
+    /**
+     * @brief Checks whether a single file is new or changed since its last upload. Safe to call from several threads.
+     *
+     * Only file metadata is read. The size and last write time of a changed file are kept for recordUpload.
+     * @param path The path of the file.
+     * @return true if the path is a regular file, other than the manifest and its journal, that is new or changed.
+     */
+    bool checkChanged(const std::string& path);
+
+    /**
+     * @brief Records a server-confirmed upload by appending it to the journal. Safe to call from several threads.
+     *
+     * @param path The path of the uploaded file, as returned by findChanged.
+     * @param cksum The CRC confirmed by the server.
+     */
+    void recordUpload(const std::string& path, unsigned long cksum);
+
+    /**
+     * @brief Atomically replaces the manifest with the current entries and removes the journal.
+     *
+     * @throws std::runtime_error if the new manifest could not be written.
+     */
+    void compact();
+
+private:
+    std::string manifestPath;                                   ///< The path of the manifest file.
+    std::string journalPath;                                    ///< The path of the journal of uploads not yet compacted.
+    std::unordered_map<std::string, ManifestEntry> entries;     ///< The known files by path.
+    std::unordered_map<std::string, ManifestEntry> scanned;     ///< Metadata of the changed files not recorded yet.
+    std::ofstream journal;                                      ///< The journal, opened on the first recorded upload.
+    std::mutex mutex;                                           ///< Guards the entries and the journal.
+
+    /**
+     * @brief Reads manifest lines from a file into the entries. Incomplete or malformed lines are ignored.
+     *
+     * @param path The file to read.
+     */
+    void load(const std::string& path);
+
+    /**
+     * @brief Formats an entry as a manifest line: size, mtime, cksum and path, separated by tabs.
+     *
+     * @param path The path of the file.
+     * @param entry The entry to format.
+     * @return The line, including its trailing newline.
+     */
+    static std::string formatLine(const std::string& path, const ManifestEntry& entry);
+};
+
+#endif // SYNC_MANIFEST_H
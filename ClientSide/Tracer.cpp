@@ -0,0 +1,124 @@
+#include "Tracer.h"
+
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "Constants.h"
+#include "TransferMetrics.h"
+
+std::atomic<bool> Tracer::active(false);
+
+/**
+ * @brief Returns the tracer of the process.
+ *
+ * @return The process-wide instance.
+ */
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+/**
+ * @brief Starts recording spans, to be written to the given file.
+ *
+ * @param path The trace file written by write().
+ */
+void Tracer::start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->path = path;
+    epoch = Clock::now();
+    active = true;
+}
+
+/**
+ * @brief Records a completed span on the calling thread.
+ *
+ * Takes no lock except on the first span of a thread. Spans beyond Constants::TRACE_MAX_EVENTS_PER_THREAD
+ * are counted but not kept, so a long-running client cannot grow without bound.
+ * @param name The span name, a string literal.
+ * @param category The span category, a string literal.
+ * @param start When the span started.
+ * @param end When the span ended.
+ * @param argName The name of a numeric argument, or null for none.
+ * @param argValue The numeric argument.
+ * @param detail The file the span worked on, or empty.
+ */
+void Tracer::complete(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+    const char* argName, int64_t argValue, const std::string& detail) {
+    ThreadBuffer& buffer = threadBuffer();
+    if (buffer.events.size() >= Constants::TRACE_MAX_EVENTS_PER_THREAD) {
+        buffer.dropped++;
+        return;
+    }
+
+    // Spans that started before tracing did are clipped to its start
+    uint64_t startNs = start > epoch ? std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count() : 0;
+    uint64_t durationNs = end > start ? std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() : 0;
+    buffer.events.push_back({ name, category, startNs, durationNs, argName, argValue, detail });
+}
+
+/**
+ * @brief Writes the recorded spans to the trace file. Call once no traced thread is running anymore.
+ *
+ * The file is a Chrome trace-event JSON object with one complete ("X") event per span, timestamps in
+ * microseconds, and a metadata event naming the process. Dropped spans are reported in the metadata.
+ * @throws std::runtime_error if the trace file cannot be written.
+ */
+void Tracer::write() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (path.empty()) {
+        return;
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+
+    uint64_t dropped = 0;
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (const auto& buffer : buffers) {
+        dropped += buffer->dropped;
+        for (const auto& event : buffer->events) {
+            file << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << buffer->threadId << ",\"ts\":" << event.startNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0;
+            if (event.argName || !event.detail.empty()) {
+                file << ",\"args\":{";
+                if (event.argName) {
+                    file << "\"" << event.argName << "\":" << event.argValue << (event.detail.empty() ? "" : ",");
+                }
+                if (!event.detail.empty()) {
+                    file << "\"file\":" << TransferMetrics::quoteJson(event.detail);
+                }
+                file << "}";
+            }
+            file << "},\n";
+        }
+    }
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"client\",\"dropped_events\":" << dropped << "}}\n]}\n";
+
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+/**
+ * @brief Returns the buffer of the calling thread, creating it on the first span.
+ *
+ * The buffers are owned by the tracer, so the spans of threads that already ended are still written.
+ * @return The buffer of the calling thread.
+ */
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = buffers.back().get();
+        buffer->threadId = static_cast<uint32_t>(buffers.size());
+        buffer->events.reserve(Constants::TRACE_INITIAL_EVENTS_PER_THREAD);
+    }
+    return *buffer;
+}
@@ -0,0 +1,150 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @struct TraceEvent
+ * @brief A completed span, as kept by the tracer until it is written.
+ */
+struct TraceEvent {
+    const char* name;           ///< The span name, a string literal.
+    const char* category;       ///< The span category, a string literal.
+    uint64_t startNs;           ///< The start, in nanoseconds since tracing started.
+    uint64_t durationNs;        ///< The duration, in nanoseconds.
+    const char* argName;        ///< The name of the numeric argument, or null for none.
+    int64_t argValue;           ///< The numeric argument.
+    std::string detail;         ///< The file the span worked on, or empty.
+};
+
+/**
+ * @class Tracer
+ * @brief An opt-in recorder of spans, written as Chrome trace-event JSON for chrome://tracing or Perfetto.
+ *
+ * Every thread appends its spans to a buffer of its own, so recording takes no lock. While tracing is off,
+ * a span costs one relaxed atomic load. Phases measured by TransferMetrics are traced as well.
+ */
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Returns the tracer of the process.
+     *
+     * @return The process-wide instance.
+     */
+    static Tracer& instance();
+
+    /**
+     * @brief Returns whether spans are being recorded.
+     *
+     * @return true if tracing was started.
+     */
+    static bool enabled() {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Starts recording spans, to be written to the given file.
+     *
+     * @param path The trace file written by write().
+     */
+    void start(const std::string& path);
+
+    /**
+     * @brief Records a completed span on the calling thread.
+     *
+     * @param name The span name, a string literal.
+     * @param category The span category, a string literal.
+     * @param start When the span started.
+     * @param end When the span ended.
+     * @param argName The name of a numeric argument, or null for none.
+     * @param argValue The numeric argument.
+     * @param detail The file the span worked on, or empty.
+     */
+    void complete(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+        const char* argName = nullptr, int64_t argValue = 0, const std::string& detail = "");
+
+    /**
+     * @brief Writes the recorded spans to the trace file. Call once no traced thread is running anymore.
+     *
+     * @throws std::runtime_error if the trace file cannot be written.
+     */
+    void write();
+
+private:
+    /**
+     * @struct ThreadBuffer
+     * @brief The spans recorded by one thread.
+     */
+    struct ThreadBuffer {
+        uint32_t threadId;                  ///< The trace's id of the thread, from 1.
+        std::vector<TraceEvent> events;     ///< The recorded spans.
+        uint64_t dropped = 0;               ///< Spans not kept because the buffer was full.
+    };
+
+    static std::atomic<bool> active;                        ///< Whether spans are recorded.
+    std::string path;                                       ///< The trace file.
+    Clock::time_point epoch;                                ///< When tracing started.
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;     ///< The buffers of every thread that recorded.
+    std::mutex mutex;                                       ///< Guards the list of buffers.
+
+    Tracer() = default;
+
+    /**
+     * @brief Returns the buffer of the calling thread, creating it on the first span.
+     *
+     * @return The buffer of the calling thread.
+     */
+    ThreadBuffer& threadBuffer();
+};
+
+/**
+ * @class TraceSpan
+ * @brief Traces the enclosing scope as a span, if tracing is on.
+ */
+class TraceSpan {
+public:
+    /**
+     * @brief Starts the span.
+     *
+     * @param name The span name, a string literal.
+     * @param category The span category, a string literal.
+     * @param argName The name of a numeric argument, or null for none.
+     * @param argValue The numeric argument.
+     */
+    TraceSpan(const char* name, const char* category, const char* argName = nullptr, int64_t argValue = 0)
+        : name(name), category(category), argName(argName), argValue(argValue), active(Tracer::enabled()) {
+        if (active) {
+            start = Tracer::Clock::now();
+        }
+    }
+
+    /**
+     * @brief Ends the span.
+     */
+    ~TraceSpan() {
+        if (active) {
+            Tracer::instance().complete(name, category, start, Tracer::Clock::now(), argName, argValue);
+        }
+    }
+
+private:
+    const char* name;                   ///< The span name.
+    const char* category;               ///< The span category.
+    const char* argName;                ///< The name of the numeric argument, or null.
+    int64_t argValue;                   ///< The numeric argument.
+    bool active;                        ///< Whether tracing was on when the span started.
+    Tracer::Clock::time_point start;    ///< When the span started.
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#endif // TRACER_H
@@ -0,0 +1,225 @@
+#include "TransferMetrics.h"
+
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+#include "Tracer.h"
+
+/**
+ * @brief Returns the metrics of the process.
+ *
+ * @return The process-wide instance.
+ */
+TransferMetrics& TransferMetrics::instance() {
+    static TransferMetrics metrics;
+    return metrics;
+}
+
+TransferMetrics::TransferMetrics() : epoch(Clock::now()), transferStart(epoch), transferNumber(1) {}
+
+/**
+ * @brief Sets where the summaries and the per-measurement log are written.
+ *
+ * @param summaryPath The file rewritten with the summary of every transfer, or empty for none.
+ * @param logPath The NDJSON file appended with every measurement and summary, or empty for none.
+ * @throws std::runtime_error if the log cannot be opened.
+ */
+void TransferMetrics::open(const std::string& summaryPath, const std::string& logPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->summaryPath = summaryPath;
+    if (!logPath.empty()) {
+        log.open(logPath, std::ios::out | std::ios::app | std::ios::binary);
+        if (!log.is_open()) {
+            throw std::runtime_error("Could not open file: " + logPath);
+        }
+        logging = true;
+    }
+}
+
+/**
+ * @brief Adds a measurement that started at the given time and ends now.
+ *
+ * Lock-free unless the log is open. The phase is also traced as a span, if tracing is on.
+ * @param phase The measured phase.
+ * @param start When the phase started.
+ * @param bytes The bytes the phase processed.
+ * @param file The file the phase worked on, or empty.
+ */
+void TransferMetrics::record(Phase phase, Clock::time_point start, uint64_t bytes, const std::string& file) {
+    auto end = Clock::now();
+    uint64_t durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    if (Tracer::enabled()) {
+        Tracer::instance().complete(phaseName(phase), "phase", start, end, "bytes", bytes, file);
+    }
+
+    PhaseTotals& phaseTotals = totals[static_cast<size_t>(phase)];
+    phaseTotals.count.fetch_add(1, std::memory_order_relaxed);
+    phaseTotals.totalNs.fetch_add(durationNs, std::memory_order_relaxed);
+    phaseTotals.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    uint64_t longest = phaseTotals.maxNs.load(std::memory_order_relaxed);
+    while (durationNs > longest && !phaseTotals.maxNs.compare_exchange_weak(longest, durationNs, std::memory_order_relaxed)) {
+    }
+
+    if (!logging) {
+        return;
+    }
+    std::ostringstream line;
+    line << "{\"type\":\"phase\",\"transfer\":" << transferNumber << ",\"phase\":\"" << phaseName(phase)
+        << "\",\"start_ns\":" << sinceEpoch(start) << ",\"duration_ns\":" << durationNs << ",\"bytes\":" << bytes;
+    if (!file.empty()) {
+        line << ",\"file\":" << quoteJson(file);
+    }
+    line << "}\n";
+
+    std::lock_guard<std::mutex> lock(mutex);
+    log << line.str();
+}
+
+/**
+ * @brief Counts the outcome of the files of an upload.
+ *
+ * @param succeeded The files whose CRC was confirmed.
+ * @param failed The files that were not uploaded.
+ */
+void TransferMetrics::countFiles(size_t succeeded, size_t failed) {
+    filesSucceeded += succeeded;
+    filesFailed += failed;
+}
+
+/**
+ * @brief Writes the summary of the transfer so far and starts the next one.
+ *
+ * The summary is one JSON object: the transfer number, its wall clock start, its monotonic start and
+ * duration, the file outcomes, and per phase the count, total and longest duration and bytes.
+ * Phases that were not measured are left out.
+ */
+void TransferMetrics::endTransfer() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = Clock::now();
+    auto wallStart = std::chrono::system_clock::now() - std::chrono::duration_cast<std::chrono::system_clock::duration>(now - transferStart);
+
+    std::ostringstream summary;
+    summary << "{\"type\":\"transfer\",\"transfer\":" << transferNumber
+        << ",\"wall_start_ms\":" << std::chrono::duration_cast<std::chrono::milliseconds>(wallStart.time_since_epoch()).count()
+        << ",\"start_ns\":" << sinceEpoch(transferStart)
+        << ",\"duration_ns\":" << std::chrono::duration_cast<std::chrono::nanoseconds>(now - transferStart).count()
+        << ",\"files_succeeded\":" << filesSucceeded.exchange(0) << ",\"files_failed\":" << filesFailed.exchange(0)
+        << ",\"phases\":{";
+
+    bool first = true;
+    for (size_t i = 0; i < totals.size(); i++) {
+        uint64_t count = totals[i].count.exchange(0);
+        uint64_t totalNs = totals[i].totalNs.exchange(0);
+        uint64_t maxNs = totals[i].maxNs.exchange(0);
+        uint64_t bytes = totals[i].bytes.exchange(0);
+        if (count == 0) {
+            continue;
+        }
+        summary << (first ? "" : ",") << "\"" << phaseName(static_cast<Phase>(i)) << "\":{\"count\":" << count
+            << ",\"total_ns\":" << totalNs << ",\"max_ns\":" << maxNs << ",\"bytes\":" << bytes << "}";
+        first = false;
+    }
+    summary << "}}\n";
+
+    if (!summaryPath.empty()) {
+        std::ofstream file(summaryPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        file << summary.str();
+    }
+    if (log.is_open()) {
+        log << summary.str();
+        log.flush();
+    }
+
+    transferStart = now;
+    transferNumber++;
+}
+
+/**
+ * @brief Returns the name of a phase as used in the JSON output.
+ *
+ * @param phase The phase.
+ * @return The snake_case name of the phase.
+ */
+const char* TransferMetrics::phaseName(Phase phase) {
+    switch (phase) {
+    case Phase::ConfigLoad: return "config_load";
+    case Phase::Connect: return "connect";
+    case Phase::Registration: return "registration";
+    case Phase::Reconnect: return "reconnect";
+    case Phase::RsaKeygen: return "rsa_keygen";
+    case Phase::RsaUnwrap: return "rsa_unwrap";
+    case Phase::FileRead: return "file_read";
+    case Phase::LocalCrc: return "local_crc";
+    case Phase::Encrypt: return "encrypt";
+    case Phase::Send: return "send";
+    case Phase::AwaitServerCrc: return "await_server_crc";
+    case Phase::Retry: return "retry";
+    default: return "unknown";
+    }
+}
+
+/**
+ * @brief Quotes a string as a JSON string literal.
+ *
+ * @param value The string to quote.
+ * @return The quoted and escaped string.
+ */
+std::string TransferMetrics::quoteJson(const std::string& value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        switch (c) {
+        case '"': quoted += "\\\""; break;
+        case '\\': quoted += "\\\\"; break;
+        case '\n': quoted += "\\n"; break;
+        case '\r': quoted += "\\r"; break;
+        case '\t': quoted += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted += escaped;
+            }
+            else {
+                quoted += c;
+            }
+        }
+    }
+    return quoted + "\"";
+}
+
+/**
+ * @brief Converts a time point to nanoseconds since the epoch of the metrics.
+ *
+ * @param time The time point.
+ * @return The nanoseconds since the epoch.
+ */
+uint64_t TransferMetrics::sinceEpoch(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+}
+
+/**
+ * @brief Starts measuring a phase.
+ *
+ * @param phase The phase to measure.
+ * @param bytes The bytes the phase processes, if known up front.
+ * @param file The file the phase works on, or empty.
+ */
+ScopedPhase::ScopedPhase(Phase phase, uint64_t bytes, const std::string& file)
+    : phase(phase), bytes(bytes), file(file), start(TransferMetrics::Clock::now()) {}
+
+/**
+ * @brief Records the phase.
+ */
+ScopedPhase::~ScopedPhase() {
+    TransferMetrics::instance().record(phase, start, bytes, file);
+}
+
+/**
+ * @brief Sets the bytes the phase processed, for phases that only know it at the end.
+ *
+ * @param processed The bytes processed.
+ */
+void ScopedPhase::setBytes(uint64_t processed) {
+    bytes = processed;
+}
@@ -0,0 +1,173 @@
+#ifndef TRANSFER_METRICS_H
+#define TRANSFER_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+/**
+ * @enum Phase
+ * @brief The phases of a transfer whose time and bytes are measured.
+ *
+ * Phases may nest: registration and reconnection include the RSA work and the configuration reads they do.
+ */
+enum class Phase {
+    ConfigLoad,         ///< Reading transfer.info and expanding the file list.
+    Connect,            ///< Resolving the server address and opening a TCP connection.
+    Registration,       ///< The registration and public key exchange, up to the unwrapped AES key.
+    Reconnect,          ///< The reconnection, up to the unwrapped AES key.
+    RsaKeygen,          ///< Generating and saving the RSA key pair.
+    RsaUnwrap,          ///< Decrypting the AES key with the private RSA key.
+    FileRead,           ///< Reading a file to upload.
+    LocalCrc,           ///< Calculating the CRC of a file.
+    Encrypt,            ///< Encrypting a file with AES.
+    Send,               ///< Serializing and writing the packets of a file.
+    AwaitServerCrc,     ///< Waiting for the server's CRC of a sent file.
+    Retry,              ///< Resending a file after a CRC mismatch, send and wait included.
+    Count               ///< The number of phases, not a phase.
+};
+
+/**
+ * @class TransferMetrics
+ * @brief Process-wide per-phase timings and byte counts, exported as JSON.
+ *
+ * Every measured phase adds its monotonic duration and byte count to per-phase totals, from any thread.
+ * When a transfer ends, the totals are written as a JSON summary and reset. With a log open, every
+ * measurement and every summary is also appended to it as one JSON line (NDJSON).
+ */
+class TransferMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Returns the metrics of the process.
+     *
+     * @return The process-wide instance.
+     */
+    static TransferMetrics& instance();
+
+    /**
+     * @brief Sets where the summaries and the per-measurement log are written.
+     *
+     * @param summaryPath The file rewritten with the summary of every transfer, or empty for none.
+     * @param logPath The NDJSON file appended with every measurement and summary, or empty for none.
+     * @throws std::runtime_error if the log cannot be opened.
+     */
+    void open(const std::string& summaryPath, const std::string& logPath);
+
+    /**
+     * @brief Adds a measurement that started at the given time and ends now.
+     *
+     * @param phase The measured phase.
+     * @param start When the phase started.
+     * @param bytes The bytes the phase processed.
+     * @param file The file the phase worked on, or empty.
+     */
+    void record(Phase phase, Clock::time_point start, uint64_t bytes, const std::string& file = "");
+
+    /**
+     * @brief Counts the outcome of the files of an upload.
+     *
+     * @param succeeded The files whose CRC was confirmed.
+     * @param failed The files that were not uploaded.
+     */
+    void countFiles(size_t succeeded, size_t failed);
+
+    /**
+     * @brief Writes the summary of the transfer so far and starts the next one.
+     */
+    void endTransfer();
+
+    /**
+     * @brief Returns the name of a phase as used in the JSON output.
+     *
+     * @param phase The phase.
+     * @return The snake_case name of the phase.
+     */
+    static const char* phaseName(Phase phase);
+
+    /**
+     * @brief Quotes a string as a JSON string literal.
+     *
+     * @param value The string to quote.
+     * @return The quoted and escaped string.
+     */
+    static std::string quoteJson(const std::string& value);
+
+private:
+    /**
+     * @struct PhaseTotals
+     * @brief The sums of the measurements of one phase.
+     */
+    struct PhaseTotals {
+        std::atomic<uint64_t> count{ 0 };      ///< The number of measurements.
+        std::atomic<uint64_t> totalNs{ 0 };    ///< The summed durations, in nanoseconds.
+        std::atomic<uint64_t> maxNs{ 0 };      ///< The longest duration, in nanoseconds.
+        std::atomic<uint64_t> bytes{ 0 };      ///< The summed bytes.
+    };
+
+    std::array<PhaseTotals, static_cast<size_t>(Phase::Count)> totals;    ///< The totals of the current transfer.
+    std::atomic<uint64_t> filesSucceeded{ 0 };     ///< Files confirmed in the current transfer.
+    std::atomic<uint64_t> filesFailed{ 0 };        ///< Files not uploaded in the current transfer.
+    Clock::time_point epoch;                        ///< The origin of the monotonic timestamps.
+    Clock::time_point transferStart;                ///< When the current transfer started.
+    std::atomic<uint64_t> transferNumber;           ///< The number of the current transfer, from 1.
+
+    std::string summaryPath;                        ///< Where summaries are written, or empty.
+    std::ofstream log;                              ///< The NDJSON log, if open.
+    std::atomic<bool> logging{ false };             ///< Whether the log is open; checked before formatting.
+    std::mutex mutex;                               ///< Guards the log and the transfer boundaries.
+
+    TransferMetrics();
+
+    /**
+     * @brief Converts a time point to nanoseconds since the epoch of the metrics.
+     *
+     * @param time The time point.
+     * @return The nanoseconds since the epoch.
+     */
+    uint64_t sinceEpoch(Clock::time_point time) const;
+};
+
+/**
+ * @class ScopedPhase
+ * @brief Measures a phase from construction to destruction.
+ */
+class ScopedPhase {
+public:
+    /**
+     * @brief Starts measuring a phase.
+     *
+     * @param phase The phase to measure.
+     * @param bytes The bytes the phase processes, if known up front.
+     * @param file The file the phase works on, or empty.
+     */
+    explicit ScopedPhase(Phase phase, uint64_t bytes = 0, const std::string& file = "");
+
+    /**
+     * @brief Records the phase.
+     */
+    ~ScopedPhase();
+
+    /**
+     * @brief Sets the bytes the phase processed, for phases that only know it at the end.
+     *
+     * @param processed The bytes processed.
+     */
+    void setBytes(uint64_t processed);
+
+private:
+    Phase phase;                            ///< The measured phase.
+    uint64_t bytes;                         ///< The bytes processed.
+    std::string file;                       ///< The file worked on, or empty.
+    TransferMetrics::Clock::time_point start; ///< When the phase started.
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+};
+
+#endif // TRANSFER_METRICS_H
@@ -0,0 +1,92 @@
+#include "Transport.h"
+
+#include "FaultyTransport.h"
+
+using boost::asio::ip::tcp;
+
+/**
+ * @brief Connects to the server over TCP, behind a FaultyTransport if faults are injected.
+ *
+ * @param address The server address.
+ * @param port The server port.
+ * @return The connection.
+ * @throws boost::system::system_error if the server cannot be reached.
+ */
+std::unique_ptr<Transport> Transport::connect(const std::string& address, const std::string& port) {
+    std::unique_ptr<Transport> transport = std::make_unique<TcpTransport>(address, port);
+    if (FaultyTransport::enabled()) {
+        transport = std::make_unique<FaultyTransport>(std::move(transport));
+    }
+    return transport;
+}
+
+/**
+ * @brief Reads exactly the given number of bytes.
+ *
+ * @param data Receives the bytes.
+ * @param size The number of bytes.
+ * @throws boost::system::system_error on a network error, or when the server closed the connection.
+ */
+void Transport::read(char* data, size_t size) {
+    for (size_t done = 0; done < size; ) {
+        done += readSome(data + done, size - done);
+    }
+}
+
+/**
+ * @brief Writes all the given bytes.
+ *
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @throws boost::system::system_error on a network error.
+ */
+void Transport::write(const char* data, size_t size) {
+    for (size_t done = 0; done < size; ) {
+        done += writeSome(data + done, size - done);
+    }
+}
+
+/**
+ * @brief Connects to the server.
+ *
+ * @param address The server address.
+ * @param port The server port.
+ * @throws boost::system::system_error if the server cannot be reached.
+ */
+TcpTransport::TcpTransport(const std::string& address, const std::string& port) : socket(io_context) {
+    tcp::resolver resolver(io_context);
+    boost::asio::connect(socket, resolver.resolve(address, port));
+}
+
+/**
+ * @brief Reads at least one byte and at most the given number.
+ *
+ * @param data Receives the bytes.
+ * @param size The most bytes to read.
+ * @return The number of bytes read.
+ * @throws boost::system::system_error on a network error, or when the server closed the connection.
+ */
+size_t TcpTransport::readSome(char* data, size_t size) {
+    return socket.read_some(boost::asio::buffer(data, size));
+}
+
+/**
+ * @brief Writes at least one byte and at most the given number.
+ *
+ * @param data The bytes.
+ * @param size The most bytes to write.
+ * @return The number of bytes written.
+ * @throws boost::system::system_error on a network error.
+ */
+size_t TcpTransport::writeSome(const char* data, size_t size) {
+    return socket.write_some(boost::asio::buffer(data, size));
+}
+
+/**
+ * @brief Closes the connection; later reads and writes fail.
+ */
+void TcpTransport::close() {
+    boost::system::error_code ec;
+    socket.shutdown(tcp::socket::shutdown_both, ec);
+    socket.close(ec);
+}
@@ -0,0 +1,97 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <boost/asio.hpp>
+#include <memory>
+#include <string>
+
+/**
+ * @class Transport
+ * @brief A connection to the server that moves bytes, as ClientSession sends requests and reads responses over it.
+ *
+ * Implementations provide partial reads and writes, which may move fewer bytes than asked; read() and write()
+ * loop over them. Network errors are thrown as boost::system::system_error, as Boost.Asio throws them.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * @brief Connects to the server over TCP, behind a FaultyTransport if faults are injected.
+     *
+     * @param address The server address.
+     * @param port The server port.
+     * @return The connection.
+     * @throws boost::system::system_error if the server cannot be reached.
+     */
+    static std::unique_ptr<Transport> connect(const std::string& address, const std::string& port);
+
+    /**
+     * @brief Reads at least one byte and at most the given number.
+     *
+     * @param data Receives the bytes.
+     * @param size The most bytes to read.
+     * @return The number of bytes read.
+     * @throws boost::system::system_error on a network error, or when the server closed the connection.
+     */
+    virtual size_t readSome(char* data, size_t size) = 0;
+
+    /**
+     * @brief Writes at least one byte and at most the given number.
+     *
+     * @param data The bytes.
+     * @param size The most bytes to write.
+     * @return The number of bytes written.
+     * @throws boost::system::system_error on a network error.
+     */
+    virtual size_t writeSome(const char* data, size_t size) = 0;
+
+    /**
+     * @brief Closes the connection; later reads and writes fail.
+     */
+    virtual void close() = 0;
+
+    /**
+     * @brief Reads exactly the given number of bytes.
+     *
+     * @param data Receives the bytes.
+     * @param size The number of bytes.
+     * @throws boost::system::system_error on a network error, or when the server closed the connection.
+     */
+    void read(char* data, size_t size);
+
+    /**
+     * @brief Writes all the given bytes.
+     *
+     * @param data The bytes.
+     * @param size The number of bytes.
+     * @throws boost::system::system_error on a network error.
+     */
+    void write(const char* data, size_t size);
+};
+
+/**
+ * @class TcpTransport
+ * @brief A plain TCP connection.
+ */
+class TcpTransport : public Transport {
+public:
+    /**
+     * @brief Connects to the server.
+     *
+     * @param address The server address.
+     * @param port The server port.
+     * @throws boost::system::system_error if the server cannot be reached.
+     */
+    TcpTransport(const std::string& address, const std::string& port);
+
+    size_t readSome(char* data, size_t size) override;
+    size_t writeSome(const char* data, size_t size) override;
+    void close() override;
+
+private:
+    boost::asio::io_context io_context; ///< ASIO context of the socket.
+    boost::asio::ip::tcp::socket socket; ///< TCP socket for communicating with the server.
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,419 @@
+#include "UploadDaemon.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "FileHandler.h"
+#include "TransferMetrics.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Constructs a daemon that is not listening yet.
+ *
+ * @param socketPath The path of the local socket to listen on.
+ * @param address The server address.
+ * @param port The server port.
+ * @param options The number of workers and connections of every batch.
+ * @param authenticate Authenticates new sessions with the server.
+ */
+UploadDaemon::UploadDaemon(const std::string& socketPath, const std::string& address, const std::string& port,
+    const UploadOptions& options, Authenticator authenticate)
+    : socketPath(socketPath), address(address), port(port), options(options), authenticate(std::move(authenticate)),
+    nextSequence(0), stopping(false) {}
+
+/**
+ * @brief Listens for submissions and uploads them until SIGINT or SIGTERM.
+ *
+ * Submissions are accepted on a background thread and served on a thread each, while the calling thread
+ * uploads the queued jobs batch by batch. On a stop request the batch in flight is finished, the queued
+ * jobs are failed and the socket file is removed.
+ * @throws boost::system::system_error if the socket cannot be bound.
+ * @throws std::runtime_error if the socket path is taken by another file or a running daemon.
+ */
+void UploadDaemon::run() {
+    boost::asio::io_context io;
+
+    removeStaleSocket();
+    boost::asio::local::stream_protocol::acceptor acceptor(io, boost::asio::local::stream_protocol::endpoint(socketPath));
+    boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+    signals.async_wait([this, &acceptor](const boost::system::error_code&, int) {
+        boost::system::error_code ec;
+        acceptor.close(ec);
+        stop();
+    });
+    acceptNext(acceptor);
+    std::thread ioThread([&io] { io.run(); });
+
+    warmUp();
+    Log::info("Daemon listening. Press Ctrl+C to stop", { { "socket", socketPath } });
+
+    std::vector<UploadJob> batch;
+    while (takeBatch(batch)) {
+        uploadBatch(batch);
+    }
+
+    ioThread.join();
+    {
+        std::lock_guard<std::mutex> lock(submittersMutex);
+        for (auto& submitter : submitters) {
+            submitter.thread.join();
+        }
+        submitters.clear();
+    }
+    std::remove(socketPath.c_str());
+    Log::info("Daemon stopped");
+}
+
+/**
+ * @brief Removes the socket file left behind by a daemon that did not exit cleanly.
+ *
+ * The path is only removed if it is a socket, not followed if it is a link, and nothing accepts connections
+ * on it, so neither another file nor the socket of a daemon still running is deleted.
+ * @throws std::runtime_error if the path exists and is not a socket that refuses connections.
+ */
+void UploadDaemon::removeStaleSocket() {
+    std::error_code ec;
+    fs::file_status status = fs::symlink_status(socketPath, ec);
+    if (status.type() == fs::file_type::not_found) {
+        return;
+    }
+    if (ec) {
+        throw std::runtime_error("Cannot check the socket path " + socketPath + ": " + ec.message());
+    }
+    if (status.type() != fs::file_type::socket) {
+        throw std::runtime_error("The socket path " + socketPath + " is taken by a file that is not a socket.");
+    }
+
+    boost::asio::io_context io;
+    Socket probe(io);
+    boost::system::error_code connectError;
+    probe.connect(boost::asio::local::stream_protocol::endpoint(socketPath), connectError);
+    if (!connectError) {
+        throw std::runtime_error("Another daemon is listening on " + socketPath + ".");
+    }
+    if (connectError != boost::asio::error::connection_refused) {
+        throw std::runtime_error("Cannot check the socket " + socketPath + ": " + connectError.message());
+    }
+    if (!fs::remove(socketPath, ec) && ec) {
+        throw std::runtime_error("Cannot remove the stale socket " + socketPath + ": " + ec.message());
+    }
+}
+
+/**
+ * @brief Submits files to a running daemon and prints the result of every file.
+ *
+ * The daemon runs in its own working directory, so it is given the absolute path of every file, and the
+ * name FileHandler::uploadName picks for it here, as a one-shot client run here would send.
+ * @param socketPath The path of the daemon's local socket.
+ * @param filePaths The files to upload.
+ * @param priority The priority of the files.
+ * @return true if every file was uploaded, false otherwise.
+ * @throws boost::system::system_error if the daemon cannot be reached.
+ */
+bool UploadDaemon::submit(const std::string& socketPath, const std::vector<std::string>& filePaths, int priority) {
+    boost::asio::io_context io;
+    Socket socket(io);
+    socket.connect(boost::asio::local::stream_protocol::endpoint(socketPath));
+
+    std::string request;
+    for (const auto& path : filePaths) {
+        request += std::to_string(priority) + "\t" + fs::absolute(path).generic_string() + "\t" + FileHandler::uploadName(path) + "\n";
+    }
+    request += "\n";
+    boost::asio::write(socket, boost::asio::buffer(request));
+
+    boost::asio::streambuf buffer;
+    std::istream input(&buffer);
+    boost::system::error_code ec;
+    size_t uploaded = 0;
+
+    // One line per file, as the files complete; the daemon closes the connection after the last one
+    for (;;) {
+        boost::asio::read_until(socket, buffer, '\n', ec);
+        if (ec) {
+            break;
+        }
+        std::string status, name, detail;
+        std::getline(input, status, '\t');
+        std::getline(input, name, '\t');
+        std::getline(input, detail);
+
+        if (status == "OK") {
+            std::cout << "Uploaded " << name << " (CRC " << detail << ")" << std::endl;
+            uploaded++;
+        }
+        else {
+            std::cerr << "Error: " << name << ": " << detail << std::endl;
+        }
+    }
+    return uploaded == filePaths.size();
+}
+
+/**
+ * @brief Authenticates the session and opens the additional connections ahead of the first submission.
+ *
+ * A failure is not fatal: the server may simply not be up yet, and the first batch tries again.
+ */
+void UploadDaemon::warmUp() {
+    try {
+        ensureSession();
+        connections.resize(options.connections > 1 ? options.connections - 1 : 0);
+        for (auto& connection : connections) {
+            if (!connection) {
+                connection = std::make_unique<ClientSession>(address, port);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        Log::warn("Could not connect ahead of the first submission", { { "reason", e.what() } });
+    }
+}
+
+/**
+ * @brief Opens and authenticates the session if there is none.
+ *
+ * @throws std::runtime_error if the session cannot be authenticated.
+ */
+void UploadDaemon::ensureSession() {
+    if (session) {
+        return;
+    }
+    auto fresh = std::make_unique<ClientSession>(address, port);
+    if (!authenticate(*fresh, clientId)) {
+        throw std::runtime_error("Authentication failed.");
+    }
+    session = std::move(fresh);
+}
+
+/**
+ * @brief Waits for queued jobs and takes the most urgent ones.
+ *
+ * @param batch Receives up to Constants::DAEMON_MAX_BATCH_FILES jobs.
+ * @return true if jobs were taken, false if a stop was requested.
+ */
+bool UploadDaemon::takeBatch(std::vector<UploadJob>& batch) {
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    jobsAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+    batch.clear();
+    while (!jobs.empty() && batch.size() < Constants::DAEMON_MAX_BATCH_FILES) {
+        batch.push_back(jobs.top());
+        jobs.pop();
+    }
+    return !batch.empty();
+}
+
+/**
+ * @brief Uploads a batch of jobs and sends every job's result to its submitter.
+ *
+ * Files submitted more than once are uploaded once. A file that no longer exists fails without touching
+ * the connection. When the batch fails on the warm session, the session is dropped and the unconfirmed
+ * files are tried once more on a fresh one, since the warm session may have gone stale while idle.
+ * @param batch The jobs to upload, in priority order.
+ */
+void UploadDaemon::uploadBatch(const std::vector<UploadJob>& batch) {
+    using FileKey = std::pair<std::string, std::string>;
+
+    std::vector<std::string> paths;
+    std::vector<std::string> names;
+    std::set<FileKey> queued;
+    std::map<FileKey, std::string> failed;
+    for (const auto& job : batch) {
+        FileKey key(job.filePath, job.fileName);
+        std::error_code ec;
+        if (!fs::is_regular_file(job.filePath, ec)) {
+            failed[key] = "no such file";
+        }
+        else if (queued.insert(key).second) {
+            paths.push_back(job.filePath);
+            names.push_back(job.fileName);
+        }
+    }
+
+    std::mutex confirmedMutex;
+    std::map<FileKey, unsigned long> confirmed;
+    std::string error = "upload failed";
+
+    for (int attempt = 0; attempt < 2 && !paths.empty(); attempt++) {
+        bool warm = session != nullptr;
+        try {
+            ensureSession();
+            BatchUploader uploader(*session, address, port, clientId, options);
+            uploader.setConnectionPool(connections);
+            uploader.setOnUploaded([&confirmedMutex, &confirmed](const EncryptedFile& file) {
+                std::lock_guard<std::mutex> lock(confirmedMutex);
+                confirmed[FileKey(file.filePath, file.fileName)] = file.crc;
+            });
+            if (uploader.upload(paths, names)) {
+                break;
+            }
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+            Log::error("Batch failed", { { "files", paths.size() }, { "reason", e.what() } });
+        }
+
+        // The session may be broken; authenticate again before the next upload
+        session.reset();
+        if (!warm) {
+            break;
+        }
+
+        std::vector<std::string> retryPaths;
+        std::vector<std::string> retryNames;
+        for (size_t i = 0; i < paths.size(); i++) {
+            if (confirmed.count(FileKey(paths[i], names[i])) == 0) {
+                retryPaths.push_back(paths[i]);
+                retryNames.push_back(names[i]);
+            }
+        }
+        paths.swap(retryPaths);
+        names.swap(retryNames);
+    }
+
+    for (const auto& job : batch) {
+        FileKey key(job.filePath, job.fileName);
+        auto crc = confirmed.find(key);
+        auto reason = failed.find(key);
+        if (crc != confirmed.end()) {
+            job.results->push("OK\t" + job.fileName + "\t" + std::to_string(crc->second) + "\n");
+        }
+        else {
+            job.results->push("FAIL\t" + job.fileName + "\t" + (reason != failed.end() ? reason->second : error) + "\n");
+        }
+    }
+    TransferMetrics::instance().endTransfer();
+}
+
+/**
+ * @brief Accepts the next submitter connection, and keeps doing so until the acceptor is closed.
+ *
+ * Runs on the I/O thread. Each submitter is served on its own thread; finished ones are joined here.
+ * @param acceptor The acceptor of the local socket.
+ */
+void UploadDaemon::acceptNext(boost::asio::local::stream_protocol::acceptor& acceptor) {
+    auto socket = std::make_shared<Socket>(acceptor.get_executor());
+    acceptor.async_accept(*socket, [this, &acceptor, socket](const boost::system::error_code& ec) {
+        if (ec) {
+            return; // closed by a stop request
+        }
+
+        std::lock_guard<std::mutex> lock(submittersMutex);
+        for (auto it = submitters.begin(); it != submitters.end(); ) {
+            if (it->done) {
+                it->thread.join();
+                it = submitters.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> jobsLock(jobsMutex);
+            if (stopping) {
+                return; // stop() already closed the other submitters; the socket closes on return
+            }
+        }
+
+        submitters.emplace_back();
+        Submitter& submitter = submitters.back();
+        submitter.socket = socket;
+        submitter.thread = std::thread(&UploadDaemon::serveSubmitter, this, std::ref(submitter));
+        acceptNext(acceptor);
+    });
+}
+
+/**
+ * @brief Reads one request from a submitter, queues its jobs and writes back their results.
+ *
+ * The results are written as the jobs complete, so a submitter of many files sees progress.
+ * @param submitter The connection to serve.
+ */
+void UploadDaemon::serveSubmitter(Submitter& submitter) {
+    Socket& socket = *submitter.socket;
+    try {
+        boost::asio::streambuf buffer;
+        std::istream input(&buffer);
+        std::vector<UploadJob> request;
+
+        for (;;) {
+            boost::asio::read_until(socket, buffer, '\n');
+            std::string line;
+            std::getline(input, line);
+            if (line.empty()) {
+                break;
+            }
+
+            UploadJob job;
+            std::istringstream fields(line);
+            if (!(fields >> job.priority) || fields.get() != '\t' || !std::getline(fields, job.filePath, '\t')
+                || !std::getline(fields, job.fileName) || job.filePath.empty() || job.fileName.empty()) {
+                throw std::runtime_error("Malformed request line: " + line);
+            }
+            request.push_back(std::move(job));
+        }
+
+        auto results = std::make_shared<BoundedQueue<std::string>>(request.size());
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+            for (auto& job : request) {
+                job.results = results;
+                if (stopping) {
+                    results->push("FAIL\t" + job.fileName + "\tdaemon stopping\n");
+                }
+                else {
+                    job.sequence = nextSequence++;
+                    jobs.push(job);
+                }
+            }
+        }
+        jobsAvailable.notify_one();
+
+        std::string result;
+        for (size_t i = 0; i < request.size() && results->pop(result); i++) {
+            boost::asio::write(socket, boost::asio::buffer(result));
+        }
+    }
+    catch (const std::exception& e) {
+        Log::error("Submission dropped", { { "reason", e.what() } });
+    }
+
+    boost::system::error_code ec;
+    socket.close(ec);
+    submitter.done = true;
+}
+
+/**
+ * @brief Stops accepting, fails the queued jobs and closes the submitter connections.
+ *
+ * Runs on the I/O thread when a signal arrives. The batch in flight is left to finish and report normally.
+ */
+void UploadDaemon::stop() {
+    std::vector<UploadJob> dropped;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stopping = true;
+        while (!jobs.empty()) {
+            dropped.push_back(jobs.top());
+            jobs.pop();
+        }
+    }
+    jobsAvailable.notify_all();
+
+    for (const auto& job : dropped) {
+        job.results->push("FAIL\t" + job.fileName + "\tdaemon stopping\n");
+    }
+
+    // Wakes submitters still sending their request; results can still be written
+    std::lock_guard<std::mutex> lock(submittersMutex);
+    for (auto& submitter : submitters) {
+        boost::system::error_code ec;
+        submitter.socket->shutdown(Socket::shutdown_receive, ec);
+    }
+}
@@ -0,0 +1,179 @@
+#ifndef UPLOAD_DAEMON_H
+#define UPLOAD_DAEMON_H
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BatchUploader.h"
+#include "BoundedQueue.h"
+#include "ClientSission.h"
+
+/**
+ * @struct UploadJob
+ * @brief A file submitted to the daemon, waiting to be uploaded.
+ */
+struct UploadJob {
+    int priority = Constants::DAEMON_DEFAULT_PRIORITY;      ///< Jobs with a higher priority are uploaded first.
+    uint64_t sequence = 0;                                  ///< Submission order, for jobs of equal priority.
+    std::string filePath;                                   ///< The absolute path of the local file.
+    std::string fileName;                                   ///< The file name sent to the server.
+    std::shared_ptr<BoundedQueue<std::string>> results;     ///< Receives the result line of the job.
+};
+
+/**
+ * @struct UploadJobOrder
+ * @brief Orders the job queue: highest priority first, then first submitted first.
+ */
+struct UploadJobOrder {
+    bool operator()(const UploadJob& a, const UploadJob& b) const {
+        return a.priority != b.priority ? a.priority < b.priority : a.sequence > b.sequence;
+    }
+};
+
+/**
+ * @class UploadDaemon
+ * @brief A resident client that keeps an authenticated session open and uploads the files submitted to it.
+ *
+ * Files are submitted over a local (Unix domain) socket by submit(), typically from another client process.
+ * Every request is a list of lines "priority\tpath\tname" ending with an empty line; the daemon answers
+ * with one line per file as it completes, "OK\tname\tcrc" or "FAIL\tname\treason", then closes the connection.
+ *
+ * Queued jobs are taken in batches, highest priority first, and uploaded by a BatchUploader over the warm
+ * session and a pool of warm additional connections, so a submission costs neither a process start nor a
+ * reconnection with its RSA unwrap of the AES key.
+ */
+class UploadDaemon {
+public:
+    /**
+     * @brief Authenticates a fresh session and stores the client ID assigned by the server.
+     */
+    using Authenticator = std::function<bool(ClientSession&, std::string&)>;
+
+    /**
+     * @brief Constructs a daemon that is not listening yet.
+     *
+     * @param socketPath The path of the local socket to listen on.
+     * @param address The server address.
+     * @param port The server port.
+     * @param options The number of workers and connections of every batch.
+     * @param authenticate Authenticates new sessions with the server.
+     */
+    UploadDaemon(const std::string& socketPath, const std::string& address, const std::string& port,
+        const UploadOptions& options, Authenticator authenticate);
+
+    /**
+     * @brief Listens for submissions and uploads them until SIGINT or SIGTERM.
+     *
+     * @throws boost::system::system_error if the socket cannot be bound.
+     * @throws std::runtime_error if the socket path is taken by another file or a running daemon.
+     */
+    void run();
+
+    /**
+     * @brief Submits files to a running daemon and prints the result of every file.
+     *
+     * @param socketPath The path of the daemon's local socket.
+     * @param filePaths The files to upload, each named as a one-shot client run here would name it.
+     * @param priority The priority of the files.
+     * @return true if every file was uploaded, false otherwise.
+     * @throws boost::system::system_error if the daemon cannot be reached.
+     */
+    static bool submit(const std::string& socketPath, const std::vector<std::string>& filePaths, int priority);
+
+private:
+    using Socket = boost::asio::local::stream_protocol::socket;
+
+    /**
+     * @struct Submitter
+     * @brief A connection of a submitting process, served on its own thread.
+     */
+    struct Submitter {
+        std::shared_ptr<Socket> socket;     ///< The connection.
+        std::thread thread;                 ///< The thread serving it.
+        std::atomic<bool> done{ false };    ///< Set when the thread is about to end.
+    };
+
+    std::string socketPath;                 ///< The path of the local socket.
+    std::string address;                    ///< The server address.
+    std::string port;                       ///< The server port.
+    UploadOptions options;                  ///< The number of workers and connections of every batch.
+    Authenticator authenticate;             ///< Authenticates new sessions.
+
+    std::unique_ptr<ClientSession> session;                     ///< The authenticated session, or null.
+    std::vector<std::unique_ptr<ClientSession>> connections;    ///< The warm additional connections.
+    std::string clientId;                                       ///< The client ID of the session.
+
+    std::priority_queue<UploadJob, std::vector<UploadJob>, UploadJobOrder> jobs;   ///< The queued jobs.
+    uint64_t nextSequence;                  ///< The sequence number of the next job.
+    bool stopping;                          ///< Set once a stop was requested.
+    std::mutex jobsMutex;                   ///< Guards the jobs, the sequence number and the stopping flag.
+    std::condition_variable jobsAvailable;  ///< Signalled when jobs are queued or a stop was requested.
+
+    std::list<Submitter> submitters;        ///< The connections of submitting processes.
+    std::mutex submittersMutex;             ///< Guards the submitters.
+
+    /**
+     * @brief Removes the socket file left behind by a daemon that did not exit cleanly.
+     *
+     * @throws std::runtime_error if the path exists and is not a socket that refuses connections.
+     */
+    void removeStaleSocket();
+
+    /**
+     * @brief Authenticates the session and opens the additional connections ahead of the first submission.
+     */
+    void warmUp();
+
+    /**
+     * @brief Opens and authenticates the session if there is none.
+     *
+     * @throws std::runtime_error if the session cannot be authenticated.
+     */
+    void ensureSession();
+
+    /**
+     * @brief Waits for queued jobs and takes the most urgent ones.
+     *
+     * @param batch Receives up to Constants::DAEMON_MAX_BATCH_FILES jobs.
+     * @return true if jobs were taken, false if a stop was requested.
+     */
+    bool takeBatch(std::vector<UploadJob>& batch);
+
+    /**
+     * @brief Uploads a batch of jobs and sends every job's result to its submitter.
+     *
+     * @param batch The jobs to upload.
+     */
+    void uploadBatch(const std::vector<UploadJob>& batch);
+
+    /**
+     * @brief Accepts the next submitter connection, and keeps doing so until the acceptor is closed.
+     *
+     * @param acceptor The acceptor of the local socket.
+     */
+    void acceptNext(boost::asio::local::stream_protocol::acceptor& acceptor);
+
+    /**
+     * @brief Reads one request from a submitter, queues its jobs and writes back their results.
+     *
+     * @param submitter The connection to serve.
+     */
+    void serveSubmitter(Submitter& submitter);
+
+    /**
+     * @brief Stops accepting, fails the queued jobs and closes the submitter connections.
+     */
+    void stop();
+};
+
+#endif // UPLOAD_DAEMON_H
@@ -61,8 +61,34 @@ class Constants:
     ___ = 80
 
 
+class Server:
+    # at most this many clients are handled at once, further clients wait in the listen backlog
+    MAX_CONNECTIONS = 10000
+    LISTEN_BACKLOG = 1024
+    # the steps of the sessions that block or take long run on this many threads
+    WORKER_THREADS = 8
+    # the cached users are split into this many shards, each with its own lock
+    USER_SHARDS = 64
+    # uploads are decrypted by this many worker processes, None for one per core
+    DECRYPT_PROCESSES = None
+    # file descriptors the server needs besides those of the clients and their uploads
+    SPARE_FILES = 64
+    # seconds to wait before accepting again after accepting a connection failed
+    ACCEPT_RETRY_DELAY = 0.1
+
+
 class Crypto:
     AES_KEY_SIZE = 32
 
 
-
+class Files:
+    # uploads are written through a buffer of this size instead of one write per packet
+    WRITE_BUFFER_SIZE = 64 * 1024
+    # the decrypted file is written under its name with this suffix until its last packet arrived
+    PART_SUFFIX = '.part'
+    # the encrypted file is spooled under its name with this suffix until it is decrypted
+    SPOOL_SUFFIX = '.spool'
+    # uploads are handed to the decrypting worker processes in segments of this many bytes, whole AES blocks
+    DECRYPT_SEGMENT_SIZE = 1024 * 1024
+    # the registered users are kept in this SQLite database, so that they survive a restart of the server
+    USER_DATABASE = 'users.db'
@@ -100,6 +100,8 @@ class RequestPayload:
         getUserName(): Returns the username.
         getPublicKey(): Returns the public key.
         getFileName(): Returns the file name.
+        getContentSize(): Returns the size of the whole encrypted file.
+        getOrigFileSize(): Returns the size of the whole file before encryption.
         getMessageContent(): Returns the message content.
         getPacketNumber(): Returns the packet number.
         getTotalPackets(): Returns the total packets.
@@ -176,6 +178,14 @@ class RequestPayload:
         """Returns the file name."""
         return self.file_name
 
+    def getContentSize(self):
+        """Returns the size of the whole encrypted file."""
+        return self.content_size
+
+    def getOrigFileSize(self):
+        """Returns the size of the whole file before encryption."""
+        return self.orig_file_size
+
     def getMessageContent(self):
         """Returns the message content."""
         return self.message_content
@@ -1,7 +1,18 @@
+import argparse
+import asyncio
+import concurrent.futures
+import multiprocessing
+import os
+import signal
 import socket
-import threading
 import Constants
 import ServerSession as Ss
+import UserStore
+
+try:
+    import resource
+except ImportError:
+    resource = None  # not available on Windows
 
 
 def read_port():
@@ -21,44 +32,188 @@ def read_port():
     return port
 
 
-def handle_client(conn, addr, users, lock):
+def raise_open_file_limit():
+    """
+    Raises the soft limit on open files, where the platform has one, so that the server can keep
+    Constants.Server.MAX_CONNECTIONS clients connected at once, each with an upload in progress.
+    """
+    if resource is None:
+        return
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    wanted = 2 * Constants.Server.MAX_CONNECTIONS + Constants.Server.SPARE_FILES
+    if soft == resource.RLIM_INFINITY or soft >= wanted:
+        return
+    if hard != resource.RLIM_INFINITY:
+        wanted = min(wanted, hard)
+    resource.setrlimit(resource.RLIMIT_NOFILE, (wanted, hard))
+
+
+async def handle_client(conn, addr, users, decryptors):
     """
     Handles communication with a single client.
 
     Args:
         conn (socket): The client connection object.
         addr (tuple): The client address.
-        users (dict): Shared dictionary to manage user sessions.
-        lock (threading.Lock): Lock for thread-safe access to shared resources.
+        users (UserStore.UserStore): The registered users, shared by all the sessions.
+        decryptors (concurrent.futures.Executor): The worker processes that decrypt uploads, shared by all the
+            sessions.
     """
+    writer = None
     try:
-        session = Ss.ServerSession(conn, addr, users, lock)
-        session.handle_session()
+        reader, writer = await asyncio.open_connection(sock=conn)
+        session = Ss.ServerSession(reader, writer, addr, users, decryptors)
+        await session.handle_session()
     except Exception as e:
         print(f"Error handling client {addr}: {e}")
     finally:
         # Ensure connection is closed properly in case of error or when done
-        conn.close()
+        if writer is None:
+            conn.close()
+        else:
+            writer.close()
+            try:
+                await writer.wait_closed()
+            except OSError:
+                pass  # the client already reset the connection
         print(f"Connection closed for client {addr}")
 
 
-def main():
+async def serve(reuse_port=False, decrypt_processes=Constants.Server.DECRYPT_PROCESSES):
     """
-    Main function to start the server and handle incoming connections.
+    Accepts connections and handles each in a task on the event loop.
+
+    At most Constants.Server.MAX_CONNECTIONS clients are handled at once; beyond that the server stops accepting,
+    so further clients wait in the listen backlog until a session ends.
+
+    Args:
+        reuse_port (bool, optional): Whether to bind with SO_REUSEPORT, so that other server processes can accept
+            on the same port. Defaults to False.
+        decrypt_processes (int, optional): The number of worker processes that decrypt uploads, None for one per
+            core. Defaults to Constants.Server.DECRYPT_PROCESSES.
     """
-    users = {}
-    lock = threading.Lock()
+    raise_open_file_limit()
+    loop = asyncio.get_running_loop()
     try:
-        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-            s.bind((Constants.Constants.HOST, int(read_port())))
-            s.listen()
-            print(f"Server is listening on {Constants.Constants.HOST}:{read_port()}")
+        # Terminating shuts down like an interrupt, ending the sessions and removing their unfinished uploads
+        loop.add_signal_handler(signal.SIGTERM, asyncio.current_task().cancel)
+    except NotImplementedError:
+        pass  # not available on Windows
+    loop.set_default_executor(concurrent.futures.ThreadPoolExecutor(max_workers=Constants.Server.WORKER_THREADS))
+    users = UserStore.UserStore(Constants.Files.USER_DATABASE)
+    admission = asyncio.Semaphore(Constants.Server.MAX_CONNECTIONS)
+    # The loop only keeps weak references to tasks
+    sessions = set()
+
+    # Spawned rather than forked, the server has threads by the time the first worker starts
+    decryptors = concurrent.futures.ProcessPoolExecutor(max_workers=decrypt_processes,
+                                                        mp_context=multiprocessing.get_context('spawn'))
+
+    with decryptors, socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        if reuse_port:
+            s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+        s.bind((Constants.Constants.HOST, int(read_port())))
+        s.listen(Constants.Server.LISTEN_BACKLOG)
+        s.setblocking(False)
+        print(f"Server is listening on {Constants.Constants.HOST}:{read_port()}")
+        try:
             while True:
-                conn, addr = s.accept()
-                client_thread = threading.Thread(target=handle_client, args=(conn, addr, users, lock))
-                client_thread.start()
+                await admission.acquire()
+                try:
+                    conn, addr = await loop.sock_accept(s)
+                except OSError as e:
+                    # Out of file descriptors or the like, wait for sessions to end rather than stop serving
+                    admission.release()
+                    print(f"Error accepting a connection: {e}")
+                    await asyncio.sleep(Constants.Server.ACCEPT_RETRY_DELAY)
+                    continue
+                session = asyncio.create_task(handle_client(conn, addr, users, decryptors))
+                sessions.add(session)
+                session.add_done_callback(sessions.discard)
+                session.add_done_callback(lambda _: admission.release())
+        finally:
+            # End the sessions while the decryptors are still there for their uploads to be aborted
+            for session in sessions:
+                session.cancel()
+            await asyncio.gather(*sessions, return_exceptions=True)
+
+
+def run(reuse_port=False, decrypt_processes=Constants.Server.DECRYPT_PROCESSES):
+    """
+    Runs one server process until it is interrupted or terminated.
+
+    Args:
+        reuse_port (bool, optional): Whether to bind with SO_REUSEPORT. Defaults to False.
+        decrypt_processes (int, optional): The number of worker processes that decrypt uploads, None for one per
+            core. Defaults to Constants.Server.DECRYPT_PROCESSES.
+    """
+    try:
+        asyncio.run(serve(reuse_port, decrypt_processes))
+    except (KeyboardInterrupt, asyncio.CancelledError):
+        print("Server shutting down.")
+    except Exception as e:
+        print(f"Error: {e}")
+
+
+def launch(processes):
+    """
+    Starts server processes that each bind the port with SO_REUSEPORT and accept independently, the kernel
+    spreading the connections among them, and waits for them.
+
+    The processes share the registered users through the user store only, so a client may register on one
+    process, reconnect on another and upload on a third.
+
+    Args:
+        processes (int): The number of server processes.
+
+    Raises:
+        OSError: If the platform does not support SO_REUSEPORT.
+    """
+    if not hasattr(socket, 'SO_REUSEPORT'):
+        raise OSError("SO_REUSEPORT is not supported on this platform, run a single server process instead")
+
+    # Create the database once, rather than have every process race to create it
+    UserStore.UserStore(Constants.Files.USER_DATABASE)
+    decrypt_processes = Constants.Server.DECRYPT_PROCESSES
+    if decrypt_processes is None:
+        # The cores are shared among the decryptors of all the server processes
+        decrypt_processes = max(1, (os.cpu_count() or 1) // processes)
+
+    signal.signal(signal.SIGTERM, signal.default_int_handler)
+    context = multiprocessing.get_context('spawn')
+    workers = [context.Process(target=run, args=(True, decrypt_processes), name=f"server-{i}")
+               for i in range(processes)]
+    for worker in workers:
+        worker.start()
+    try:
+        for worker in workers:
+            worker.join()
+            if worker.exitcode != 0:
+                print(f"Server process {worker.name} exited with code {worker.exitcode}")
     except KeyboardInterrupt:
+        for worker in workers:
+            worker.terminate()
+        for worker in workers:
+            worker.join()
         print("Server shutting down.")
+
+
+def main():
+    """
+    Main function to start the server and handle incoming connections.
+    """
+    parser = argparse.ArgumentParser(description="File backup server.")
+    parser.add_argument('--processes', type=int, default=1,
+                        help="number of server processes accepting on the port with SO_REUSEPORT, "
+                             "0 for one per core (default: 1)")
+    arguments = parser.parse_args()
+    processes = arguments.processes if arguments.processes > 0 else os.cpu_count() or 1
+
+    if processes == 1:
+        run()
+        return
+    try:
+        launch(processes)
     except Exception as e:
         print(f"Error: {e}")
 
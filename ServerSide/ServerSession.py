@@ -1,16 +1,14 @@
+import asyncio
 import os
-import cksum
-
 import Request
 import Constants
 import Response
-import User
+import Upload
 import uuid
 
 from Crypto.PublicKey import RSA
-from Crypto.Cipher import PKCS1_OAEP, AES
+from Crypto.Cipher import PKCS1_OAEP
 from Crypto.Random import get_random_bytes
-from Crypto.Util.Padding import unpad
 
 
 class ServerSession:
@@ -18,34 +16,58 @@ class ServerSession:
     This class represents a session between the server and a single client, managing
     communication, authentication, file uploads, and encryption.
 
+    Sessions run as tasks on the server's event loop, so a session waiting for its client costs no thread. The
+    steps that block or take long, such as the RSA encryption and the database writes, run on the loop's worker
+    threads, and uploads are decrypted by the server's worker processes.
+
     Attributes:
-        conn (socket): The client connection object.
+        reader (asyncio.StreamReader): The stream the client's requests are read from.
+        writer (asyncio.StreamWriter): The stream the responses are written to.
         addr (tuple): The client address.
-        users (dict): Dictionary of users currently connected to the server.
-        lock (threading.Lock): Lock for thread-safe access to shared resources.
+        users (UserStore.UserStore): The registered users.
+        decryptors (concurrent.futures.Executor): The worker processes that decrypt uploads.
+        user (User.User): The user the client ID of this session's file uploads belongs to, once resolved.
+        uploads (dict): The uploads in progress on this session, by user name and file name.
     """
-    def __init__(self, conn, addr, users, lock):
+    def __init__(self, reader, writer, addr, users, decryptors):
         """
         Initializes a new ServerSession instance.
 
         Args:
-            conn (socket): The client connection object.
+            reader (asyncio.StreamReader): The stream the client's requests are read from.
+            writer (asyncio.StreamWriter): The stream the responses are written to.
             addr (tuple): The client address.
-            users (dict): Dictionary to store user sessions.
-            lock (threading.Lock): Lock for thread-safe access to shared resources.
+            users (UserStore.UserStore): The registered users.
+            decryptors (concurrent.futures.Executor): The worker processes that decrypt uploads.
         """
-        self.conn = conn
+        self.reader = reader
+        self.writer = writer
         self.addr = addr
         self.users = users
-        self.lock = lock
+        self.decryptors = decryptors
+        self.user = None
+        self.uploads = {}
 
-    def handle_session(self):
+    async def handle_session(self):
         """
         Manages the client session, receiving and processing requests until the connection is closed.
+
+        Uploads the client did not finish are removed when the session ends.
+        """
+        try:
+            await self._handle_requests()
+        finally:
+            for upload in self.uploads.values():
+                upload.abort()
+            self.uploads.clear()
+
+    async def _handle_requests(self):
+        """
+        Receives and processes requests until the connection is closed.
         """
         print(f"Connected by {self.addr}")
         while True:
-            raw_header_data = self._recv_all(Constants.Request.REQUEST_HEADER_SIZE)
+            raw_header_data = await self._recv_all(Constants.Request.REQUEST_HEADER_SIZE)
             if raw_header_data is None:
                 # Connection closed
                 print(f"Connection closed by {self.addr}")
@@ -57,24 +79,24 @@ class ServerSession:
             match code:
                 # request code 825
                 case Constants.Request.REGISTER_REQUEST:
-                    self._handle_register_request(request_header)
+                    await self._handle_register_request(request_header)
                 # request code 826
                 case Constants.Request.PUBLIC_KEY_SUBMISSION_REQUEST:
-                    self._handle_public_key_submission(request_header)
+                    await self._handle_public_key_submission(request_header)
                 # request code 827
                 case Constants.Request.RECONNECTION_REQUEST:
-                    self._handle_reconnection_request(request_header)
+                    await self._handle_reconnection_request(request_header)
                 # request code 828
                 case Constants.Request.FILE_UPLOAD_REQUEST:
-                    self._handle_file_upload_request(request_header)
+                    await self._handle_file_upload_request(request_header)
                 # request codes 900, 902
                 case Constants.Request.CRC_CONFIRMATION_REQUEST | Constants.Request.CRC_FAILURE_NOTIFICATION_REQUEST:
-                    self._handle_crc_confirmation(request_header)
+                    await self._handle_crc_confirmation(request_header)
                 # request code 901
                 case Constants.Request.RETRY_REQUEST:
                     pass
 
-    def _handle_register_request(self, request_header):
+    async def _handle_register_request(self, request_header):
         """
         Handles the client registration request.
 
@@ -85,20 +107,20 @@ class ServerSession:
               Constants.Constants.___ * "-")
 
         #  Receive the payload data
-        payload_data = self._receive_payload_data(request_header)
+        payload_data = await self._receive_payload_data(request_header)
         if payload_data is None:
-            self._send_general_failure(request_header)
+            await self._send_general_failure(request_header)
             return
 
         request_payload = Request.RequestPayload(payload_data, request_header.getCode(), request_header.getPayloadSize())
         print(request_header)
         print(request_payload)
 
-        if not self._register_user(request_payload.getUserName(), request_header):
-            self._send_register_failure(request_header)
+        if not await self._register_user(request_payload.getUserName(), request_header):
+            await self._send_register_failure(request_header)
             return
 
-    def _handle_public_key_submission(self, request_header):
+    async def _handle_public_key_submission(self, request_header):
         """
         Handles the client's submission of a public key for encryption.
 
@@ -106,9 +128,9 @@ class ServerSession:
             request_header (Request.RequestHeader): The request header from the client.
         """
         #  Receive the payload data
-        payload_data = self._receive_payload_data(request_header)
+        payload_data = await self._receive_payload_data(request_header)
         if payload_data is None:
-            self._send_general_failure(request_header)
+            await self._send_general_failure(request_header)
             return
 
         request_payload = Request.RequestPayload(payload_data, request_header.getCode(), request_header.getPayloadSize())
@@ -120,14 +142,14 @@ class ServerSession:
         public_key = request_payload.getPublicKey()
 
         # Store the public key in the user object
-        if not self._store_public_key(request_payload.getUserName(), public_key, request_header):
-            self._send_general_failure(request_header)
+        user = await self._store_public_key(request_payload.getUserName(), public_key, request_header)
+        if user is None:
+            return
 
         # Create and send AES key response
-        self._send_encrypted_aes_key(request_payload.getUserName(), public_key, request_header,
-                                     Constants.Response.PUBLIC_KEY_RESPONSE)
+        await self._send_encrypted_aes_key(user, request_header, Constants.Response.PUBLIC_KEY_RESPONSE)
 
-    def _handle_reconnection_request(self, request_header):
+    async def _handle_reconnection_request(self, request_header):
         """
         Handles the client reconnection request.
 
@@ -135,9 +157,9 @@ class ServerSession:
             request_header (Request.RequestHeader): The request header from the client.
         """
         #  Receive the payload data
-        payload_data = self._receive_payload_data(request_header)
+        payload_data = await self._receive_payload_data(request_header)
         if payload_data is None:
-            self._send_general_failure(request_header)
+            await self._send_general_failure(request_header)
             return
 
         request_payload = Request.RequestPayload(payload_data, request_header.getCode(), request_header.getPayloadSize())
@@ -148,18 +170,17 @@ class ServerSession:
         username = request_payload.getUserName()
 
         # check if the user is registered
-        with self.lock:
-            if username not in self.users:
-                # create _send_reconnection_failure - payload contain just client_id
-                self._send_reconnection_failure(request_header)
-                return
-            else:
-                # User found, use user's public key to encrypt the AES key and send it back
-                # create _send_encrypted_aes_key - payload contain client_id and symmetric key
-                self._send_encrypted_aes_key(username, self.users[username].getPublicKey(), request_header,
-                                             Constants.Response.RETRY_CONNECTION_SUCCESS)
-
-    def _handle_file_upload_request(self, request_header):
+        user = await asyncio.to_thread(self.users.getUser, username)
+        if user is None:
+            # create _send_reconnection_failure - payload contain just client_id
+            await self._send_reconnection_failure(request_header)
+            return
+        else:
+            # User found, use user's public key to encrypt the AES key and send it back
+            # create _send_encrypted_aes_key - payload contain client_id and symmetric key
+            await self._send_encrypted_aes_key(user, request_header, Constants.Response.RETRY_CONNECTION_SUCCESS)
+
+    async def _handle_file_upload_request(self, request_header):
         """
         Handles the client's file upload request.
 
@@ -167,17 +188,15 @@ class ServerSession:
             request_header (Request.RequestHeader): The request header from the client.
         """
         # Receive the payload data
-        payload_data = self._receive_payload_data(request_header)
+        payload_data = await self._receive_payload_data(request_header)
         if payload_data is None:
-            self._send_general_failure(request_header)
+            await self._send_general_failure(request_header)
             return
 
         # Parse the request payload
         request_payload = Request.RequestPayload(payload_data, request_header.getCode(), request_header.getPayloadSize())
-        username = self._find_username_by_uuid(request_header.getClientId())
-
         # Verify user and AES key
-        user, symmetric_key = self._get_user_and_key(username, request_header)
+        user, symmetric_key = await self._get_user_and_key(request_header)
         if user is None or symmetric_key is None:
             return
 
@@ -188,7 +207,12 @@ class ServerSession:
         encrypted_file_part = request_payload.getMessageContent()
         if encrypted_file_part is None:
             print(f'encrypted_file_part is None\npacket number: {packet_number}')
-        self._write_file_part(user, file_name, encrypted_file_part)
+        try:
+            upload = await self._write_file_part(user, file_name, request_payload)
+        except (ValueError, OSError) as e:
+            print(f"Upload of {file_name} failed: {e}")
+            await self._send_general_failure(request_header)
+            return
 
         if packet_number == 1:
             print(Constants.Constants.___ * "-" + f'\nReceiving file upload request from the client in {total_packets}'
@@ -196,13 +220,17 @@ class ServerSession:
             print(request_header)
             print(request_payload)
 
-        # If this is the last packet, process the file
-        if packet_number == total_packets:
-            # get thh content size of the entire file after encryption
-            encrypted_file_size = os.path.getsize(f"files/{user.getUserName()}/{file_name}.enc")
-            self._process_complete_file(user, file_name, symmetric_key, encrypted_file_size, request_header)
+        if upload is None:
+            # A client sending in order waits for an answer after its last packet
+            if packet_number >= total_packets:
+                await self._send_general_failure(request_header)
+            return
+
+        # Once every packet arrived, in whatever order, process the file
+        if upload.isComplete():
+            await self._process_complete_file(user, file_name, upload, request_header)
 
-    def _handle_crc_confirmation(self, request_header):
+    async def _handle_crc_confirmation(self, request_header):
         """
         Sends a CRC confirmation response to the client.
 
@@ -214,9 +242,9 @@ class ServerSession:
                                                   Constants.Response.CONFIRMATION_RESPONSE)
         response_payload = Response.ResponsePayload(request_header.getClientId())
         response = Response.Response(response_header, response_payload)
-        self.conn.send(response.toBytes())
+        await self._send(response.toBytes())
 
-    def _recv_all(self, size):
+    async def _recv_all(self, size):
         """
         Receives data from the client until the specified size is reached.
 
@@ -226,15 +254,22 @@ class ServerSession:
         Returns:
             bytes: The received data, or None if the connection is closed.
         """
-        data = b''
-        while len(data) < size:
-            packet = self.conn.recv(size - len(data))
-            if not packet:
-                return None  # Connection closed
-            data += packet
-        return data
+        try:
+            return await self.reader.readexactly(size)
+        except asyncio.IncompleteReadError:
+            return None  # Connection closed
 
-    def _send_general_failure(self, request_header):
+    async def _send(self, data):
+        """
+        Sends data to the client, waiting while the client is slower to receive than the server sends.
+
+        Args:
+            data (bytes): The data to send.
+        """
+        self.writer.write(data)
+        await self.writer.drain()
+
+    async def _send_general_failure(self, request_header):
         """
         Sends a general failure response to the client.
 
@@ -243,9 +278,9 @@ class ServerSession:
         """
         response_header = Response.ResponseHeader(request_header.getVersion(),
                                                   Constants.Response.GENERAL_FAILURE)
-        self.conn.send(response_header.toBytes())
+        await self._send(response_header.toBytes())
 
-    def _receive_payload_data(self, request_header):
+    async def _receive_payload_data(self, request_header):
         """
         Receives the payload data from the client based on the payload size in the header.
 
@@ -256,13 +291,13 @@ class ServerSession:
             bytes: The received payload data, or None if the connection is closed.
         """
         payload_size = request_header.getPayloadSize()
-        payload_data = self._recv_all(payload_size)
+        payload_data = await self._recv_all(payload_size)
         if payload_data is None:
             # Connection closed
             return None
         return payload_data
 
-    def _store_public_key(self, username, public_key, request_header):
+    async def _store_public_key(self, username, public_key, request_header):
         """
         Stores the client's public key for future communication.
 
@@ -272,24 +307,25 @@ class ServerSession:
             request_header (Request.RequestHeader): The request header from the client.
 
         Returns:
-            bool: True if successful, False otherwise.
-        """
-        with self.lock:
-            if username not in self.users:
-                # User not found, return error
-                self._send_general_failure(request_header)
-                return False
-            else:
-                self.users[username].setPublicKey(public_key)
-        return True
+            User.User: The user if successful, None otherwise.
+        """
+        user = await asyncio.to_thread(self.users.getUser, username)
+        if user is None:
+            # User not found, return error
+            await self._send_general_failure(request_header)
+            return None
+        await asyncio.to_thread(self.users.setPublicKey, user, public_key)
+        return user
 
-    def _send_encrypted_aes_key(self, username, public_key, request_header, code):
+    async def _send_encrypted_aes_key(self, user, request_header, code):
         """
-        Encrypts and sends an AES key to the client using the client's public key.
+        Encrypts and sends a new AES key to the client using the client's public key.
+
+        No lock is held: the key is encrypted and stored on worker threads, and replacing the user's symmetric key
+        is a single assignment.
 
         Args:
-            username (str): The username to whom the AES key is being sent.
-            public_key (str): The client's public key for encryption.
+            user (User.User): The user to whom the AES key is being sent.
             request_header (Request.RequestHeader): The request header from the client.
             code (int): The response code to use in the response.
         """
@@ -299,12 +335,9 @@ class ServerSession:
             # Generate a new AES key
             aes_key = get_random_bytes(Constants.Crypto.AES_KEY_SIZE)  # 32 bytes
             # Encrypt the AES key using the client's public key
-            rsa_key = RSA.import_key(public_key)
-            # Encrypt the AES key using RSA-OAEP
-            cipher_rsa = PKCS1_OAEP.new(rsa_key)
-            # Encrypt the AES key
-            encrypted_aes_key = cipher_rsa.encrypt(aes_key)
-            self.users[username].setSymmetricKey(aes_key)
+            encrypted_aes_key = await asyncio.to_thread(self._encrypt_aes_key, user.getPublicKey(), aes_key)
+            # Stored before the client learns it, since the client's other connections may reach another process
+            await asyncio.to_thread(self.users.setSymmetricKey, user, aes_key)
 
             encrypted_aes_key_size = len(encrypted_aes_key)
             response_header = Response.ResponseHeader(request_header.getVersion(), code)
@@ -315,12 +348,32 @@ class ServerSession:
             response_payload.setSymmetricKey(encrypted_aes_key)
             response = Response.Response(response_header, response_payload)
             print(response)
-            self.conn.send(response.toBytes())
+            await self._send(response.toBytes())
         except ValueError as e:
             print(f"Error encrypting AES key: {e}")
-            self._send_general_failure(request_header)
+            await self._send_general_failure(request_header)
 
-    def _register_user(self, username, request_header):
+    @staticmethod
+    def _encrypt_aes_key(public_key, aes_key):
+        """
+        Encrypts an AES key with a client's public key.
+
+        Args:
+            public_key (bytes): The client's public key.
+            aes_key (bytes): The AES key.
+
+        Returns:
+            bytes: The encrypted AES key.
+
+        Raises:
+            ValueError: If the public key is invalid.
+        """
+        rsa_key = RSA.import_key(public_key)
+        # Encrypt the AES key using RSA-OAEP
+        cipher_rsa = PKCS1_OAEP.new(rsa_key)
+        return cipher_rsa.encrypt(aes_key)
+
+    async def _register_user(self, username, request_header):
         """
         Registers a new user if the username is not already in use.
 
@@ -331,18 +384,14 @@ class ServerSession:
         Returns:
             bool: True if registration was successful, False if the username already exists.
         """
-        with self.lock:
-            if username in self.users:
-                return False
-            else:
-                # Register new user
-                generated_uuid = uuid.uuid4().hex
-                new_user = User.User(username, generated_uuid)
-                self.users[username] = new_user
-                self._send_register_success(generated_uuid, request_header)
-                return True
+        # Register new user
+        generated_uuid = uuid.uuid4().hex
+        if await asyncio.to_thread(self.users.addUser, username, generated_uuid) is None:
+            return False
+        await self._send_register_success(generated_uuid, request_header)
+        return True
 
-    def _send_register_failure(self, request_header):
+    async def _send_register_failure(self, request_header):
         """
         Sends a registration failure response to the client.
 
@@ -354,9 +403,9 @@ class ServerSession:
         print(Constants.Constants.___ * "-" + '\nSending registration failure response to the client\n' +
               Constants.Constants.___ * "-")
         print(response_header)
-        self.conn.send(response_header.toBytes())
+        await self._send(response_header.toBytes())
 
-    def _send_register_success(self, generated_uuid, request_header):
+    async def _send_register_success(self, generated_uuid, request_header):
         """
         Sends a registration success response with a generated UUID to the client.
 
@@ -371,9 +420,9 @@ class ServerSession:
         print(Constants.Constants.___ * "-" + '\nSending registration success response to the client\n' +
               Constants.Constants.___ * "-")
         print(response)
-        self.conn.send(response.toBytes())
+        await self._send(response.toBytes())
 
-    def _send_reconnection_failure(self, request_header):
+    async def _send_reconnection_failure(self, request_header):
         """
         Sends a reconnection failure response to the client if reconnection fails.
 
@@ -385,124 +434,157 @@ class ServerSession:
         response_payload = Response.ResponsePayload(request_header.getClientId())
         response = Response.Response(response_header, response_payload)
         print(response)
-        self.conn.send(response.toBytes())
+        await self._send(response.toBytes())
 
-    def _get_user_and_key(self, username, request_header):
+    async def _get_user_and_key(self, request_header):
         """
-        Retrieves the user and symmetric key based on the username.
+        Retrieves the user of the request's client ID and its symmetric key.
+
+        The user is looked up once and kept for the rest of the session, while its symmetric key is read on
+        every request since a reconnection replaces it.
 
         Args:
-            username (str): The name of the user to retrieve.
             request_header (Request.RequestHeader): The request header containing the client's information.
 
         Returns:
             tuple: A tuple containing the user object and the symmetric key, or (None, None) if not found.
         """
-        with self.lock:
-            if username not in self.users:
-                # User not found, send error
-                self._send_general_failure(request_header)
-                return None, None
+        user = await self._find_user_by_uuid(request_header.getClientId())
+        if user is None:
+            # User not found, send error
+            await self._send_general_failure(request_header)
+            return None, None
 
-            user = self.users[username]
-            symmetric_key = user.getSymmetricKey()
-            if not symmetric_key:
-                # AES key not found, send error
-                self._send_general_failure(request_header)
-                return None, None
+        symmetric_key = user.getSymmetricKey()
+        if not symmetric_key:
+            # AES key not found, send error
+            await self._send_general_failure(request_header)
+            return None, None
 
         return user, symmetric_key
 
-    def _write_file_part(self, user, file_name, encrypted_file_part):
+    async def _write_file_part(self, user, file_name, request_payload):
         """
-        Writes a part of an encrypted file received from the client to the user's file directory.
+        Writes a part of an encrypted file received from the client to its upload, which decrypts it into the
+        user's file directory.
 
-        Args:
-            user (User.User): The user object representing the client.
-            file_name (str): The name of the file to write.
-            encrypted_file_part (bytes): The encrypted file part to be written.
-        """
-        # Create user directory if it doesn't exist
-        user_directory = f"files/{user.getUserName()}"
-        if not os.path.exists(user_directory):
-            os.makedirs(user_directory)
-
-        encrypted_file_path = f"{user_directory}/{file_name}.enc"
-        # Append the encrypted file part to the file
-        with open(encrypted_file_path, 'ab') as f:
-            f.write(encrypted_file_part)
+        Packets may arrive in any order and more than once, each is written at the offset its number gives. The
+        first packet of a file to arrive creates its upload, which keeps the part files until the file is
+        complete; a packet announcing another size than the upload in progress starts the file over. An invalid
+        packet is dropped, as is a file name that leads out of the user's file directory.
 
-    def _process_complete_file(self, user, file_name, symmetric_key, content_size, request_header):
-        """
-        Processes the complete encrypted file after all parts are received, decrypts it, and calculates the CRC value.
+        A new upload takes the symmetric key last issued to the user from the store rather than the one this
+        process has, since the client may have reconnected to another server process since. The key is read
+        again for the first packet of an upload in progress, which a client that reconnected sends again under
+        its new key, and the upload starts over if the key changed.
 
         Args:
             user (User.User): The user object representing the client.
-            file_name (str): The name of the encrypted file.
-            symmetric_key (bytes): The symmetric key used to decrypt the file.
-            content_size (int): The size of the encrypted content.
-            request_header (Request.RequestHeader): The request header containing the client's information.
-        """
-        user_directory = f"files/{user.getUserName()}"
-        encrypted_file_path = f"{user_directory}/{file_name}.enc"
-        decrypted_file_path = f"{user_directory}/{file_name}"
-
-        print(Constants.Constants.___ * "-" + f'\nDecrypting the encrypted received file - {file_name}\n' +
-              Constants.Constants.___ * "-")
-
-        # Decrypt the file
-        try:
-            decrypted_data = self._decrypt_file(encrypted_file_path, symmetric_key)
-            with open(decrypted_file_path, 'wb') as dec_file:
-                dec_file.write(decrypted_data)
-        except Exception as e:
-            print(f"Decryption failed: {e}")
-            self._send_general_failure(request_header)
-            return
+            file_name (str): The name of the file to write.
+            request_payload (Request.RequestPayload): The file upload request with the encrypted file part.
 
-        print(Constants.Constants.___ * "-" + f'\nCalculating CRC value of the decrypted file - {file_name}\n'
-              + Constants.Constants.___ * "-")
+        Returns:
+            Upload.Upload: The upload of the file, or None if the packet was dropped.
 
-        # Calculate the CRC value of the decrypted file
-        crc_value = cksum.memcrc(decrypted_data)
+        Raises:
+            ValueError: If decrypting a segment of the file failed.
+            OSError: If the files of the upload cannot be written.
+            In both cases the upload was aborted.
+        """
+        key = (user.getUserName(), file_name)
+        upload = self.uploads.get(key)
+        symmetric_key = None
+        if upload is None or request_payload.getPacketNumber() == 1:
+            symmetric_key = await asyncio.to_thread(self.users.loadSymmetricKey, user)
+        if upload is not None and (not upload.matches(request_payload.getContentSize(),
+                                                      request_payload.getTotalPackets())
+                                   or symmetric_key not in (None, upload.symmetric_key)):
+            upload.abort()  # the client started another version of the file over, or the same under a new key
+            del self.uploads[key]
+            upload = None
 
-        # Send the response
-        self._send_file_upload_response(user, file_name, content_size, crc_value, request_header)
+        try:
+            if upload is None:
+                if symmetric_key is None:
+                    symmetric_key = await asyncio.to_thread(self.users.loadSymmetricKey, user)
+                if not symmetric_key:
+                    raise ValueError("no symmetric key was issued to the user")
+                upload = Upload.Upload(self._upload_path(user, file_name), symmetric_key,
+                                       request_payload.getContentSize(), request_payload.getOrigFileSize(),
+                                       request_payload.getTotalPackets(), self.decryptors)
+                self.uploads[key] = upload
+            upload.write(request_payload.getPacketNumber(), request_payload.getMessageContent())
+        except ValueError as e:
+            print(f"Dropping packet {request_payload.getPacketNumber()} of {file_name}: {e}")
+            return None
+        except OSError:
+            if upload is not None:
+                upload.abort()
+                del self.uploads[key]
+            raise
 
-        # Clean up the encrypted file
-        os.remove(encrypted_file_path)
+        try:
+            upload.advance()
+        except (ValueError, OSError):
+            # A failed segment fails the upload, whichever packets follow
+            upload.abort()
+            del self.uploads[key]
+            raise
+        return upload
 
-    def _decrypt_file(self, encrypted_file_path, symmetric_key):
+    @staticmethod
+    def _upload_path(user, file_name):
         """
-        Decrypts the encrypted file using AES in CBC mode with the provided symmetric key.
+        Returns the path a file of a user is uploaded to, under the user's file directory.
 
         Args:
-            encrypted_file_path (str): The path to the encrypted file.
-            symmetric_key (bytes): The symmetric key used for decryption.
+            user (User.User): The user object representing the client.
+            file_name (str): The name of the file, which may contain sub directories.
 
         Returns:
-            bytes: The decrypted file data.
+            str: The path of the file.
 
         Raises:
-            ValueError: If unpadding the decrypted data fails.
+            ValueError: If the name is absolute or leads out of the user's file directory.
         """
-        with open(encrypted_file_path, 'rb') as enc_file:
-            encrypted_data = enc_file.read()
+        files_directory = os.path.abspath('files')
+        user_directory = os.path.abspath(os.path.join(files_directory, user.getUserName()))
+        # An absolute name replaces the directory it is joined to, and '..' components climb out of it
+        path = os.path.abspath(os.path.join(user_directory, file_name))
+        if (os.path.dirname(user_directory) != files_directory
+                or os.path.commonpath([user_directory, path]) != user_directory or path == user_directory):
+            raise ValueError(f"the file name {file_name!r} leads out of the user's file directory")
+        return path
 
-        # Initialize the AES cipher with CBC mode and a 16-byte IV
-        cipher = AES.new(symmetric_key, AES.MODE_CBC, iv=bytes(16))
-        decrypted_data = cipher.decrypt(encrypted_data)
+    async def _process_complete_file(self, user, file_name, upload, request_header):
+        """
+        Completes an upload after its last packet was decrypted and sends the CRC value of the file to the client.
 
-        # Remove padding using the unpad function
+        Args:
+            user (User.User): The user object representing the client.
+            file_name (str): The name of the file.
+            upload (Upload.Upload): The upload of the file.
+            request_header (Request.RequestHeader): The request header containing the client's information.
+        """
+        print(Constants.Constants.___ * "-" + f'\nCompleting the decrypted received file - {file_name}\n' +
+              Constants.Constants.___ * "-")
+
+        # The upload stays among the session's uploads until it is finished, so that the session's cleanup removes
+        # its files if the session is cancelled meanwhile
         try:
-            decrypted_data = unpad(decrypted_data, AES.block_size)
-        except ValueError as e:
-            print(f"Error while unpadding: {e}")
-            raise
+            crc_value = await upload.finish()
+        except Exception as e:
+            print(f"Decryption failed: {e}")
+            upload.abort()
+            del self.uploads[(user.getUserName(), file_name)]
+            await self._send_general_failure(request_header)
+            return
+        del self.uploads[(user.getUserName(), file_name)]
 
-        return decrypted_data
+        # Send the response
+        await self._send_file_upload_response(user, file_name, upload.getReceivedSize(), crc_value, request_header)
 
-    def _send_file_upload_response(self, user, file_name, content_size, crc_value, request_header):
+    async def _send_file_upload_response(self, user, file_name, content_size, crc_value, request_header):
         """
         Sends a file upload response to the client, including the CRC value of the decrypted file.
 
@@ -525,19 +607,23 @@ class ServerSession:
               Constants.Constants.___ * "-")
         print(response)
         data_to_send = response.toBytes()
-        self.conn.send(data_to_send)
+        await self._send(data_to_send)
 
-    def _find_username_by_uuid(self, uuid):
+    async def _find_user_by_uuid(self, uuid):
         """
-        Finds the username associated with a given UUID.
+        Finds the user associated with a given UUID, keeping it for the later requests of the session.
+
+        The user's symmetric key is read from the store when the user is resolved, since it may have been issued
+        by another server process.
 
         Args:
             uuid (str): The UUID to search for.
 
         Returns:
-            str: The username associated with the UUID, or None if not found.
+            User.User: The user associated with the UUID, or None if not found.
         """
-        for username, user in self.users.items():
-            if user.getUuid() == uuid:
-                return username
-        return None
+        if self.user is None or self.user.getUuid() != uuid:
+            self.user = await asyncio.to_thread(self.users.getUserByClientId, uuid)
+            if self.user is not None:
+                await asyncio.to_thread(self.users.loadSymmetricKey, self.user)
+        return self.user
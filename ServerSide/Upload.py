@@ -0,0 +1,325 @@
+import asyncio
+import os
+
+import cksum
+import Constants
+
+from Crypto.Cipher import AES
+from Crypto.Util.Padding import unpad
+
+
+def decrypt_segment(spool_path, part_path, symmetric_key, start, end, crc_state, crc_length, final_path=None):
+    """
+    Decrypts a segment of a spooled encrypted file into the part file at the same offset, and adds it to the
+    checksum of the decrypted file.
+
+    Runs in a worker process, so it takes and returns paths and numbers rather than the contents of the file. The
+    segment is read, decrypted and written in pieces of Constants.Files.DECRYPT_SEGMENT_SIZE bytes, so a worker
+    holds no more of the file than that however long the segment is.
+
+    Args:
+        spool_path (str): The path of the encrypted file received so far.
+        part_path (str): The path of the decrypted file.
+        symmetric_key (bytes): The symmetric key the file is encrypted with.
+        start (int): The offset of the segment, a multiple of the AES block size.
+        end (int): The end of the segment, a multiple of the AES block size.
+        crc_state (int): The state of the checksum of the decrypted bytes before the segment.
+        crc_length (int): The number of decrypted bytes before the segment.
+        final_path (str, optional): For the last segment of the file, the path the decrypted file is moved to once
+            the segment is unpadded. Defaults to None.
+
+    Returns:
+        tuple: The state and the length of the checksum after the segment.
+
+    Raises:
+        ValueError: If the segment is the last one and its padding is invalid.
+        OSError: If a file cannot be read or written.
+    """
+    crc = cksum.Cksum(crc_state, crc_length)
+    # The part file is not created if missing: the upload was aborted while the segment was decrypted
+    with open(spool_path, 'rb') as spool, open(part_path, 'r+b') as part:
+        # The block before the segment is the IV that continues the CBC chain
+        if start > 0:
+            spool.seek(start - AES.block_size)
+            iv = spool.read(AES.block_size)
+        else:
+            iv = bytes(AES.block_size)
+        cipher = AES.new(symmetric_key, AES.MODE_CBC, iv=iv)
+
+        # However long the segment, only one piece of it is held in memory at a time
+        offset = start
+        part.seek(start)
+        while offset < end:
+            size = min(Constants.Files.DECRYPT_SEGMENT_SIZE, end - offset)
+            plain = cipher.decrypt(spool.read(size))
+            offset += size
+            if final_path is not None and offset == end:
+                plain = unpad(plain, AES.block_size)
+            crc.update(plain)
+            part.write(plain)
+        if final_path is not None:
+            # Cut off any preallocated space that was not written
+            part.truncate(part.tell())
+    if final_path is not None:
+        os.replace(part_path, final_path)
+        os.remove(spool_path)
+    return crc.state, crc.length
+
+
+class Upload:
+    """
+    This class represents a file upload in progress on one session, decrypted and checksummed in segments by
+    worker processes while its packets arrive.
+
+    Packets may arrive in any order and more than once. Each is written to a spool file, preallocated to the
+    encrypted size, at the offset its packet number gives, with adjacent packets written together through a
+    buffer, and a bitmap of the packets received tells when the file is complete, so a packet sent again only
+    overwrites its own bytes. Since each CBC block needs the one before it, only the packets received without a
+    gap from the first are decrypted: whenever that prefix grows by a segment of Constants.Files.DECRYPT_SEGMENT_SIZE
+    bytes and the upload has no segment in progress, the next segment is handed to a worker process, which reads it
+    from the spool, decrypts it and writes it to the part file, preallocated to the original size where the
+    platform supports it. Segments of one upload are decrypted in order, since each continues the checksum of the
+    one before, while the segments of different uploads are decrypted in parallel. The last block of the file is
+    held back until every packet arrived, because it carries the padding; finishing the upload decrypts the rest,
+    unpads it, and moves the part file into place.
+
+    Attributes:
+        path (str): The path of the decrypted file.
+        part_path (str): The path the decrypted file is written to until it is complete.
+        spool_path (str): The path the encrypted file is written to until it is decrypted.
+        symmetric_key (bytes): The symmetric key the file is encrypted with.
+        content_size (int): The encrypted size the client announced.
+        total_packets (int): The number of packets the client announced.
+        decryptors (concurrent.futures.Executor): The worker processes that decrypt the segments.
+        received (int): The number of distinct encrypted bytes received so far.
+        received_packets (int): The number of distinct packets received so far.
+        packets (bytearray): The bitmap of the packets received, bit i of byte i // 8 for packet i + 1.
+        contiguous (int): The number of packets received without a gap from the first.
+        dispatched (int): The number of encrypted bytes handed to the workers so far.
+        spool (int): The file descriptor of the open spool file.
+        buffer (bytearray): The adjacent packets not yet written to the spool file.
+        buffer_offset (int): The offset in the spool file the buffer is written to.
+        job (asyncio.Future): The segment in progress, or the last one handed to the workers.
+        crc (tuple): The state and the length of the checksum of the segments decrypted so far.
+    """
+    def __init__(self, path, symmetric_key, content_size, orig_file_size, total_packets, decryptors):
+        """
+        Creates the part file and the spool file of an upload.
+
+        Args:
+            path (str): The path of the decrypted file.
+            symmetric_key (bytes): The symmetric key the file is encrypted with.
+            content_size (int): The encrypted size the client announced.
+            orig_file_size (int): The decrypted size the client announced.
+            total_packets (int): The number of packets the client announced.
+            decryptors (concurrent.futures.Executor): The worker processes that decrypt the segments.
+
+        Raises:
+            ValueError: If the encrypted size is not whole blocks, does not take the number of packets announced, or
+                is not the padded decrypted size.
+            OSError: If the files cannot be created.
+        """
+        if content_size <= 0 or content_size % AES.block_size != 0:
+            raise ValueError(f"the encrypted file of {content_size} bytes is not a whole number of blocks")
+        if total_packets != -(-content_size // Constants.Request.MESSAGE_CONTENT_SIZE):
+            raise ValueError(f"an encrypted file of {content_size} bytes does not take {total_packets} packets")
+        # Checked before the part file is preallocated to the decrypted size, which would otherwise reserve
+        # whatever size the client claims
+        if content_size != (orig_file_size // AES.block_size + 1) * AES.block_size:
+            raise ValueError(f"a file of {orig_file_size} bytes does not encrypt to {content_size} bytes")
+
+        self.path = path
+        self.part_path = path + Constants.Files.PART_SUFFIX
+        self.spool_path = path + Constants.Files.SPOOL_SUFFIX
+        self.symmetric_key = symmetric_key
+        self.content_size = content_size
+        self.total_packets = total_packets
+        self.decryptors = decryptors
+        self.received = 0
+        self.received_packets = 0
+        self.packets = bytearray((total_packets + 7) // 8)
+        self.contiguous = 0
+        self.dispatched = 0
+        self.buffer = bytearray()
+        self.buffer_offset = 0
+        self.job = None
+        self.crc = (0, 0)
+
+        # Several connections of the same user may get here at once, so an existing directory is not an error
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(self.part_path, 'wb') as part:
+            self._preallocate(part.fileno(), orig_file_size)
+        self.spool = os.open(self.spool_path, os.O_RDWR | os.O_CREAT | os.O_TRUNC | getattr(os, 'O_BINARY', 0))
+        self._preallocate(self.spool, content_size)
+
+    def matches(self, content_size, total_packets):
+        """
+        Tells whether a packet announces the same file as this upload.
+
+        Args:
+            content_size (int): The encrypted size the packet announces.
+            total_packets (int): The number of packets the packet announces.
+
+        Returns:
+            bool: True if the packet belongs to this upload, False if the client started another version of the file.
+        """
+        return content_size == self.content_size and total_packets == self.total_packets
+
+    def write(self, packet_number, part):
+        """
+        Spools a packet of the encrypted file at its offset. An invalid packet changes nothing.
+
+        Args:
+            packet_number (int): The number of the packet, from 1.
+            part (bytes): The encrypted file part.
+
+        Raises:
+            ValueError: If the packet number is out of range or the part is shorter than its packet.
+            OSError: If spooling the part failed.
+        """
+        if not 1 <= packet_number <= self.total_packets:
+            raise ValueError(f"packet {packet_number} is not one of the {self.total_packets} packets of the file")
+        offset = (packet_number - 1) * Constants.Request.MESSAGE_CONTENT_SIZE
+        size = min(Constants.Request.MESSAGE_CONTENT_SIZE, self.content_size - offset)
+        if len(part) < size:
+            raise ValueError(f"packet {packet_number} has {len(part)} bytes instead of {size}")
+        self._spool(offset, memoryview(part)[:size])
+
+        index, bit = divmod(packet_number - 1, 8)
+        if self.packets[index] & (1 << bit):
+            return  # sent again, the same bytes were written over
+        self.packets[index] |= 1 << bit
+        self.received_packets += 1
+        self.received += size
+        while self.contiguous < self.total_packets and self.packets[self.contiguous // 8] & (1 << self.contiguous % 8):
+            self.contiguous += 1
+
+    def advance(self):
+        """
+        Hands the next segment to the workers once the packets without a gap from the first complete it and the
+        previous segment is done.
+
+        Raises:
+            ValueError: If decrypting the previous segment failed.
+            OSError: If writing out the spooled packets or decrypting the previous segment failed.
+        """
+        if self.job is not None and not self.job.done():
+            return
+        if self.contiguous == self.total_packets:
+            return  # the last block is decrypted by finish
+        # The prefix does not reach the last packet, so it does not hold the padded block either
+        ready = self.contiguous * Constants.Request.MESSAGE_CONTENT_SIZE // AES.block_size * AES.block_size
+        if ready - self.dispatched >= Constants.Files.DECRYPT_SEGMENT_SIZE:
+            self._flush()
+            self._dispatch(ready)
+
+    def isComplete(self):
+        """Returns True if every packet of the file was received."""
+        return self.received_packets == self.total_packets
+
+    async def finish(self):
+        """
+        Decrypts the rest of the file once every packet was received, unpads it, and moves the decrypted file into
+        place.
+
+        Returns:
+            int: The CRC of the decrypted file.
+
+        Raises:
+            ValueError: If the padding is invalid.
+            OSError: If the files cannot be read or written.
+        """
+        self._flush()
+        os.close(self.spool)
+        self.spool = None
+        if self.job is not None:
+            await self.job
+        self._dispatch(self.content_size, self.path)
+        self.crc = await self.job
+        self.job = None
+        return cksum.Cksum(*self.crc).digest()
+
+    def getReceivedSize(self):
+        """Returns the number of distinct encrypted bytes received so far."""
+        return self.received
+
+    def abort(self):
+        """
+        Closes and removes the files of an upload that will not complete.
+        """
+        # A segment already being decrypted fails on the removed part file, or writes to it unlinked
+        if self.job is not None and not self.job.cancel() and not self.job.cancelled():
+            self.job.exception()  # already done, retrieved so that a failure is not reported as unhandled
+        if self.spool is not None:
+            os.close(self.spool)
+            self.spool = None
+        for path in (self.spool_path, self.part_path):
+            try:
+                os.remove(path)
+            except FileNotFoundError:
+                pass
+
+    def _spool(self, offset, data):
+        """
+        Buffers encrypted bytes for the spool file, writing the buffer out first if they do not follow it.
+
+        Args:
+            offset (int): The offset of the bytes in the encrypted file.
+            data (memoryview): The bytes.
+        """
+        if self.buffer and offset != self.buffer_offset + len(self.buffer):
+            self._flush()
+        if not self.buffer:
+            self.buffer_offset = offset
+        self.buffer += data
+        if len(self.buffer) >= Constants.Files.WRITE_BUFFER_SIZE:
+            self._flush()
+
+    def _flush(self):
+        """
+        Writes the buffered bytes to the spool file at their offset.
+        """
+        written = 0
+        with memoryview(self.buffer) as data:
+            while written < len(data):
+                offset = self.buffer_offset + written
+                if hasattr(os, 'pwrite'):
+                    written += os.pwrite(self.spool, data[written:], offset)
+                else:
+                    os.lseek(self.spool, offset, os.SEEK_SET)
+                    written += os.write(self.spool, data[written:])
+        self.buffer.clear()
+
+    @staticmethod
+    def _preallocate(fd, size):
+        """
+        Preallocates a file to its final size, where the platform supports it.
+
+        Args:
+            fd (int): The file descriptor of the file.
+            size (int): The size.
+        """
+        if size > 0 and hasattr(os, 'posix_fallocate'):
+            try:
+                os.posix_fallocate(fd, 0, size)
+            except OSError:
+                pass  # not supported by the file system; the file grows as it is written instead
+
+    def _dispatch(self, end, final_path=None):
+        """
+        Hands the spooled bytes up to the given offset to the workers, after the previous segment.
+
+        Args:
+            end (int): The end of the segment, a multiple of the AES block size.
+            final_path (str, optional): For the last segment, the path the decrypted file is moved to.
+
+        Raises:
+            ValueError: If decrypting the previous segment failed.
+            OSError: If decrypting the previous segment failed.
+        """
+        if self.job is not None:
+            self.crc = self.job.result()
+        self.job = asyncio.get_running_loop().run_in_executor(
+            self.decryptors, decrypt_segment, self.spool_path, self.part_path, self.symmetric_key, self.dispatched,
+            end, *self.crc, final_path)
+        self.dispatched = end
@@ -0,0 +1,218 @@
+import sqlite3
+import threading
+
+import Constants
+import User
+
+
+class UserStore:
+    """
+    This class represents the registered users, kept in an SQLite database so that they survive a restart of the
+    server, with the users already looked up cached in memory.
+
+    Users are read from the database the first time they are looked up rather than all at startup, so a restart
+    costs nothing until clients come back, and a reconnecting client costs one indexed query. The database is
+    also how several server processes share their users: a user is cached without its public key only until it
+    is read again, and the symmetric key issued by one process is read by a session of another through
+    loadSymmetricKey.
+
+    The caches are split into Constants.Server.USER_SHARDS shards by the hash of their key, each under its own
+    lock, and every thread has its own connection to the database, which is in write-ahead log mode. So lookups
+    of different users neither wait for each other nor for a registration being written, and no lock is held
+    while the database is queried. Each user has a single User object, the one in the cache by name.
+
+    Attributes:
+        path (str): The path of the database file.
+        connections (threading.local): The connection of each thread to the database.
+        locks (list): The lock of each shard.
+        users (list): The users looked up so far by user name, a dictionary per shard.
+        clients (list): The same users by client ID, a dictionary per shard.
+    """
+    def __init__(self, path):
+        """
+        Opens the database of users, creating it if it does not exist.
+
+        Args:
+            path (str): The path of the database file.
+
+        Raises:
+            sqlite3.Error: If the database cannot be opened.
+        """
+        self.path = path
+        self.connections = threading.local()
+        self.locks = [threading.Lock() for _ in range(Constants.Server.USER_SHARDS)]
+        self.users = [{} for _ in range(Constants.Server.USER_SHARDS)]
+        self.clients = [{} for _ in range(Constants.Server.USER_SHARDS)]
+
+        connection = self._connection()
+        # Kept in the database file, so it applies to the connections of all threads
+        connection.execute('PRAGMA journal_mode=WAL')
+        connection.execute('CREATE TABLE IF NOT EXISTS users ('
+                           'user_name TEXT PRIMARY KEY, '
+                           'client_id TEXT NOT NULL UNIQUE, '
+                           'public_key BLOB, '
+                           'symmetric_key BLOB)')
+        columns = [row[1] for row in connection.execute('PRAGMA table_info(users)')]
+        if 'symmetric_key' not in columns:
+            # A database of a server that kept the symmetric keys in memory only
+            connection.execute('ALTER TABLE users ADD COLUMN symmetric_key BLOB')
+
+    def getUser(self, user_name):
+        """
+        Returns the user with the given name.
+
+        Args:
+            user_name (str): The name of the user.
+
+        Returns:
+            User.User: The user, or None if no user has the name.
+        """
+        shard = self._shard(user_name)
+        with self.locks[shard]:
+            user = self.users[shard].get(user_name)
+        # Without a public key, the user may have submitted it since to another server process
+        if user is None or user.getPublicKey() is None:
+            user = self._load('user_name', user_name)
+        return user
+
+    def getUserByClientId(self, client_id):
+        """
+        Returns the user with the given client ID.
+
+        Args:
+            client_id (str): The client ID of the user, as hex digits.
+
+        Returns:
+            User.User: The user, or None if no user has the client ID.
+        """
+        shard = self._shard(client_id)
+        with self.locks[shard]:
+            user = self.clients[shard].get(client_id)
+        if user is None:
+            user = self._load('client_id', client_id)
+        return user
+
+    def addUser(self, user_name, client_id):
+        """
+        Registers a new user.
+
+        Args:
+            user_name (str): The name of the user.
+            client_id (str): The client ID generated for the user, as hex digits.
+
+        Returns:
+            User.User: The new user, or None if the name is already registered.
+        """
+        try:
+            self._connection().execute('INSERT INTO users (user_name, client_id) VALUES (?, ?)',
+                                       (user_name, client_id))
+        except sqlite3.IntegrityError:
+            return None
+        return self._cache(User.User(user_name, client_id))
+
+    def setPublicKey(self, user, public_key):
+        """
+        Sets and stores the public key of a user.
+
+        Args:
+            user (User.User): The user.
+            public_key (bytes): The public key.
+        """
+        self._connection().execute('UPDATE users SET public_key = ? WHERE user_name = ?',
+                                   (public_key, user.getUserName()))
+        user.setPublicKey(public_key)
+
+    def setSymmetricKey(self, user, symmetric_key):
+        """
+        Sets and stores the symmetric key issued to a user.
+
+        Args:
+            user (User.User): The user.
+            symmetric_key (bytes): The symmetric key.
+        """
+        self._connection().execute('UPDATE users SET symmetric_key = ? WHERE user_name = ?',
+                                   (symmetric_key, user.getUserName()))
+        user.setSymmetricKey(symmetric_key)
+
+    def loadSymmetricKey(self, user):
+        """
+        Reads the symmetric key last issued to a user, by any server process, into the user.
+
+        Args:
+            user (User.User): The user.
+
+        Returns:
+            bytes: The symmetric key, or None if none was issued.
+        """
+        row = self._connection().execute('SELECT symmetric_key FROM users WHERE user_name = ?',
+                                         (user.getUserName(),)).fetchone()
+        if row is not None:
+            user.setSymmetricKey(row[0])
+        return user.getSymmetricKey()
+
+    def _connection(self):
+        """
+        Returns the calling thread's connection to the database, opening it on first use.
+
+        Returns:
+            sqlite3.Connection: The connection.
+        """
+        connection = getattr(self.connections, 'connection', None)
+        if connection is None:
+            # Autocommit, each registration is its own transaction
+            connection = sqlite3.connect(self.path, isolation_level=None)
+            # In WAL mode this is still safe against a crash of the server, only a power loss may lose the last writes
+            connection.execute('PRAGMA synchronous=NORMAL')
+            self.connections.connection = connection
+        return connection
+
+    def _shard(self, key):
+        """
+        Returns the shard of the caches a key belongs to.
+
+        Args:
+            key (str): A user name or a client ID.
+
+        Returns:
+            int: The index of the shard.
+        """
+        return hash(key) % Constants.Server.USER_SHARDS
+
+    def _load(self, column, value):
+        """
+        Reads a user from the database into the caches.
+
+        Args:
+            column (str): The column to look the user up by, 'user_name' or 'client_id'.
+            value (str): The value of the column.
+
+        Returns:
+            User.User: The user, or None if not found.
+        """
+        row = self._connection().execute(f'SELECT user_name, client_id, public_key, symmetric_key FROM users '
+                                         f'WHERE {column} = ?', (value,)).fetchone()
+        if row is None:
+            return None
+        return self._cache(User.User(row[0], row[1], row[2], row[3]))
+
+    def _cache(self, user):
+        """
+        Adds a user to the caches, unless another thread cached the same user first, in which case the cached user
+        takes the public key read from the database if it had none.
+
+        Args:
+            user (User.User): The user.
+
+        Returns:
+            User.User: The user in the caches, which the caller must use instead of its own.
+        """
+        shard = self._shard(user.getUserName())
+        with self.locks[shard]:
+            cached = self.users[shard].setdefault(user.getUserName(), user)
+        if cached is not user and cached.getPublicKey() is None:
+            cached.setPublicKey(user.getPublicKey())
+        user = cached
+        shard = self._shard(user.getUuid())
+        with self.locks[shard]:
+            self.clients[shard].setdefault(user.getUuid(), user)
+        return user
@@ -0,0 +1,124 @@
+// Native implementation of the cksum module, built from the client's CRC_Calculator so that the server and
+// the client checksum files with the same tables and kernel. Build it with `python setup.py build_ext --inplace`;
+// cksum.py uses it when it is importable and falls back to the pure Python code otherwise.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+
+#include "CRC_Calculator.h"
+
+namespace {
+
+    /**
+     * @brief Runs the CRC kernel over a buffer without holding the GIL.
+     *
+     * @param state The running state.
+     * @param buffer The bytes.
+     * @return The state after the bytes.
+     */
+    unsigned long update(unsigned long state, const Py_buffer& buffer) {
+        Py_BEGIN_ALLOW_THREADS
+        state = CRC_Calculator::update(state, static_cast<const char*>(buffer.buf), static_cast<size_t>(buffer.len));
+        Py_END_ALLOW_THREADS
+        return state;
+    }
+
+    /// A running checksum, the native counterpart of cksum.Cksum.
+    struct CksumObject {
+        PyObject_HEAD
+        unsigned long state;    ///< The running CRC, before the length is folded in.
+        unsigned long long length; ///< The number of bytes so far.
+    };
+
+    int Cksum_init(CksumObject* self, PyObject* args, PyObject* kwargs) {
+        static const char* keywords[] = { "state", "length", nullptr };
+        self->state = 0;
+        self->length = 0;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|kK:Cksum", const_cast<char**>(keywords), &self->state, &self->length)) {
+            return -1;
+        }
+        return 0;
+    }
+
+    PyObject* Cksum_update(CksumObject* self, PyObject* args) {
+        Py_buffer buffer;
+        if (!PyArg_ParseTuple(args, "y*:update", &buffer)) {
+            return nullptr;
+        }
+        self->state = update(self->state, buffer);
+        self->length += static_cast<unsigned long long>(buffer.len);
+        PyBuffer_Release(&buffer);
+        Py_RETURN_NONE;
+    }
+
+    PyObject* Cksum_digest(CksumObject* self, PyObject*) {
+        return PyLong_FromUnsignedLong(CRC_Calculator::finish(self->state, self->length));
+    }
+
+    PyObject* memcrc(PyObject*, PyObject* args) {
+        Py_buffer buffer;
+        if (!PyArg_ParseTuple(args, "y*:memcrc", &buffer)) {
+            return nullptr;
+        }
+        unsigned long state = update(0, buffer);
+        unsigned long long length = static_cast<unsigned long long>(buffer.len);
+        PyBuffer_Release(&buffer);
+        return PyLong_FromUnsignedLong(CRC_Calculator::finish(state, length));
+    }
+
+    PyMethodDef CksumMethods[] = {
+        { "update", reinterpret_cast<PyCFunction>(Cksum_update), METH_VARARGS, "Adds the next bytes to the checksum." },
+        { "digest", reinterpret_cast<PyCFunction>(Cksum_digest), METH_NOARGS, "Returns the checksum of the bytes so far." },
+        { nullptr, nullptr, 0, nullptr }
+    };
+
+    PyMemberDef CksumMembers[] = {
+        { "state", T_ULONG, offsetof(CksumObject, state), READONLY, "The running CRC, before the length is folded in." },
+        { "length", T_ULONGLONG, offsetof(CksumObject, length), READONLY, "The number of bytes so far." },
+        { nullptr, 0, 0, 0, nullptr }
+    };
+
+    PyTypeObject CksumType = {
+        PyVarObject_HEAD_INIT(nullptr, 0)
+        "_cksum.Cksum",
+    };
+
+    PyMethodDef ModuleMethods[] = {
+        { "memcrc", memcrc, METH_VARARGS, "Calculates the cksum CRC of a bytes-like object." },
+        { nullptr, nullptr, 0, nullptr }
+    };
+
+    PyModuleDef Module = {
+        PyModuleDef_HEAD_INIT,
+        "_cksum",
+        "Native POSIX cksum CRC, sharing the client's CRC_Calculator.",
+        -1,
+        ModuleMethods,
+    };
+}
+
+PyMODINIT_FUNC PyInit__cksum() {
+    CksumType.tp_basicsize = sizeof(CksumObject);
+    CksumType.tp_flags = Py_TPFLAGS_DEFAULT;
+    CksumType.tp_doc = "A running cksum CRC over bytes that arrive in parts.";
+    CksumType.tp_new = PyType_GenericNew;
+    CksumType.tp_init = reinterpret_cast<initproc>(Cksum_init);
+    CksumType.tp_methods = CksumMethods;
+    CksumType.tp_members = CksumMembers;
+    if (PyType_Ready(&CksumType) < 0) {
+        return nullptr;
+    }
+
+    PyObject* module = PyModule_Create(&Module);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(&CksumType);
+    if (PyModule_AddObject(module, "Cksum", reinterpret_cast<PyObject*>(&CksumType)) < 0) {
+        Py_DECREF(&CksumType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
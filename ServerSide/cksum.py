@@ -62,6 +62,55 @@ crctab = [0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9, 0x130476dc,
 UNSIGNED = lambda n: n & 0xffffffff
 
 
+class Cksum:
+    """
+    This class computes the same checksum as memcrc over data that arrives in parts, without holding it all.
+
+    Attributes:
+        state (int): The running CRC of the bytes so far, before the length is folded in.
+        length (int): The number of bytes so far.
+    """
+    def __init__(self, state=0, length=0):
+        """
+        Starts a checksum of no bytes, or continues one from its state and length.
+
+        Args:
+            state (int, optional): The state of the checksum to continue. Defaults to 0.
+            length (int, optional): The number of bytes of the checksum to continue. Defaults to 0.
+        """
+        self.state = state
+        self.length = length
+
+    def update(self, b):
+        """
+        Adds the next bytes to the checksum.
+
+        Args:
+            b (bytes): The next bytes.
+        """
+        s = self.state
+        for ch in b:
+            tabidx = (s >> 24) ^ ch
+            s = UNSIGNED((s << 8)) ^ crctab[tabidx]
+        self.state = s
+        self.length += len(b)
+
+    def digest(self):
+        """
+        Folds the length into the checksum of the bytes so far.
+
+        Returns:
+            int: The checksum, equal to memcrc of all the bytes given to update.
+        """
+        n = self.length
+        s = self.state
+        while n:
+            c = n & 0o377
+            n = n >> 8
+            s = UNSIGNED(s << 8) ^ crctab[(s >> 24) ^ c]
+        return UNSIGNED(~s)
+
+
 def memcrc(b):
     """
     Calculates the CRC checksum of the given byte array, emulating the behavior of the `cksum` command.
@@ -72,14 +121,13 @@ def memcrc(b):
     Returns:
         int: The computed CRC checksum as an unsigned 32-bit integer.
     """
-    n = len(b)
-    i = c = s = 0
-    for ch in b:
-        tabidx = (s >> 24) ^ ch
-        s = UNSIGNED((s << 8)) ^ crctab[tabidx]
-
-    while n:
-        c = n & 0o377
-        n = n >> 8
-        s = UNSIGNED(s << 8) ^ crctab[(s >> 24) ^ c]
-    return UNSIGNED(~s)
+    crc = Cksum()
+    crc.update(b)
+    return crc.digest()
+
+
+try:
+    # The native module shares the client's CRC_Calculator; build it with `python setup.py build_ext --inplace`
+    from _cksum import Cksum, memcrc  # noqa: F811
+except ImportError:
+    pass
@@ -0,0 +1,25 @@
+"""
+Builds the optional native cksum module from the client's CRC_Calculator:
+
+    python setup.py build_ext --inplace
+
+The server runs without it, using the pure Python cksum module instead.
+"""
+import sys
+
+from setuptools import Extension, setup
+
+client_directory = '../ClientSide'
+
+setup(
+    name='cksum-native',
+    ext_modules=[
+        Extension(
+            '_cksum',
+            sources=['_cksum.cpp', f'{client_directory}/CRC_Calculator.cpp'],
+            include_dirs=[client_directory],
+            language='c++',
+            extra_compile_args=['/std:c++17', '/O2'] if sys.platform == 'win32' else ['-std=c++17', '-O3'],
+        ),
+    ],
+)